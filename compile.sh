@@ -2,7 +2,8 @@
 
 files="src/main.cpp src/dump.cpp src/io_diff.cpp src/tree_base.cpp \
        src/user_interface.cpp src/variable_parse.cpp src/operations.cpp src/latex_dump.cpp \
-       src/logic_functions.cpp src/new_great_input.cpp src/processing_diff.cpp"
+       src/logic_functions.cpp src/new_great_input.cpp src/processing_diff.cpp \
+       src/batch_diff.cpp src/tree_serialize.cpp src/derivative_cache.cpp src/string_builder.cpp src/fast_eval.cpp src/plot_sampling.cpp src/interval_eval.cpp src/eval_session.cpp src/cost_model.cpp src/canonical_form.cpp src/polynomial.cpp src/rewrite_pattern.cpp src/egraph.cpp src/rule_matcher.cpp src/tree_traversal.cpp src/compact_tree.cpp src/tree_fingerprint.cpp"
 
 flags="-D _DEBUG -ggdb3 -std=c++17 -O0 -Wall -Wextra -Weffc++ -Waggressive-loop-optimizations \
     -Wc++14-compat -Wmissing-declarations -Wcast-align -Wcast-qual -Wchar-subscripts \
@@ -17,5 +18,6 @@ flags="-D _DEBUG -ggdb3 -std=c++17 -O0 -Wall -Wextra -Weffc++ -Waggressive-loop-
     -Wno-old-style-cast -Wno-varargs -Wstack-protector -fcheck-new -fsized-deallocation \
     -fstack-protector -fstrict-overflow -flto-odr-type-merging -fno-omit-frame-pointer \
     -pie -fPIE -Werror=vla \
+    -pthread \
     -fsanitize=address,alignment,bool,bounds,enum,float-cast-overflow,float-divide-by-zero,integer-divide-by-zero,leak,nonnull-attribute,null,object-size,return,returns-nonnull-attribute,shift,signed-integer-overflow,undefined,unreachable,vla-bound,vptr"
 g++ -I./include $files -o start_derevo $flags
@@ -37,7 +37,7 @@
 #define COSH(x)     CreateNode(NODE_OP, (ValueOfTreeElement){.op_value = OP_COSH},   NULL, x)
 #define TANH(x)     CreateNode(NODE_OP, (ValueOfTreeElement){.op_value = OP_TANH},   NULL, x)
 #define COTH(x)     CreateNode(NODE_OP, (ValueOfTreeElement){.op_value = OP_COTH},   NULL, x)
-#define SQRT(x)     CreateNode(NODE_OP, (ValueOfTreeElement){.op_value = OP_POW}, x, NUM(0.5))
+#define SQRT(x)     CreateNode(NODE_OP, (ValueOfTreeElement){.op_value = OP_SQRT},   NULL, x)
 
 // ==================== ДЛЯ ДИФФЕРЕНЦИРОВАНИЯ ====================
 #define U  COPY(node->left)
@@ -0,0 +1,31 @@
+#ifndef BATCH_DIFF_H_
+#define BATCH_DIFF_H_
+
+#include <stdlib.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "variable_parse.h"
+#include "user_interface.h"
+
+typedef struct {
+    char* text;        // выражение, завершенное '$'
+    bool  is_copy;     // последнее выражение без терминатора копируется из отображения
+} ExpressionRecord;
+
+typedef struct {
+    Tree*         trees;          // trees[i].root == NULL, если выражение i не разобралось
+    size_t        count;
+    size_t        n_failed;
+    VariableTable var_table;      // объединение таблиц переменных всех потоков
+    double        parse_seconds;
+    int           n_threads;
+} ExpressionBatch;
+
+// у каждого потока своя таблица на kMaxNOfVariables имен, как в одиночном режиме: выражение
+// с лишним именем считается неразобранным, а если лимит превышает объединение таблиц,
+// загрузка всего пакета завершается TREE_ERROR_VARIABLE_TABLE
+TreeErrorType LoadExpressionBatch(const char* filename, int n_threads, ExpressionBatch* batch);
+void          DestroyExpressionBatch(ExpressionBatch* batch);
+TreeErrorType RunBatchMode(const ProgramOptions* options);
+
+#endif // BATCH_DIFF_H_
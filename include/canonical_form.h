@@ -0,0 +1,17 @@
+#ifndef CANONICAL_FORM_H_
+#define CANONICAL_FORM_H_
+
+#include "tree_common.h"
+
+// Каноническая форма многочленоподобных выражений: цепочки + и * разворачиваются,
+// множители с одинаковым основанием собираются в степень (если показатели целые
+// и не сокращают полюс: x * x^-1 не становится 1), подобные слагаемые
+// складываются, а операнды упорядочиваются:  x*x*3 + 2*x^2  ->  5*x^2
+
+// полный порядок на поддеревьях: числа < переменные < операции
+int   CompareCanonicalNodes(Node* first, Node* second);
+
+// новое дерево в канонической форме, NULL - не хватило памяти
+Node* BuildCanonicalForm(Node* node);
+
+#endif // CANONICAL_FORM_H_
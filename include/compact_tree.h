@@ -0,0 +1,53 @@
+#ifndef COMPACT_TREE_H_
+#define COMPACT_TREE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "variable_parse.h"
+
+// Дерево в непрерывном массиве: узел занимает 16 байт, дети адресуются 32-битными
+// номерами и всегда лежат раньше родителя, корень - последний узел. Поэтому проход
+// снизу вверх - один цикл по массиву без стека. Числа вынесены в отдельный пул,
+// приоритет берется из таблицы операций, родители строятся только по запросу.
+// Это представление только для чтения: по нему считаются отпечатки выражений
+// (tree_fingerprint), а дифференцирование, оптимизация и дамп работают с деревом из Node.
+
+typedef enum {
+    COMPACT_NUM = OP_COUNT,     // коды меньше OP_COUNT - операции
+    COMPACT_VAR
+} CompactLeafCode;
+
+typedef struct {
+    uint8_t  code;      // OperationType или CompactLeafCode
+    uint32_t left;      // kNoCompactNode - нет; аргумент унарной операции справа
+    uint32_t right;
+    uint32_t value;     // номер в пуле констант для COMPACT_NUM, в таблице переменных для COMPACT_VAR
+} CompactNode;
+
+static_assert(sizeof(CompactNode) == 16, "CompactNode must stay 16 bytes");
+
+typedef struct {
+    CompactNode* nodes;
+    uint32_t     n_nodes;
+    uint32_t     capacity;
+    double*      constants;
+    uint32_t     n_constants;
+    uint32_t     constants_capacity;
+    uint32_t*    parents;       // NULL, пока не вызван BuildCompactParents
+} CompactTree;
+
+void          InitCompactTree   (CompactTree* tree);
+void          DestroyCompactTree(CompactTree* tree);
+
+// переменные сопоставляются номерам в var_table, как в CompileTree
+TreeErrorType BuildCompactTree (Node* root, VariableTable* var_table, CompactTree* tree);
+
+// values[i] - значение i-й переменной таблицы (FillVariableValues)
+TreeErrorType EvaluateCompactTree(const CompactTree* tree, const double* values, double* result);
+
+// общих узлов нет, поэтому родитель у каждого узла, кроме корня, единственный
+TreeErrorType BuildCompactParents(CompactTree* tree);
+
+#endif // COMPACT_TREE_H_
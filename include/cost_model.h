@@ -0,0 +1,19 @@
+#ifndef COST_MODEL_H_
+#define COST_MODEL_H_
+
+#include <stdio.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+
+// Оценка стоимости вычисления дерева в условных единицах: сложение = 1.
+// Таблица задает порядок, в котором оптимизатор сравнивает записи; замер текущей
+// сборки печатается рядом с ней по --measure-costs.
+
+double GetOperationCost(OperationType op);
+double EstimateTreeCost(Node* node);
+
+// микробенчмарк ApplyOperation: costs[op] - время операции, деленное на время сложения
+TreeErrorType MeasureOperationCosts(double* costs, size_t n_iterations);
+void          PrintOperationCostTable(FILE* file, const double* costs);
+
+#endif // COST_MODEL_H_
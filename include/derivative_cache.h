@@ -0,0 +1,27 @@
+#ifndef DERIVATIVE_CACHE_H_
+#define DERIVATIVE_CACHE_H_
+
+#include <stdlib.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+
+// Каталог с производными, адресуемый по содержимому: имя записи - хеш сериализованного
+// исходного дерева, переменной, порядка производной и уровня оптимизации. Запись хранит
+// исходное дерево (для проверки коллизий) и оптимизированную производную.
+typedef struct {
+    const char* directory;
+    size_t      max_bytes;    // при превышении удаляются давно не использованные записи
+    OptimizationLevel optimization_level; // производные разных уровней хранятся отдельно
+} DerivativeCache;
+
+TreeErrorType InitDerivativeCache(DerivativeCache* cache, const char* directory, size_t max_bytes,
+                                  OptimizationLevel optimization_level);
+
+TreeErrorType LookupCachedDerivative(DerivativeCache* cache, Tree* source, const char* variable, int order,
+                                     Tree* derivative, bool* found);
+TreeErrorType StoreCachedDerivative (DerivativeCache* cache, Tree* source, const char* variable, int order,
+                                     Tree* derivative);
+
+TreeErrorType EvictDerivativeCache(DerivativeCache* cache);
+
+#endif // DERIVATIVE_CACHE_H_
@@ -0,0 +1,22 @@
+#ifndef EGRAPH_H_
+#define EGRAPH_H_
+
+#include "tree_common.h"
+#include "tree_error_types.h"
+
+// Упрощение насыщением равенств. E-граф хранит сразу все найденные равносильные
+// записи выражения: правила только добавляют новые записи в классы эквивалентности,
+// ничего не удаляя, поэтому порядок правил не важен и локальных минимумов нет.
+// Из насыщенного графа извлекается самое дешевое дерево по модели стоимости.
+
+typedef struct {
+    size_t n_enodes;
+    size_t n_classes;
+    int    n_iterations;
+    bool   is_saturated;        // правила больше ничего не добавляют, иначе остановлено по лимиту
+} SaturationStats;
+
+// result - новое дерево, не дороже исходного; stats может быть NULL
+TreeErrorType SimplifyBySaturation(Node* node, Node** result, SaturationStats* stats);
+
+#endif // EGRAPH_H_
@@ -0,0 +1,51 @@
+#ifndef EVAL_SESSION_H_
+#define EVAL_SESSION_H_
+
+#include <stdlib.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "variable_parse.h"
+
+// Сессия вычисления: значения узлов дерева запоминаются вместе с множеством
+// переменных, от которых они зависят. После SetVariableValue пересчитываются
+// только узлы, зависящие от изменившихся переменных.
+// Дерево нельзя менять, пока сессия жива.
+
+typedef struct {
+    unsigned long long words[kDependencyWords];
+} DependencySet;
+
+typedef struct {
+    NodeType      type;
+    OperationType op;
+    int           left;       // индексы детей в SessionNode-массиве, -1 - нет ребенка
+    int           right;
+    int           variable;   // номер переменной сессии для NODE_VAR
+    DependencySet depends;
+    double        value;
+    TreeErrorType error;
+} SessionNode;
+
+typedef struct {
+    char   name[kMaxVariableLength];
+    double value;             // значение при прошлом вычислении
+    bool   is_defined;
+} SessionVariable;
+
+typedef struct {
+    VariableTable*   var_table;
+    SessionNode*     nodes;       // в обратном порядке обхода: дети раньше родителя
+    size_t           n_nodes;
+    SessionVariable  variables[kMaxNOfVariables];
+    int              n_variables;
+    bool             is_computed; // первое вычисление считает все узлы
+    size_t           n_recomputed; // сколько узлов пересчитал последний EvaluateSession
+} EvaluationSession;
+
+TreeErrorType InitEvaluationSession(EvaluationSession* session, Tree* tree, VariableTable* var_table);
+void          DestroyEvaluationSession(EvaluationSession* session);
+
+// переменные читаются из var_table; неопределенная переменная - TREE_ERROR_VARIABLE_UNDEFINED
+TreeErrorType EvaluateSession(EvaluationSession* session, double* result);
+
+#endif // EVAL_SESSION_H_
@@ -0,0 +1,56 @@
+#ifndef FAST_EVAL_H_
+#define FAST_EVAL_H_
+
+#include <stdlib.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "variable_parse.h"
+#include "operations.h"
+
+// Дерево, развернутое в постфиксную программу для стековой машины:
+// вычисление в цикле по массиву без рекурсии и поиска переменных по имени.
+typedef enum {
+    INSTR_CONST,
+    INSTR_VAR,
+    INSTR_UNARY,
+    INSTR_BINARY,
+    INSTR_POWI,                // вершина стека в целой степени slot, возведением в квадрат
+    INSTR_POLY                 // многочлен степени count от вершины стека, коэффициенты - constants[slot...]
+} InstructionKind;
+
+typedef struct {
+    InstructionKind kind;
+    OperationType   op;
+    int             slot;      // номер переменной в таблице для INSTR_VAR, показатель для INSTR_POWI
+    int             count;     // степень многочлена для INSTR_POLY
+    double          value;     // константа для INSTR_CONST
+} Instruction;
+
+typedef struct {
+    Instruction* code;
+    size_t       length;
+    size_t       max_stack_depth;
+    int          n_slots;      // номера переменных меньше n_slots
+    double*      constants;    // коэффициенты многочленов INSTR_POLY
+    size_t       n_constants;
+} CompiledTree;
+
+TreeErrorType CompileTree(Tree* tree, VariableTable* var_table, CompiledTree* compiled);
+void          DestroyCompiledTree(CompiledTree* compiled);
+
+// программа для оставшихся свободных переменных: связанные подставлены и свернуты до компиляции
+TreeErrorType CompileSpecializedTree(Tree* tree, VariableTable* var_table, const VariableBinding* bindings,
+                                     int n_bindings, CompiledTree* compiled);
+
+// неопределенные переменные получают NaN
+void          FillVariableValues(VariableTable* var_table, double* values);
+
+TreeErrorType ExecuteCompiledTree(const CompiledTree* compiled, const double* values, double* result);
+
+// значения в точках grid переменной grid_slot; где функция не определена - NaN.
+// grid должна быть упорядочена: блоки, целиком лежащие вне области определения
+// по интервальной оценке, не вычисляются
+TreeErrorType ExecuteCompiledTreeOnGrid(const CompiledTree* compiled, const double* values, int grid_slot,
+                                        const double* grid, size_t n_points, double* results);
+
+#endif // FAST_EVAL_H_
@@ -0,0 +1,33 @@
+#ifndef INTERVAL_EVAL_H_
+#define INTERVAL_EVAL_H_
+
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "variable_parse.h"
+#include "fast_eval.h"
+
+typedef struct {
+    double lower;
+    double upper;
+} Interval;
+
+// где на области определено выражение: везде, возможно не везде, нигде
+typedef enum {
+    DOMAIN_INSIDE,
+    DOMAIN_PARTIAL,
+    DOMAIN_OUTSIDE
+} DomainStatus;
+
+typedef struct {
+    Interval     range;     // содержит все значения в определенных точках; при DOMAIN_OUTSIDE не имеет смысла
+    DomainStatus domain;
+} IntervalResult;
+
+// boxes[slot] - отрезок значений переменной с номером slot в таблице
+TreeErrorType EvaluateCompiledOnBox(const CompiledTree* compiled, const Interval* boxes, IntervalResult* result);
+TreeErrorType EvaluateTreeOnBox(Tree* tree, VariableTable* var_table, const Interval* boxes,
+                                IntervalResult* result);
+
+void FillPointBoxes(const double* values, int n_values, Interval* boxes);
+
+#endif // INTERVAL_EVAL_H_
@@ -6,7 +6,14 @@
 #include "tree_base.h"
 #include "tree_error_types.h"
 
+typedef struct {
+    char*  data;  // приватное (copy-on-write) отображение файла, можно писать терминаторы '$'
+    size_t size;
+} MappedFile;
+
 char* ReadExpressionFromFile(const char* filename);
+TreeErrorType MapInputFile(const char* filename, MappedFile* mapped);
+void UnmapInputFile(MappedFile* mapped);
 void SkipSpaces(const char* buffer, size_t* pos);
 size_t GetFileSize(FILE* file);
 
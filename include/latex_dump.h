@@ -5,6 +5,7 @@
 #include "tree_common.h"
 #include "variable_parse.h"
 #include "processing_diff.h"
+#include "string_builder.h"
 
 #include <stdio.h>
 
@@ -17,13 +18,19 @@ typedef struct {
     bool right_use_less_equal;  // использовать <= вместо < для правого аргумента
 } OpFormat;
 
-void          TreeToStringSimple(Node* node, char* buffer, int* pos, int buffer_size);
+typedef const OpFormat* (*FormatGetter)(OperationType op_type);
+typedef void (*RenderVariableFunction)(Node* node, StringBuilder* builder, void* context);
+
+void          TreeToStringSimple(Node* node, StringBuilder* builder);
 const OpFormat* GetOpFormat(OperationType op_type);
+const OpFormat* GetPGFPlotFormat(OperationType op_type);
 
-char*         ConvertLatexToPGFPlot(const char* latex_expr);
+void          TreeToPGFPlotString(Node* node, const char* plot_variable, VariableTable* var_table,
+                                  StringBuilder* builder);
 
 TreeErrorType StartLatexDump(FILE* file);
-TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* diff_variable);
+TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                            Tree* derivative_trees, int n_derivatives);
 TreeErrorType EndLatexDump(FILE* file);
 
 TreeErrorType DumpOriginalFunctionToFile(FILE* file, Tree* tree, double result_value);
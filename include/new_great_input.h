@@ -11,8 +11,13 @@ typedef struct {
     size_t operations_count;
     bool hashes_initialized;
     const char* original_string;
+    char*  name_buffer;           // Tree::file_buffer; NULL - имена копируются через strdup
+    size_t name_buffer_size;
+    size_t name_buffer_used;
 } ParserContext;
 
+TreeErrorType ParseExpressionIntoTree(Tree* tree, const char* expression, VariableTable* var_table);
+
 //FIXME rename
 Node* GetGovnoNaBosuNogu(const char** s, VariableTable* var_table);
 Node* GetE(const char** s, ParserContext* context);
@@ -6,14 +6,30 @@
 #include "tree_common.h"
 #include "variable_parse.h"
 
+typedef struct {
+    const char* name;
+    double      value;
+} VariableBinding;
 
 void  FreeSubtree(Node* node);
 size_t CountTreeNodes(Node* node);
+size_t MeasureTreeDepth(Node* node);
+double PowerBySquaring(double base, long exponent);
+double RaiseToPower(double base, double exponent);
+TreeErrorType ApplyOperation(OperationType op, double left, double right, double* result);
 TreeErrorType EvaluateTree(Tree* tree, VariableTable* var_table, double* result);
 TreeErrorType DifferentiateTree(Tree* tree, const char* variable_name, Tree* result_tree);
 Node* CreateNode(NodeType type, ValueOfTreeElement data, Node* left, Node* right);
+int   GetOperationPriority(OperationType op);
 Node* CopyNode(Node* original);
-TreeErrorType OptimizeTreeWithDump(Tree* tree, FILE* tex_file, VariableTable* var_table);
+// verify - сравнить отпечатки дерева до и после и предупредить о расхождении
+TreeErrorType OptimizeTreeWithDump(Tree* tree, FILE* tex_file, VariableTable* var_table, OptimizationLevel level,
+                                   bool verify);
+
+// копия дерева, где связанные переменные заменены значениями и константы свернуты
+TreeErrorType SpecializeTree(Tree* tree, const VariableBinding* bindings, int n_bindings, Tree* result);
+// связывает все определенные переменные, кроме free_variable; bindings - не меньше kMaxNOfVariables
+int           CollectVariableBindings(VariableTable* var_table, const char* free_variable, VariableBinding* bindings);
 
 
 #endif // DIFF_OPERATIONS
@@ -0,0 +1,24 @@
+#ifndef PLOT_SAMPLING_H_
+#define PLOT_SAMPLING_H_
+
+#include <stdlib.h>
+#include "tree_error_types.h"
+#include "fast_eval.h"
+
+typedef struct {
+    double* x;          // по возрастанию
+    double* y;
+    size_t  count;
+} PlotSamples;
+
+// Адаптивная сетка: интервалы с наибольшей ошибкой линейной интерполяции делятся
+// пополам, пока не кончится бюджет точек или ошибка не станет незаметной на графике.
+// Ошибка оценивается по отклонению середины от хорды и, если есть f'', по h^2/8 * |f''|.
+// values - значения всех переменных (kMaxNOfVariables), slot - номер переменной графика.
+TreeErrorType SampleAdaptively(const CompiledTree* function, const CompiledTree* second_derivative,
+                               const double* values, int slot, double x_min, double x_max,
+                               size_t max_points, PlotSamples* samples);
+
+void          DestroyPlotSamples(PlotSamples* samples);
+
+#endif // PLOT_SAMPLING_H_
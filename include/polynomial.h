@@ -0,0 +1,43 @@
+#ifndef POLYNOMIAL_H_
+#define POLYNOMIAL_H_
+
+#include "tree_common.h"
+
+// Многочлен от одной переменной: c[0] + c[1]*x + ... + c[degree]*x^degree
+typedef struct {
+    const char* variable;     // имя из узла исходного дерева, NULL - переменной нет
+    double      coefficients[kMaxPolynomialDegree + 1];
+    int         degree;
+} Polynomial;
+
+// Многочленом считается только уже раскрытая сумма одночленов. Произведения сумм и
+// степени сумм не раскрываются: (x - 1)^16 в виде коэффициентов теряет все значащие
+// цифры около x = 1 из-за сокращения.
+typedef enum {
+    POLYNOMIAL_SHAPE_NONE,
+    POLYNOMIAL_SHAPE_MONOMIAL,     // числа и одна переменная через *, / на число и ^ целое
+    POLYNOMIAL_SHAPE_SUM           // + и - одночленов и сумм
+} PolynomialShape;
+
+// форма узла по формам его детей, без обхода поддерева
+PolynomialShape PolynomialNodeShape(Node* node, PolynomialShape left, PolynomialShape right);
+
+// сумма одночленов от одной переменной; false - другая форма, две переменные
+// или степень больше kMaxPolynomialDegree
+bool  ExtractPolynomial(Node* node, Polynomial* polynomial);
+
+// число ненулевых коэффициентов: одночлены выгоднее возводить в степень, чем считать по Горнеру
+int   CountPolynomialTerms(const Polynomial* polynomial);
+
+// c0 + x*(c1 + x*(c2 + ...)), нулевые коэффициенты пропускаются
+Node* BuildHornerForm(const Polynomial* polynomial);
+
+// значения в точке: схема Горнера на fma
+double EvaluatePolynomialHorner(const double* coefficients, int degree, double x);
+
+// значения в n_points точках схемой Эстрина: независимые пары коэффициентов
+// считаются одной векторизуемой петлей по точкам на каждом уровне
+void   EvaluatePolynomialEstrin(const double* coefficients, int degree, const double* x,
+                                size_t n_points, double* results);
+
+#endif // POLYNOMIAL_H_
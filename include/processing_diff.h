@@ -5,6 +5,7 @@
 #include "tree_base.h"
 #include "variable_parse.h"
 #include "tree_error_types.h"
+#include "user_interface.h"
 
 typedef struct {
     Tree tree;
@@ -12,6 +13,7 @@ typedef struct {
     char* expression;
     FILE* tex_file;
     double result;
+    ProgramOptions options;
 } DifferentiatorStruct;
 
 DifferentiatorStruct* CreateDifferentiatorStruct();
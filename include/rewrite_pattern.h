@@ -0,0 +1,47 @@
+#ifndef REWRITE_PATTERN_H_
+#define REWRITE_PATTERN_H_
+
+#include "tree_common.h"
+#include "tree_error_types.h"
+
+// Правило переписывания в текстовой записи:  mul(?a, add(?b, ?c)) -> add(mul(?a, ?b), mul(?a, ?c))
+// ?имя - шаблонная переменная, совпадающая с любым поддеревом; одинаковые имена
+// в левой части должны совпасть с равными поддеревьями. Операции называются как
+// в парсере выражений, бинарные - add, sub, mul, div, pow.
+// После правой части могут идти условия и описание для дампа:
+//     div(0, ?x) -> 0 where nonzero(?x) # 0 / simplified
+// nonzero(?x) - поддерево ?x не число ноль. Описание начинается после одного
+// пробела за '#', остальные пробелы сохраняются.
+
+typedef enum {
+    PATTERN_NUM,
+    PATTERN_WILDCARD,
+    PATTERN_OP
+} PatternNodeKind;
+
+typedef struct {
+    PatternNodeKind kind;
+    OperationType   op;
+    double          value;      // для PATTERN_NUM
+    int             wildcard;   // номер шаблонной переменной для PATTERN_WILDCARD
+    int             left;       // индексы в RewriteRule::nodes, -1 - нет; аргумент унарной операции справа
+    int             right;
+} PatternNode;
+
+typedef struct {
+    PatternNode nodes[kMaxPatternNodes];
+    int         n_nodes;
+    int         lhs;            // корни левой и правой частей
+    int         rhs;
+    int         n_wildcards;
+    char        wildcard_names[kMaxPatternWildcards][kMaxVariableLength];
+    bool        is_nonzero[kMaxPatternWildcards];   // условие nonzero(?x)
+    char        description[kMaxTexDescriptionLength];
+} RewriteRule;
+
+// в правой части допустимы только переменные, связанные левой
+TreeErrorType ParseRewriteRule(const char* text, RewriteRule* rule);
+
+const char*   GetPatternOperationName(OperationType op);
+
+#endif // REWRITE_PATTERN_H_
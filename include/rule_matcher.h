@@ -0,0 +1,39 @@
+#ifndef RULE_MATCHER_H_
+#define RULE_MATCHER_H_
+
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "rewrite_pattern.h"
+
+// Набор правил переписывания, скомпилированный в дерево различения: левые части
+// записаны в префиксном порядке и слиты по общим префиксам, так что узел дерева
+// выражения сравнивается со всеми правилами за один проход по его верхушке.
+
+typedef struct {
+    PatternNodeKind kind;       // PATTERN_WILDCARD - любое поддерево
+    OperationType   op;
+    double          value;
+    int             first_child;
+    int             next_sibling;
+    int             first_rule; // правила, левая часть которых кончается здесь
+} DiscriminationNode;
+
+typedef struct {
+    RewriteRule*        rules;
+    int*                next_rule;        // следующее правило в том же листе
+    int*                wildcard_order;   // [rule * kMaxPatternNodes + k]: шаблонная переменная k-го ?
+    int                 n_rules;
+    DiscriminationNode* nodes;
+    int                 n_nodes;
+    int                 capacity;
+} RewriteRuleSet;
+
+// строки вида "lhs -> rhs [where ...] [# описание]"; при совпадении нескольких
+// правил выбирается первое в порядке texts
+TreeErrorType CompileRewriteRules(const char* const* texts, size_t n_texts, RewriteRuleSet* set);
+void          DestroyRewriteRuleSet(RewriteRuleSet* set);
+
+// новое поддерево по первому подошедшему правилу, NULL - ни одно не подошло
+Node*         RewriteByRules(const RewriteRuleSet* set, Node* node, const char** description);
+
+#endif // RULE_MATCHER_H_
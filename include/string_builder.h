@@ -0,0 +1,28 @@
+#ifndef STRING_BUILDER_H_
+#define STRING_BUILDER_H_
+
+#include <stdlib.h>
+#include "tree_error_types.h"
+
+// Растущая строка: данные всегда завершены '\0', при нехватке памяти
+// выставляется failed и дальнейшие добавления игнорируются.
+typedef struct {
+    char*  data;
+    size_t length;
+    size_t capacity;
+    bool   failed;
+} StringBuilder;
+
+void          InitStringBuilder(StringBuilder* builder);
+void          DestroyStringBuilder(StringBuilder* builder);
+void          ClearStringBuilder(StringBuilder* builder);
+TreeErrorType ReserveStringBuilder(StringBuilder* builder, size_t extra_length);
+
+void AppendChars (StringBuilder* builder, const char* chars, size_t length);
+void AppendString(StringBuilder* builder, const char* string);
+void AppendChar  (StringBuilder* builder, char symbol);
+void AppendDouble(StringBuilder* builder, double value);
+
+const char*   GetStringBuilderData(const StringBuilder* builder);
+
+#endif // STRING_BUILDER_H_
@@ -21,6 +21,28 @@ TreeErrorType TreeCtor(Tree* tree);
 TreeErrorType TreeDtor(Tree* tree);
 void FreeNode(Node* node);
 
+// новый корень: линеаризация устаревает, размер пересчитывается
+void SetTreeRoot(Tree* tree, Node* root);
+
+// узлы в обратном порядке обхода (дети раньше родителя), tree->size штук; строится при
+// первом запросе и живет до изменения дерева. Проход, меняющий узлы на месте, вызывает
+// InvalidateTreePostOrder. NULL - пустое дерево или не хватило памяти
+Node* const* GetTreePostOrder(Tree* tree);
+void         InvalidateTreePostOrder(Tree* tree);
+
+// CopyNode выделяет копию поддерева одним блоком: узлы лежат подряд, а блок
+// освобождается, когда FreeNode отпустит последний взятый из него узел
+typedef struct NodeBlock NodeBlock;
+
+NodeBlock* CreateNodeBlock (size_t n_nodes);
+Node*      TakeBlockNode   (NodeBlock* block); // обнуленный узел, NULL - блок исчерпан
+void       ReleaseNodeBlock(NodeBlock* block); // ссылка создателя: узлы больше не берутся
+
+void ClearTexCache(Node* node);
+void StoreTexCache(Node* node, const char* fragment, size_t length);
+void CopyTexCache(Node* destination, const Node* source);
+
 unsigned int ComputeHash(const char* str);
+unsigned int ComputeHashOfSpan(const char* str, size_t length);
 
 #endif // TREE_BASE_H_
@@ -2,6 +2,7 @@
 #define TREE_COMMON_H_
 
 #include <stdlib.h>
+#include <stdint.h>
 
 const int         kMaxSystemCommandLength             = 512;
 const int         kMaxLengthOfFilename                = 256;
@@ -12,7 +13,44 @@ const int         kMaxPathDepth                       = 100;
 const int         kTreeDumpAfterAddingElementCapacity = 512;
 const char* const kDefaultDataBaseFilename            = "differenciator_tree.txt";
 const int         kMaxNumberOfDerivative              = 4;
-const int         kMaxLengthOfTexExpression           = 30000;
+const size_t      kStringBuilderInitialCapacity       = 256;
+const size_t      kMaxDoubleTextLength                = 32;   // кратчайшая запись double: до 24 символов
+const size_t      kMaxCachedTexFragmentLength         = 2048; // более длинные поддеревья собираются из детей
+const size_t      kMaxTexCacheBytes                   = 16 * 1024 * 1024; // все фрагменты всех деревьев
+const size_t      kFastEvalStackSize                  = 256;
+const size_t      kFastEvalBlockSize                  = 64;
+const size_t      kMaxGridStackDepth                  = 4096; // глубже графики считаются сессией, а не блоками
+const size_t      kTraversalInitialDepth              = 64;   // кадров явного стека обхода до первого расширения
+const size_t      kMaxRecursiveTreeDepth              = 10000; // глубже рекурсивные проходы (оптимизатор, многочлены) не запускаются
+const uint32_t    kCompactTreeInitialCapacity         = 64;
+const uint32_t    kNoCompactNode                      = UINT32_MAX; // нет ребенка или не хватило места
+const int         kFingerprintPoints                  = 8;    // точек в отпечатке выражения
+const double      kFingerprintMinValue                = 0.15; // значения переменных внутри областей
+const double      kFingerprintMaxValue                = 0.85; // определения ln, sqrt, arcsin, arccos
+const double      kFingerprintTolerance               = 1e-9; // относительная погрешность совпадения
+const double      kFingerprintAbsoluteTolerance       = 1e-12;
+const uint64_t    kFingerprintModulus                 = 2305843009213693951ULL; // простое 2^61 - 1
+const char* const kPlotDataFilename                   = "full_analysis_plot.dat";
+const size_t      kAdaptivePlotInitialPoints          = 17;
+const double      kAdaptivePlotTolerance              = 1e-3; // доля размаха f, незаметная на графике
+const double      kAdaptivePlotMinWidth               = 1e-7; // доля диапазона, мельче не делим
+const double      kZeroEpsilon                        = 1e-10;
+const double      kMaxIntervalIntegerExponent         = 1e9;
+const double      kLeafEvaluationCost                 = 0.5;  // загрузка числа или переменной, в сложениях
+const size_t      kCostBenchmarkInputs                = 1024;
+const int         kCostBenchmarkRepeats               = 5;
+const size_t      kCostBenchmarkIterations            = 4000000;
+const double      kMaxSquaringExponent                = 64;   // x^n при |n| не больше - возведением в квадрат
+const int         kMaxPolynomialDegree                = 16;
+const int         kMaxPatternNodes                    = 32;
+const int         kMaxPatternWildcards                = 8;
+const size_t      kMaxEGraphNodes                     = 20000;
+const size_t      kEGraphTableSize                    = 65536; // степень двойки, больше 2 * kMaxEGraphNodes
+const int         kMaxSaturationIterations            = 30;
+const double      kSaturationTimeLimit                = 0.25;  // секунды на одно дерево
+const size_t      kMaxSaturationMatches               = 4096;  // совпадений одного правила за итерацию
+const int         kDependencyWordBits                 = 64;
+const size_t      kSaturationClockInterval            = 1024;  // шагов сопоставления между проверками времени
 const char* const kTexFilename                        = "full_analysis.tex";
 const int         kMaxDotBufferLength                 = 64;
 const int         kMaxTexDescriptionLength            = 256;
@@ -20,7 +58,22 @@ const int         kMaxNOfVariables                    = 100;
 const int         kMaxVariableLength                  = 32;
 const int         kMaxFuncNameLength                  = 256;
 const int         kMaxCustomNotationLength            = 32;
+const int         kDependencyWords                    = (kMaxNOfVariables + kDependencyWordBits - 1) / kDependencyWordBits;
 const int         kTaylor                             = 7;
+const int         kMaxExactIntegerDigits              = 15;
+const int         kMaxBatchThreads                    = 256;
+const size_t      kBatchChunkSize                     = 64;
+const size_t      kDefaultCacheMaxBytes               = 64 * 1024 * 1024;
+const int         kMaxCacheLabelLength                = 64;
+const char* const kCacheEntrySuffix                   = ".dtre";
+const unsigned long long kCacheHashOffset             = 14695981039346656037ULL; // FNV-1a, 64 бита
+const unsigned long long kCacheHashPrime              = 1099511628211ULL;
+
+typedef enum {
+    OPTIMIZATION_LEVEL_NONE,        // дерево не упрощается
+    OPTIMIZATION_LEVEL_PASSES,      // проходы в фиксированном порядке
+    OPTIMIZATION_LEVEL_SATURATION   // проходы, затем насыщение равенств в e-графе
+} OptimizationLevel;
 
 typedef enum {
     NODE_OP,
@@ -48,11 +101,13 @@ typedef enum {
     OP_COTH,
     OP_LN,
     OP_EXP,
+    OP_SQRT,
     OP_COUNT
 } OperationType;
 
 typedef struct {
     unsigned int hash;
+    bool  is_view;  // имя лежит в Tree::file_buffer и освобождается вместе с деревом
     char* name;
 } VariableDefinition;
 
@@ -68,19 +123,26 @@ typedef union {
     VariableDefinition var_definition;
 } ValueOfTreeElement;
 
+struct NodeBlock;
+
 typedef struct Node {
     ValueOfTreeElement  data;
     NodeType            type;
     struct Node*        left;
     struct Node*        right;
     struct Node*        parent;
+    size_t              subtree_size; // число узлов поддерева; задается в CreateNode, у предков обновляется в ReplaceNode
+    struct NodeBlock*   block;     // общий блок копии из CopyNode, NULL - узел выделен отдельно
     int                 priority;  // Приоритет операции (0 для чисел и переменных)
+    char*               tex_cache; // LaTeX поддерева с прошлой отрисовки, NULL - нужно отрисовать заново
+    size_t              tex_cache_length;
 } Node;
 
 typedef struct {
     Node* root;
-    size_t size;
+    size_t size;        // число узлов; задается в SetTreeRoot, при замене поддерева обновляется на месте
     char* file_buffer;
+    Node** post_order;  // узлы в обратном порядке обхода, NULL - еще не построен или устарел
 } Tree;
 
 #endif //TREE_COMMON_H_
@@ -0,0 +1,32 @@
+#ifndef TREE_FINGERPRINT_H_
+#define TREE_FINGERPRINT_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+#include "variable_parse.h"
+
+// Отпечаток выражения - его значения в фиксированных псевдослучайных точках.
+// Значение переменной в точке зависит только от ее имени и номера точки, поэтому
+// отпечатки разных деревьев сравнимы. Рациональные функции с целыми коэффициентами
+// дополнительно вычисляются по простому модулю: совпадение вычетов - точная проверка
+// с вероятностью ошибки порядка степень / модуль, без погрешностей округления.
+
+typedef struct {
+    double   values  [kFingerprintPoints];  // NaN - выражение не определено в точке
+    uint64_t residues[kFingerprintPoints];  // по модулю kFingerprintModulus, UINT64_MAX - деление на 0
+    bool     has_residues;
+    int      defined_count;                 // точек определения: по вычетам, если они есть, иначе по значениям
+} TreeFingerprint;
+
+TreeErrorType ComputeTreeFingerprint(Tree* tree, VariableTable* var_table, TreeFingerprint* fingerprint);
+
+// точки, где определено только одно выражение, означают разные отпечатки; отпечатки
+// без общих точек определения тоже считаются разными
+bool          FingerprintsProbablyEqual(const TreeFingerprint* first, const TreeFingerprint* second);
+// равные по вычетам отпечатки дают равные хеши; для групп в хеш-таблице
+uint64_t      HashFingerprintResidues(const TreeFingerprint* fingerprint);
+TreeErrorType TreesProbablyEqual(Tree* first, Tree* second, VariableTable* var_table, bool* is_equal);
+
+#endif // TREE_FINGERPRINT_H_
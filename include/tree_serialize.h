@@ -0,0 +1,34 @@
+#ifndef TREE_SERIALIZE_H_
+#define TREE_SERIALIZE_H_
+
+#include <stdlib.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+
+// Формат (все числа little-endian):
+//   "DTRE" | u16 версия | u16 флаги | varint длина метки | метка | varint число деревьев
+//   для каждого дерева:
+//     varint число символов | (varint длина, байты имени) * число символов
+//     varint число узлов    | узлы в прямом порядке:
+//        kOpcodeNum  + 8 байт double
+//        kOpcodeVar  + varint номер символа
+//        kOpcodeOperationBase + OperationType, затем левый (только у бинарных) и правый аргументы
+
+const char* const   kTreeFileMagic          = "DTRE";
+const unsigned int  kTreeFileVersion        = 1;
+const unsigned char kOpcodeNum              = 1;
+const unsigned char kOpcodeVar              = 2;
+const unsigned char kOpcodeOperationBase    = 16;
+
+TreeErrorType SerializeTrees  (const char* label, Tree* trees, int n_trees, unsigned char** data, size_t* size);
+TreeErrorType DeserializeTrees(const unsigned char* data, size_t size, char* label, size_t label_size,
+                               Tree* trees, int max_trees, int* n_trees);
+
+// деревья совпадают с точностью до узлов: одинаковые сериализованные представления
+bool TreesHaveSameStructure(Tree* first, Tree* second);
+
+TreeErrorType SaveTreesToFile  (const char* filename, const char* label, Tree* trees, int n_trees);
+TreeErrorType LoadTreesFromFile(const char* filename, char* label, size_t label_size,
+                                Tree* trees, int max_trees, int* n_trees);
+
+#endif // TREE_SERIALIZE_H_
@@ -0,0 +1,63 @@
+#ifndef TREE_TRAVERSAL_H_
+#define TREE_TRAVERSAL_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "tree_common.h"
+#include "tree_error_types.h"
+
+// Обход дерева с явным стеком в куче: глубина дерева ограничена только памятью,
+// а не стеком вызовов. Каждый узел выдается трижды - до детей (ENTER), между
+// левым и правым (BETWEEN) и после детей (LEAVE); прямой порядок - это ENTER,
+// обратный - LEAVE. Проход, считающий значение снизу вверх, на LEAVE кладет
+// результат узла в ячейку родителя (TraversalResultSlot), а родитель на своем
+// LEAVE читает left_result и right_result.
+
+typedef enum {
+    TRAVERSAL_ENTER,
+    TRAVERSAL_BETWEEN,
+    TRAVERSAL_LEAVE
+} TraversalEvent;
+
+typedef union {
+    Node*    node;
+    double   value;
+    uint32_t index;     // номер узла в другом представлении дерева
+} TraversalResult;
+
+typedef struct {
+    Node*           node;
+    TraversalEvent  event;
+    int             stage;          // внутреннее состояние обхода
+    size_t          mark;           // свободно для прохода, живет от ENTER до LEAVE
+    TraversalResult left_result;    // обнулены до LEAVE соответствующего ребенка
+    TraversalResult right_result;
+} TraversalFrame;
+
+typedef struct {
+    TraversalFrame* frames;
+    size_t          depth;
+    size_t          capacity;
+    bool            is_leaving;     // верхний кадр снимается следующим шагом
+    TraversalResult result;         // результат корня
+    TreeErrorType   error;
+} TreeTraversal;
+
+TreeErrorType   BeginTreeTraversal(TreeTraversal* traversal, Node* root);
+void            EndTreeTraversal  (TreeTraversal* traversal);
+
+// следующий кадр, NULL - обход закончен или не хватило памяти (traversal->error);
+// указатель действителен до следующего шага
+TraversalFrame* NextTraversalFrame(TreeTraversal* traversal);
+
+// после ENTER: дети не обходятся, следующим будет LEAVE этого же узла;
+// после BETWEEN так же пропускается только правый ребенок
+void            SkipTraversalChildren(TreeTraversal* traversal);
+
+// на LEAVE: куда записать результат текущего узла
+TraversalResult* TraversalResultSlot(TreeTraversal* traversal);
+
+Node*           NextPreOrderNode (TreeTraversal* traversal);
+Node*           NextPostOrderNode(TreeTraversal* traversal);
+
+#endif // TREE_TRAVERSAL_H_
@@ -5,6 +5,30 @@
 #include "tree_error_types.h"
 #include "variable_parse.h"
 
+typedef enum {
+    PLOT_MODE_EXPRESSION,   // pdflatex сам считает выражение в samples точках
+    PLOT_MODE_TABLE,        // готовые координаты f и производных прямо в .tex
+    PLOT_MODE_DATA_FILE     // координаты во внешнем .dat файле
+} PlotMode;
+
+typedef struct {
+    const char* input_filename;
+    bool        batch_mode;   // файл содержит много выражений, разделенных '\n' или '$'
+    int         n_threads;    // 0 - по числу ядер
+    bool        group_equivalent; // в пакетном режиме сгруппировать выражения с равными отпечатками
+    const char* derivatives_filename; // двоичный файл с заранее посчитанными производными
+    const char* cache_directory;      // общий для запусков кеш производных, NULL - выключен
+    size_t      cache_max_bytes;
+    PlotMode    plot_mode;
+    bool        adaptive_plot;    // число точек графика - бюджет адаптивной сетки
+    bool        measure_costs;    // только замерить стоимости операций и выйти
+    bool        value_sweep;      // после анализа менять переменные по одной и пересчитывать f и производные
+    bool        verify_optimization; // сверять отпечатки дерева до и после оптимизации
+    OptimizationLevel optimization_level;
+} ProgramOptions;
+
+TreeErrorType ParseProgramOptions(int argc, const char** argv, ProgramOptions* options);
+void PrintUsage(const char* program_name);
 const char* GetDataBaseFilename(int argc, const char** argv);
 const char* GetTreeErrorString(TreeErrorType error);
 void PrintTreeError(TreeErrorType error);
@@ -0,0 +1,475 @@
+#include "batch_diff.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "io_diff.h"
+#include "tree_base.h"
+#include "operations.h"
+#include "new_great_input.h"
+#include "tree_fingerprint.h"
+
+typedef struct {
+    ExpressionRecord* records;
+    size_t            n_records;
+    Tree*             trees;
+    size_t            next_record;  // общий счетчик, потоки забирают выражения пачками
+} BatchShared;
+
+typedef struct {
+    BatchShared*  shared;
+    VariableTable var_table;        // у каждого потока своя таблица, сливаются после разбора
+    size_t        n_failed;
+    pthread_t     thread;
+} BatchWorker;
+
+// ==================== РАЗБИЕНИЕ ФАЙЛА НА ВЫРАЖЕНИЯ ====================
+
+static TreeErrorType AppendRecord(ExpressionRecord** records, size_t* count, size_t* capacity,
+                                  ExpressionRecord record)
+{
+    if (*count == *capacity)
+    {
+        size_t new_capacity = (*capacity == 0) ? kBatchChunkSize : *capacity * 2;
+        ExpressionRecord* new_records = (ExpressionRecord*)realloc(*records, new_capacity * sizeof(ExpressionRecord));
+        if (!new_records)
+            return TREE_ERROR_ALLOCATION;
+
+        *records  = new_records;
+        *capacity = new_capacity;
+    }
+
+    (*records)[(*count)++] = record;
+    return TREE_ERROR_NO;
+}
+
+static void FreeRecords(ExpressionRecord* records, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (records[i].is_copy)
+            free(records[i].text);
+    }
+
+    free(records);
+}
+
+// выражения разделяются '\n' или '$'; терминатор '$' пишется прямо в приватное отображение
+static TreeErrorType SplitExpressionRecords(MappedFile* mapped, ExpressionRecord** records, size_t* count)
+{
+    assert(mapped);
+    assert(records);
+    assert(count);
+
+    char*  data = mapped->data;
+    size_t size = mapped->size;
+    size_t capacity = 0;
+    size_t pos = 0;
+
+    *records = NULL;
+    *count = 0;
+
+    while (pos < size)
+    {
+        while (pos < size && (isspace(data[pos]) || data[pos] == '$'))
+            pos++;
+
+        if (pos >= size)
+            break;
+
+        size_t begin = pos;
+        while (pos < size && data[pos] != '\n' && data[pos] != '$')
+            pos++;
+
+        size_t last = pos;
+        while (last > begin && isspace(data[last - 1]))
+            last--;
+
+        ExpressionRecord record = {};
+        if (last < size)
+        {
+            data[last] = '$';
+            record.text = data + begin;
+            record.is_copy = false;
+        }
+        else
+        {
+            size_t length = last - begin;
+            record.text = (char*)calloc(length + 2, sizeof(char));
+            if (!record.text)
+            {
+                FreeRecords(*records, *count);
+                return TREE_ERROR_ALLOCATION;
+            }
+
+            memcpy(record.text, data + begin, length);
+            record.text[length] = '$';
+            record.is_copy = true;
+        }
+
+        TreeErrorType error = AppendRecord(records, count, &capacity, record);
+        if (error != TREE_ERROR_NO)
+        {
+            if (record.is_copy)
+                free(record.text);
+            FreeRecords(*records, *count);
+            return error;
+        }
+    }
+
+    return TREE_ERROR_NO;
+}
+
+// ==================== ПАРАЛЛЕЛЬНЫЙ РАЗБОР ====================
+
+static void* ParseBatchWorker(void* argument)
+{
+    BatchWorker* worker = (BatchWorker*)argument;
+    BatchShared* shared = worker->shared;
+
+    while (true)
+    {
+        size_t first = __atomic_fetch_add(&shared->next_record, kBatchChunkSize, __ATOMIC_RELAXED);
+        if (first >= shared->n_records)
+            break;
+
+        size_t last = first + kBatchChunkSize;
+        if (last > shared->n_records)
+            last = shared->n_records;
+
+        for (size_t i = first; i < last; i++)
+        {
+            Tree* tree = &shared->trees[i];
+            TreeCtor(tree);
+
+            if (ParseExpressionIntoTree(tree, shared->records[i].text, &worker->var_table) != TREE_ERROR_NO)
+                worker->n_failed++;
+        }
+    }
+
+    return NULL;
+}
+
+static TreeErrorType MergeVariableTables(VariableTable* merged, VariableTable* part)
+{
+    for (int i = 0; i < part->number_of_variables; i++)
+    {
+        if (FindVariableByName(merged, part->variables[i].name) != -1)
+            continue;
+
+        TreeErrorType error = AddVariable(merged, part->variables[i].name);
+        if (error != TREE_ERROR_NO)
+            return error;
+    }
+
+    return TREE_ERROR_NO;
+}
+
+static int ChooseThreadCount(int requested, size_t n_records)
+{
+    long n_threads = (requested > 0) ? requested : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > kMaxBatchThreads)
+        n_threads = kMaxBatchThreads;
+
+    long max_useful = (long)((n_records + kBatchChunkSize - 1) / kBatchChunkSize);
+    if (max_useful >= 1 && n_threads > max_useful)
+        n_threads = max_useful;
+
+    return (int)n_threads;
+}
+
+static double GetMonotonicSeconds()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+TreeErrorType LoadExpressionBatch(const char* filename, int n_threads, ExpressionBatch* batch)
+{
+    if (filename == NULL || batch == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(batch, 0, sizeof(*batch));
+    InitVariableTable(&batch->var_table);
+
+    double start_time = GetMonotonicSeconds();
+
+    MappedFile mapped = {};
+    TreeErrorType error = MapInputFile(filename, &mapped);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    ExpressionRecord* records = NULL;
+    size_t n_records = 0;
+    error = SplitExpressionRecords(&mapped, &records, &n_records);
+    if (error != TREE_ERROR_NO)
+    {
+        UnmapInputFile(&mapped);
+        return error;
+    }
+
+    batch->trees = (Tree*)calloc(n_records + 1, sizeof(Tree));
+    batch->n_threads = ChooseThreadCount(n_threads, n_records);
+    BatchWorker* workers = (BatchWorker*)calloc((size_t)batch->n_threads, sizeof(BatchWorker));
+    if (!batch->trees || !workers)
+    {
+        free(workers);
+        FreeRecords(records, n_records);
+        UnmapInputFile(&mapped);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    BatchShared shared = {records, n_records, batch->trees, 0};
+
+    int n_started = 0;
+    for (int i = 0; i < batch->n_threads; i++)
+    {
+        workers[i].shared = &shared;
+        InitVariableTable(&workers[i].var_table);
+
+        if (pthread_create(&workers[i].thread, NULL, ParseBatchWorker, &workers[i]) != 0)
+        {
+            // таблица первого работника понадобится для разбора в текущем потоке
+            if (i > 0)
+                DestroyVariableTable(&workers[i].var_table);
+            break;
+        }
+        n_started++;
+    }
+
+    if (n_started == 0)
+    {
+        // потоки недоступны - разбираем в текущем
+        ParseBatchWorker(&workers[0]);
+    }
+
+    for (int i = 0; i < n_started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    batch->count = n_records;
+    batch->n_threads = (n_started > 0) ? n_started : 1;
+
+    // таблицы есть только у запущенных работников, остальные обнулены calloc
+    for (int i = 0; i < batch->n_threads; i++)
+    {
+        batch->n_failed += workers[i].n_failed;
+
+        if (error == TREE_ERROR_NO)
+            error = MergeVariableTables(&batch->var_table, &workers[i].var_table);
+
+        DestroyVariableTable(&workers[i].var_table);
+    }
+
+    free(workers);
+    FreeRecords(records, n_records);
+    UnmapInputFile(&mapped);
+
+    batch->parse_seconds = GetMonotonicSeconds() - start_time;
+
+    return error;
+}
+
+void DestroyExpressionBatch(ExpressionBatch* batch)
+{
+    if (batch == NULL)
+        return;
+
+    if (batch->trees != NULL)
+    {
+        for (size_t i = 0; i < batch->count; i++)
+            TreeDtor(&batch->trees[i]);
+
+        free(batch->trees);
+        batch->trees = NULL;
+    }
+
+    DestroyVariableTable(&batch->var_table);
+    batch->count = 0;
+    batch->n_failed = 0;
+}
+
+// ==================== ГРУППЫ РАВНЫХ ВЫРАЖЕНИЙ ====================
+
+// группа с теми же вычетами; residue_groups - открытая адресация номеров групп
+static size_t* FindResidueGroupSlot(size_t* residue_groups, size_t mask, const TreeFingerprint* fingerprints,
+                                    const size_t* representatives, const TreeFingerprint* fingerprint)
+{
+    size_t slot = HashFingerprintResidues(fingerprint) & mask;
+
+    while (residue_groups[slot] != SIZE_MAX &&
+           !FingerprintsProbablyEqual(&fingerprints[representatives[residue_groups[slot]]], fingerprint))
+        slot = (slot + 1) & mask;
+
+    return &residue_groups[slot];
+}
+
+// первая группа из списка groups, с представителем которой совпадает отпечаток;
+// groups == NULL - все группы по порядку
+static size_t FindGroupByValues(const size_t* groups, size_t n_groups, const TreeFingerprint* fingerprints,
+                                const size_t* representatives, const TreeFingerprint* fingerprint)
+{
+    for (size_t k = 0; k < n_groups; k++)
+    {
+        size_t group = (groups != NULL) ? groups[k] : k;
+        if (FingerprintsProbablyEqual(&fingerprints[representatives[group]], fingerprint))
+            return group;
+    }
+
+    return SIZE_MAX;
+}
+
+// два отпечатка с вычетами равны, только если равны вычеты, поэтому такие выражения
+// находят группу по хешу вычетов; отпечатки без вычетов сравниваются по значениям
+// с представителями групп, как и отпечатки с вычетами, не нашедшие группы по хешу.
+// Члены группы связаны в список next_member в порядке номеров
+static TreeErrorType PrintEquivalentGroups(ExpressionBatch* batch)
+{
+    size_t table_capacity = 1;
+    while (table_capacity < 2 * (batch->count + 1))
+        table_capacity *= 2;
+
+    TreeFingerprint* fingerprints = (TreeFingerprint*)calloc(batch->count + 1, sizeof(TreeFingerprint));
+    size_t* representatives = (size_t*)calloc(batch->count + 1, sizeof(size_t));
+    size_t* next_member     = (size_t*)calloc(batch->count + 1, sizeof(size_t));
+    size_t* last_member     = (size_t*)calloc(batch->count + 1, sizeof(size_t));
+    size_t* group_sizes     = (size_t*)calloc(batch->count + 1, sizeof(size_t));
+    size_t* value_groups    = (size_t*)calloc(batch->count + 1, sizeof(size_t));
+    size_t* residue_groups  = (size_t*)malloc(table_capacity * sizeof(size_t));
+
+    TreeErrorType error = (fingerprints && representatives && next_member && last_member && group_sizes &&
+                           value_groups && residue_groups) ? TREE_ERROR_NO : TREE_ERROR_ALLOCATION;
+
+    size_t n_groups       = 0;
+    size_t n_value_groups = 0;
+    size_t n_skipped      = 0;
+
+    if (error == TREE_ERROR_NO)
+    {
+        for (size_t slot = 0; slot < table_capacity; slot++)
+            residue_groups[slot] = SIZE_MAX;
+    }
+
+    for (size_t i = 0; i < batch->count && error == TREE_ERROR_NO; i++)
+    {
+        next_member[i] = SIZE_MAX;
+
+        if (batch->trees[i].root == NULL ||
+            ComputeTreeFingerprint(&batch->trees[i], &batch->var_table, &fingerprints[i]) != TREE_ERROR_NO)
+        {
+            n_skipped++;
+            continue;
+        }
+
+        const TreeFingerprint* fingerprint = &fingerprints[i];
+        bool is_hashed = fingerprint->has_residues && fingerprint->defined_count > 0;
+
+        size_t* residue_slot = NULL;
+        size_t group = SIZE_MAX;
+
+        if (is_hashed)
+        {
+            residue_slot = FindResidueGroupSlot(residue_groups, table_capacity - 1, fingerprints, representatives,
+                                                fingerprint);
+            group = *residue_slot;
+        }
+
+        if (group == SIZE_MAX)
+        {
+            group = fingerprint->has_residues
+                  ? FindGroupByValues(value_groups, n_value_groups, fingerprints, representatives, fingerprint)
+                  : FindGroupByValues(NULL,         n_groups,       fingerprints, representatives, fingerprint);
+        }
+
+        if (group == SIZE_MAX)
+        {
+            group = n_groups++;
+            representatives[group] = i;
+
+            if (is_hashed)
+                *residue_slot = group;
+            else if (!fingerprint->has_residues)
+                value_groups[n_value_groups++] = group;
+        }
+        else
+        {
+            next_member[last_member[group]] = i;
+        }
+
+        last_member[group] = i;
+        group_sizes[group]++;
+    }
+
+    size_t n_repeated = 0;
+    for (size_t group = 0; group < n_groups; group++)
+    {
+        if (group_sizes[group] < 2)
+            continue;
+
+        printf("Group %zu (%zu expressions):", ++n_repeated, group_sizes[group]);
+        for (size_t member = representatives[group]; member != SIZE_MAX; member = next_member[member])
+            printf(" #%zu", member + 1);
+        printf("\n");
+    }
+
+    if (error == TREE_ERROR_NO)
+    {
+        printf("Equivalence: %zu distinct expressions among %zu, %zu groups with repeats, %zu skipped\n",
+               n_groups, batch->count - n_skipped, n_repeated, n_skipped);
+    }
+
+    free(fingerprints);
+    free(representatives);
+    free(next_member);
+    free(last_member);
+    free(group_sizes);
+    free(value_groups);
+    free(residue_groups);
+    return error;
+}
+
+// ==================== РЕЖИМ ПАКЕТНОЙ ОБРАБОТКИ ====================
+
+TreeErrorType RunBatchMode(const ProgramOptions* options)
+{
+    if (options == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    ExpressionBatch batch = {};
+    TreeErrorType error = LoadExpressionBatch(options->input_filename, options->n_threads, &batch);
+    if (error != TREE_ERROR_NO)
+    {
+        DestroyExpressionBatch(&batch);
+        return error;
+    }
+
+    size_t total_nodes = 0;
+    for (size_t i = 0; i < batch.count; i++)
+        total_nodes += batch.trees[i].size;
+
+    double throughput = (batch.parse_seconds > 0) ? (double)batch.count / batch.parse_seconds : 0.0;
+
+    printf("Batch: parsed %zu expressions (%zu failed) in %.3f s using %d threads\n",
+           batch.count, batch.n_failed, batch.parse_seconds, batch.n_threads);
+    printf("Throughput: %.0f expressions/second\n", throughput);
+    printf("Total nodes: %zu\n", total_nodes);
+
+    printf("Variables (%d):", batch.var_table.number_of_variables);
+    for (int i = 0; i < batch.var_table.number_of_variables; i++)
+        printf(" %s", batch.var_table.variables[i].name);
+    printf("\n");
+
+    if (options->group_equivalent)
+        error = PrintEquivalentGroups(&batch);
+
+    DestroyExpressionBatch(&batch);
+    return error;
+}
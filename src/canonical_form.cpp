@@ -0,0 +1,473 @@
+#include "canonical_form.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "operations.h"
+#include "logic_functions.h"
+#include "DSL.h"
+
+// ==================== СЛАГАЕМЫЕ И МНОЖИТЕЛИ ====================
+
+typedef struct {
+    Node*  base;          // каноническое поддерево, принадлежит множителю
+    double exponent;
+} Factor;
+
+// coefficient * base_1^exponent_1 * ... * base_n^exponent_n
+typedef struct {
+    double  coefficient;
+    Factor* factors;
+    size_t  n_factors;
+    size_t  capacity;
+} Term;
+
+typedef struct {
+    Term*  terms;
+    size_t n_terms;
+    size_t capacity;
+} TermList;
+
+static int CompareNumbers(double first, double second)
+{
+    if (first < second) return -1;
+    if (first > second) return  1;
+    return 0;
+}
+
+static int GetNodeRank(NodeType type)
+{
+    switch (type)
+    {
+        case NODE_NUM: return 0;
+        case NODE_VAR: return 1;
+        case NODE_OP:  return 2;
+        default:       return 3;
+    }
+}
+
+int CompareCanonicalNodes(Node* first, Node* second)
+{
+    if (first == second)  return 0;
+    if (first == NULL)    return -1;
+    if (second == NULL)   return 1;
+
+    if (first->type != second->type)
+        return (GetNodeRank(first->type) < GetNodeRank(second->type)) ? -1 : 1;
+
+    switch (first->type)
+    {
+        case NODE_NUM:
+            return CompareNumbers(first->data.num_value, second->data.num_value);
+
+        case NODE_VAR:
+        {
+            const char* first_name  = first->data.var_definition.name  ? first->data.var_definition.name  : "";
+            const char* second_name = second->data.var_definition.name ? second->data.var_definition.name : "";
+            int result = strcmp(first_name, second_name);
+            return (result > 0) - (result < 0);
+        }
+
+        case NODE_OP:
+        {
+            if (first->data.op_value != second->data.op_value)
+                return (first->data.op_value < second->data.op_value) ? -1 : 1;
+
+            int result = CompareCanonicalNodes(first->left, second->left);
+            if (result != 0)
+                return result;
+
+            return CompareCanonicalNodes(first->right, second->right);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void DestroyTerm(Term* term)
+{
+    for (size_t i = 0; i < term->n_factors; i++)
+        FreeSubtree(term->factors[i].base);
+
+    free(term->factors);
+    term->factors = NULL;
+    term->n_factors = 0;
+    term->capacity = 0;
+}
+
+static void DestroyTermList(TermList* list)
+{
+    for (size_t i = 0; i < list->n_terms; i++)
+        DestroyTerm(&list->terms[i]);
+
+    free(list->terms);
+    list->terms = NULL;
+    list->n_terms = 0;
+    list->capacity = 0;
+}
+
+// base переходит во владение слагаемого, при ошибке освобождается
+static bool AppendFactor(Term* term, Node* base, double exponent)
+{
+    if (term->n_factors == term->capacity)
+    {
+        size_t new_capacity = (term->capacity == 0) ? 4 : term->capacity * 2;
+        Factor* new_factors = (Factor*)realloc(term->factors, new_capacity * sizeof(Factor));
+        if (!new_factors)
+        {
+            FreeSubtree(base);
+            return false;
+        }
+
+        term->factors = new_factors;
+        term->capacity = new_capacity;
+    }
+
+    term->factors[term->n_factors++] = {base, exponent};
+    return true;
+}
+
+static bool AppendTerm(TermList* list, Term* term)
+{
+    if (list->n_terms == list->capacity)
+    {
+        size_t new_capacity = (list->capacity == 0) ? 8 : list->capacity * 2;
+        Term* new_terms = (Term*)realloc(list->terms, new_capacity * sizeof(Term));
+        if (!new_terms)
+        {
+            DestroyTerm(term);
+            return false;
+        }
+
+        list->terms = new_terms;
+        list->capacity = new_capacity;
+    }
+
+    list->terms[list->n_terms++] = *term;
+    return true;
+}
+
+// ==================== РАЗВОРАЧИВАНИЕ ЦЕПОЧЕК ====================
+
+static bool CollectFactors(Node* node, Term* term)
+{
+    if (node == NULL)
+        return false;
+
+    if (IsNodeType(node, NODE_NUM))
+    {
+        term->coefficient *= node->data.num_value;
+        return true;
+    }
+
+    if (IsNodeOp(node, OP_MUL))
+        return CollectFactors(node->left, term) && CollectFactors(node->right, term);
+
+    if (IsNodeOp(node, OP_POW) && IsNodeType(node->right, NODE_NUM))
+    {
+        Node* base = BuildCanonicalForm(node->left);
+        if (base == NULL)
+            return false;
+
+        return AppendFactor(term, base, node->right->data.num_value);
+    }
+
+    Node* canonical = BuildCanonicalForm(node);
+    if (canonical == NULL)
+        return false;
+
+    // сумма могла свернуться в произведение: x + x -> 2*x
+    if (IsNodeType(canonical, NODE_NUM) || IsNodeOp(canonical, OP_MUL) ||
+        (IsNodeOp(canonical, OP_POW) && IsNodeType(canonical->right, NODE_NUM)))
+    {
+        bool is_collected = CollectFactors(canonical, term);
+        FreeSubtree(canonical);
+        return is_collected;
+    }
+
+    return AppendFactor(term, canonical, 1.0);
+}
+
+static int CompareFactors(const void* first, const void* second)
+{
+    const Factor* first_factor  = (const Factor*)first;
+    const Factor* second_factor = (const Factor*)second;
+
+    int result = CompareCanonicalNodes(first_factor->base, second_factor->base);
+    if (result != 0)
+        return result;
+
+    return CompareNumbers(first_factor->exponent, second_factor->exponent);
+}
+
+static bool IsKnownNonzero(Node* node)
+{
+    if (node->type == NODE_NUM)
+        return !is_zero(node->data.num_value);
+
+    return node->type == NODE_OP && (node->data.op_value == OP_EXP || node->data.op_value == OP_COSH);
+}
+
+// степени одного основания складываются без потери области определения, только если
+// показатели целые и не могут сократить полюс: x * x^2 -> x^3, но x * x^-1 и
+// x^0.5 * x^0.5 остаются как есть
+static bool CanMergeFactors(const Factor* factors, size_t n_factors)
+{
+    bool has_positive = false;
+    bool has_negative = false;
+
+    for (size_t i = 0; i < n_factors; i++)
+    {
+        double exponent = factors[i].exponent;
+        if (!is_zero(exponent - floor(exponent)))
+            return false;
+
+        has_positive = has_positive || exponent > 0;
+        has_negative = has_negative || exponent < 0;
+    }
+
+    return !(has_positive && has_negative) || IsKnownNonzero(factors[0].base);
+}
+
+static void NormalizeTerm(Term* term)
+{
+    if (term->n_factors > 1)
+        qsort(term->factors, term->n_factors, sizeof(Factor), CompareFactors);
+
+    size_t n_kept = 0;
+    size_t begin  = 0;
+    while (begin < term->n_factors)
+    {
+        size_t end = begin + 1;
+        while (end < term->n_factors && CompareCanonicalNodes(term->factors[begin].base, term->factors[end].base) == 0)
+            end++;
+
+        if (!CanMergeFactors(&term->factors[begin], end - begin))
+        {
+            for (size_t i = begin; i < end; i++)
+                term->factors[n_kept++] = term->factors[i];
+
+            begin = end;
+            continue;
+        }
+
+        Factor merged = term->factors[begin];
+        for (size_t i = begin + 1; i < end; i++)
+        {
+            merged.exponent += term->factors[i].exponent;
+            FreeSubtree(term->factors[i].base);
+        }
+
+        // нулевая сумма возможна только у ненулевого основания или у одиночного x^0
+        if (is_zero(merged.exponent))
+            FreeSubtree(merged.base);
+        else
+            term->factors[n_kept++] = merged;
+
+        begin = end;
+    }
+
+    term->n_factors = n_kept;
+}
+
+// подобные слагаемые сравниваются как равные, коэффициент не учитывается
+static int CompareTerms(const void* first, const void* second)
+{
+    const Term* first_term  = (const Term*)first;
+    const Term* second_term = (const Term*)second;
+
+    for (size_t i = 0; i < first_term->n_factors && i < second_term->n_factors; i++)
+    {
+        int result = CompareFactors(&first_term->factors[i], &second_term->factors[i]);
+        if (result != 0)
+            return result;
+    }
+
+    if (first_term->n_factors != second_term->n_factors)
+        return (first_term->n_factors < second_term->n_factors) ? -1 : 1;
+
+    return 0;
+}
+
+static bool CollectTerms(Node* node, double sign, TermList* list)
+{
+    if (IsNodeOp(node, OP_ADD))
+        return CollectTerms(node->left, sign, list) && CollectTerms(node->right, sign, list);
+
+    if (IsNodeOp(node, OP_SUB))
+        return CollectTerms(node->left, sign, list) && CollectTerms(node->right, -sign, list);
+
+    Term term = {};
+    term.coefficient = sign;
+
+    if (!CollectFactors(node, &term))
+    {
+        DestroyTerm(&term);
+        return false;
+    }
+
+    NormalizeTerm(&term);
+    return AppendTerm(list, &term);
+}
+
+static void MergeLikeTerms(TermList* list)
+{
+    if (list->n_terms > 1)
+        qsort(list->terms, list->n_terms, sizeof(Term), CompareTerms);
+
+    size_t n_merged = 0;
+    for (size_t i = 0; i < list->n_terms; i++)
+    {
+        if (n_merged > 0 && CompareTerms(&list->terms[n_merged - 1], &list->terms[i]) == 0)
+        {
+            list->terms[n_merged - 1].coefficient += list->terms[i].coefficient;
+            DestroyTerm(&list->terms[i]);
+        }
+        else
+        {
+            list->terms[n_merged++] = list->terms[i];
+        }
+    }
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < n_merged; i++)
+    {
+        if (is_zero(list->terms[i].coefficient))
+            DestroyTerm(&list->terms[i]);
+        else
+            list->terms[n_kept++] = list->terms[i];
+    }
+
+    list->n_terms = n_kept;
+}
+
+// ==================== СБОРКА ДЕРЕВА ====================
+
+static Node* BuildFactor(const Factor* factor)
+{
+    if (CompareNumbers(factor->exponent, 1.0) == 0)
+        return COPY(factor->base);
+
+    return POW(COPY(factor->base), NUM(factor->exponent));
+}
+
+static Node* BuildProduct(const Term* term, double coefficient)
+{
+    if (is_zero(coefficient))
+        return NUM(0.0);
+
+    Node* product = NULL;
+    if (term->n_factors == 0 || CompareNumbers(coefficient, 1.0) != 0)
+        product = NUM(coefficient);
+
+    for (size_t i = 0; i < term->n_factors; i++)
+    {
+        Node* factor = BuildFactor(&term->factors[i]);
+        product = (product == NULL) ? factor : MUL(product, factor);
+    }
+
+    return product;
+}
+
+// слагаемые с отрицательным коэффициентом вычитаются, свободный член - последним
+static Node* BuildSum(const TermList* list)
+{
+    Node* sum = NULL;
+    const Term* constant = NULL;
+
+    for (size_t i = 0; i < list->n_terms; i++)
+    {
+        const Term* term = &list->terms[i];
+        if (term->n_factors == 0)
+        {
+            constant = term;
+            continue;
+        }
+
+        if (sum == NULL)
+            sum = BuildProduct(term, term->coefficient);
+        else if (term->coefficient < 0)
+            sum = SUB(sum, BuildProduct(term, -term->coefficient));
+        else
+            sum = ADD(sum, BuildProduct(term, term->coefficient));
+    }
+
+    if (constant != NULL)
+    {
+        if (sum == NULL)
+            sum = NUM(constant->coefficient);
+        else if (constant->coefficient < 0)
+            sum = SUB(sum, NUM(-constant->coefficient));
+        else
+            sum = ADD(sum, NUM(constant->coefficient));
+    }
+
+    return (sum != NULL) ? sum : NUM(0.0);
+}
+
+Node* BuildCanonicalForm(Node* node)
+{
+    if (node == NULL)
+        return NULL;
+
+    if (node->type != NODE_OP)
+        return COPY(node);
+
+    OperationType op = node->data.op_value;
+
+    if (op == OP_ADD || op == OP_SUB)
+    {
+        TermList list = {};
+        if (!CollectTerms(node, 1.0, &list))
+        {
+            DestroyTermList(&list);
+            return NULL;
+        }
+
+        MergeLikeTerms(&list);
+        Node* sum = BuildSum(&list);
+        DestroyTermList(&list);
+        return sum;
+    }
+
+    if (op == OP_MUL || (op == OP_POW && IsNodeType(node->right, NODE_NUM)))
+    {
+        Term term = {};
+        term.coefficient = 1.0;
+
+        if (!CollectFactors(node, &term))
+        {
+            DestroyTerm(&term);
+            return NULL;
+        }
+
+        NormalizeTerm(&term);
+        Node* product = BuildProduct(&term, term.coefficient);
+        DestroyTerm(&term);
+        return product;
+    }
+
+    Node* left = NULL;
+    if (is_binary(op))
+    {
+        left = BuildCanonicalForm(node->left);
+        if (left == NULL)
+            return NULL;
+    }
+
+    Node* right = BuildCanonicalForm(node->right);
+    if (right == NULL)
+    {
+        FreeSubtree(left);
+        return NULL;
+    }
+
+    ValueOfTreeElement data = {};
+    data.op_value = op;
+    return CreateNode(NODE_OP, data, left, right);
+}
+
+#include "DSL_undef.h"
@@ -0,0 +1,238 @@
+#include "compact_tree.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "operations.h"
+#include "logic_functions.h"
+#include "tree_traversal.h"
+
+// ==================== ХРАНЕНИЕ ====================
+
+void InitCompactTree(CompactTree* tree)
+{
+    assert(tree);
+
+    memset(tree, 0, sizeof(*tree));
+}
+
+void DestroyCompactTree(CompactTree* tree)
+{
+    if (tree == NULL)
+        return;
+
+    free(tree->nodes);
+    free(tree->constants);
+    free(tree->parents);
+    InitCompactTree(tree);
+}
+
+static bool ReserveCompactNodes(CompactTree* tree, uint32_t n_nodes)
+{
+    if (n_nodes <= tree->capacity)
+        return true;
+
+    uint32_t new_capacity = (tree->capacity == 0) ? kCompactTreeInitialCapacity : tree->capacity;
+    while (new_capacity < n_nodes)
+        new_capacity = (new_capacity > kNoCompactNode / 2) ? kNoCompactNode : new_capacity * 2;
+
+    CompactNode* new_nodes = (CompactNode*)realloc(tree->nodes, (size_t)new_capacity * sizeof(CompactNode));
+    if (!new_nodes)
+        return false;
+
+    tree->nodes    = new_nodes;
+    tree->capacity = new_capacity;
+    return true;
+}
+
+static bool ReserveCompactConstants(CompactTree* tree, uint32_t n_constants)
+{
+    if (n_constants <= tree->constants_capacity)
+        return true;
+
+    uint32_t new_capacity = (tree->constants_capacity == 0) ? kCompactTreeInitialCapacity : tree->constants_capacity;
+    while (new_capacity < n_constants)
+        new_capacity = (new_capacity > kNoCompactNode / 2) ? kNoCompactNode : new_capacity * 2;
+
+    double* new_constants = (double*)realloc(tree->constants, (size_t)new_capacity * sizeof(double));
+    if (!new_constants)
+        return false;
+
+    tree->constants          = new_constants;
+    tree->constants_capacity = new_capacity;
+    return true;
+}
+
+// номер нового узла, kNoCompactNode - не хватило памяти или номеров
+static uint32_t AppendCompactNode(CompactTree* tree, uint8_t code, uint32_t left, uint32_t right, uint32_t value)
+{
+    if (tree->n_nodes == kNoCompactNode || !ReserveCompactNodes(tree, tree->n_nodes + 1))
+        return kNoCompactNode;
+
+    CompactNode* node = &tree->nodes[tree->n_nodes];
+    node->code  = code;
+    node->left  = left;
+    node->right = right;
+    node->value = value;
+
+    return tree->n_nodes++;
+}
+
+static uint32_t AppendCompactNumber(CompactTree* tree, double value)
+{
+    if (tree->n_constants == kNoCompactNode || !ReserveCompactConstants(tree, tree->n_constants + 1))
+        return kNoCompactNode;
+
+    uint32_t node = AppendCompactNode(tree, COMPACT_NUM, kNoCompactNode, kNoCompactNode, tree->n_constants);
+    if (node == kNoCompactNode)
+        return kNoCompactNode;
+
+    tree->constants[tree->n_constants++] = value;
+    return node;
+}
+
+// ==================== ПРЕОБРАЗОВАНИЕ ИЗ NODE ====================
+
+static uint32_t AppendCompactCopy(CompactTree* tree, Node* node, uint32_t left, uint32_t right,
+                                  VariableTable* var_table, TreeErrorType* error)
+{
+    switch (node->type)
+    {
+        case NODE_NUM:
+            return AppendCompactNumber(tree, node->data.num_value);
+
+        case NODE_VAR:
+        {
+            int slot = (node->data.var_definition.name != NULL) ?
+                       FindVariableByName(var_table, node->data.var_definition.name) : -1;
+            if (slot < 0)
+            {
+                *error = TREE_ERROR_VARIABLE_NOT_FOUND;
+                return kNoCompactNode;
+            }
+
+            return AppendCompactNode(tree, COMPACT_VAR, kNoCompactNode, kNoCompactNode, (uint32_t)slot);
+        }
+
+        case NODE_OP:
+            if (node->data.op_value < 0 || node->data.op_value >= OP_COUNT)
+            {
+                *error = TREE_ERROR_UNKNOWN_OPERATION;
+                return kNoCompactNode;
+            }
+
+            return AppendCompactNode(tree, (uint8_t)node->data.op_value, left, right, 0);
+
+        default:
+            *error = TREE_ERROR_UNKNOWN_OPERATION;
+            return kNoCompactNode;
+    }
+}
+
+// узлы выкладываются в обратном порядке обхода, поэтому дети всегда раньше родителя
+TreeErrorType BuildCompactTree(Node* root, VariableTable* var_table, CompactTree* tree)
+{
+    if (root == NULL || var_table == NULL || tree == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    InitCompactTree(tree);
+
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, root);
+
+    TraversalFrame* frame = NULL;
+    while (error == TREE_ERROR_NO && (frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        if (frame->event != TRAVERSAL_LEAVE)
+            continue;
+
+        Node* node = frame->node;
+        uint32_t left  = (node->left  != NULL) ? frame->left_result.index  : kNoCompactNode;
+        uint32_t right = (node->right != NULL) ? frame->right_result.index : kNoCompactNode;
+
+        uint32_t index = AppendCompactCopy(tree, node, left, right, var_table, &error);
+        if (index == kNoCompactNode && error == TREE_ERROR_NO)
+            error = TREE_ERROR_ALLOCATION;
+
+        TraversalResultSlot(&traversal)->index = index;
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+
+    if (error != TREE_ERROR_NO)
+        DestroyCompactTree(tree);
+
+    return error;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ ====================
+
+TreeErrorType EvaluateCompactTree(const CompactTree* tree, const double* values, double* result)
+{
+    if (tree == NULL || values == NULL || result == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (tree->n_nodes == 0)
+        return TREE_ERROR_NULL_PTR;
+
+    double* results = (double*)calloc(tree->n_nodes, sizeof(double));
+    if (!results)
+        return TREE_ERROR_ALLOCATION;
+
+    TreeErrorType error = TREE_ERROR_NO;
+    for (uint32_t i = 0; i < tree->n_nodes && error == TREE_ERROR_NO; i++)
+    {
+        const CompactNode* node = &tree->nodes[i];
+
+        switch (node->code)
+        {
+            case COMPACT_NUM:
+                results[i] = tree->constants[node->value];
+                break;
+
+            case COMPACT_VAR:
+                results[i] = values[node->value];
+                break;
+
+            default:
+            {
+                double left = (node->left != kNoCompactNode) ? results[node->left] : 0.0;
+                error = ApplyOperation((OperationType)node->code, left, results[node->right], &results[i]);
+                break;
+            }
+        }
+    }
+
+    if (error == TREE_ERROR_NO)
+        *result = results[tree->n_nodes - 1];
+
+    free(results);
+    return error;
+}
+
+TreeErrorType BuildCompactParents(CompactTree* tree)
+{
+    if (tree == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    uint32_t* parents = (uint32_t*)realloc(tree->parents, ((size_t)tree->n_nodes + 1) * sizeof(uint32_t));
+    if (!parents)
+        return TREE_ERROR_ALLOCATION;
+
+    for (uint32_t i = 0; i < tree->n_nodes; i++)
+        parents[i] = kNoCompactNode;
+
+    for (uint32_t i = 0; i < tree->n_nodes; i++)
+    {
+        if (tree->nodes[i].left != kNoCompactNode)
+            parents[tree->nodes[i].left] = i;
+        if (tree->nodes[i].right != kNoCompactNode)
+            parents[tree->nodes[i].right] = i;
+    }
+
+    tree->parents = parents;
+    return TREE_ERROR_NO;
+}
@@ -0,0 +1,139 @@
+#include "cost_model.h"
+
+#include <assert.h>
+#include <time.h>
+
+#include "operations.h"
+#include "tree_traversal.h"
+
+// ==================== ТАБЛИЦА СТОИМОСТЕЙ ====================
+
+// относительные стоимости, округленные до половины сложения; в каждую входит вызов
+// ApplyOperation, как и при обходе дерева. В отладочной сборке compile.sh (-O0,
+// ASan/UBSan) накладные расходы вызова сжимают замеренные отношения примерно вдвое
+static const double operation_costs[OP_COUNT] = {
+    /* OP_ADD */    1.0,
+    /* OP_SUB */    1.0,
+    /* OP_MUL */    1.0,
+    /* OP_DIV */    1.5,
+    /* OP_POW */    5.5,
+    /* OP_SIN */    3.0,
+    /* OP_COS */    2.5,
+    /* OP_TAN */    3.5,
+    /* OP_COT */    4.5,
+    /* OP_ARCSIN */ 3.0,
+    /* OP_ARCCOS */ 3.0,
+    /* OP_ARCTAN */ 3.0,
+    /* OP_ARCCOT */ 3.0,
+    /* OP_SINH */   4.5,
+    /* OP_COSH */   3.5,
+    /* OP_TANH */   4.5,
+    /* OP_COTH */   5.5,
+    /* OP_LN */     2.5,
+    /* OP_EXP */    2.5,
+    /* OP_SQRT */   1.0
+};
+
+static const char* const operation_names[OP_COUNT] = {
+    "ADD", "SUB", "MUL", "DIV", "POW", "SIN", "COS", "TAN", "COT", "ARCSIN", "ARCCOS",
+    "ARCTAN", "ARCCOT", "SINH", "COSH", "TANH", "COTH", "LN", "EXP", "SQRT"
+};
+
+double GetOperationCost(OperationType op)
+{
+    if (op < 0 || op >= OP_COUNT)
+        return 0.0;
+
+    return operation_costs[op];
+}
+
+// сумма по узлам не зависит от порядка обхода: все стоимости кратны 0.5 и
+// складываются точно
+double EstimateTreeCost(Node* node)
+{
+    TreeTraversal traversal = {};
+    if (node == NULL || BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
+        return 0.0;
+
+    double cost = 0.0;
+    Node* current = NULL;
+    while ((current = NextPreOrderNode(&traversal)) != NULL)
+        cost += (current->type == NODE_OP) ? GetOperationCost(current->data.op_value) : kLeafEvaluationCost;
+
+    EndTreeTraversal(&traversal);
+    return cost;
+}
+
+// ==================== МИКРОБЕНЧМАРК ====================
+
+static double GetBenchmarkSeconds()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// аргументы из (0.1, 0.9) лежат в области определения всех операций
+static double TimeOperation(OperationType op, const double* inputs, size_t n_iterations)
+{
+    static volatile double sink = 0.0;
+    double best = 0.0;
+
+    for (int repeat = 0; repeat < kCostBenchmarkRepeats; repeat++)
+    {
+        double sum = 0.0;
+        double start = GetBenchmarkSeconds();
+
+        for (size_t i = 0; i < n_iterations; i++)
+        {
+            double left  = inputs[i % kCostBenchmarkInputs];
+            double right = inputs[(i * 7 + 3) % kCostBenchmarkInputs];
+            double value = 0.0;
+
+            ApplyOperation(op, left, right, &value);
+            sum += value;
+        }
+
+        double elapsed = GetBenchmarkSeconds() - start;
+        sink = sink + sum;
+
+        if (repeat == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+TreeErrorType MeasureOperationCosts(double* costs, size_t n_iterations)
+{
+    if (costs == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (n_iterations == 0)
+        return TREE_ERROR_INVALID_INPUT;
+
+    double inputs[kCostBenchmarkInputs] = {};
+    for (size_t i = 0; i < kCostBenchmarkInputs; i++)
+        inputs[i] = 0.1 + 0.8 * (double)((i * 37) % kCostBenchmarkInputs) / (double)kCostBenchmarkInputs;
+
+    // первый прогон прогревает кеши и частоту процессора
+    TimeOperation(OP_ADD, inputs, n_iterations);
+    double base = TimeOperation(OP_ADD, inputs, n_iterations);
+    if (base <= 0.0)
+        return TREE_ERROR_INVALID_INPUT;
+
+    for (int op = 0; op < OP_COUNT; op++)
+        costs[op] = TimeOperation((OperationType)op, inputs, n_iterations) / base;
+
+    return TREE_ERROR_NO;
+}
+
+void PrintOperationCostTable(FILE* file, const double* costs)
+{
+    assert(file);
+    assert(costs);
+
+    fprintf(file, "Operation costs (ADD = 1):\n");
+    for (int op = 0; op < OP_COUNT; op++)
+        fprintf(file, "  %-7s %6.2f  (table: %.1f)\n", operation_names[op], costs[op], operation_costs[op]);
+}
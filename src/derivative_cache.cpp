@@ -0,0 +1,282 @@
+#include "derivative_cache.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tree_base.h"
+#include "tree_serialize.h"
+
+typedef struct {
+    char            name[kMaxLengthOfFilename];
+    struct timespec last_used;  // st_mtim: записи, тронутые в одну секунду, различаются наносекундами
+    size_t          size;
+} CacheEntryInfo;
+
+// ==================== КЛЮЧ ЗАПИСИ ====================
+
+static uint64_t HashBytes(uint64_t hash, const void* bytes, size_t n_bytes)
+{
+    const unsigned char* current = (const unsigned char*)bytes;
+
+    for (size_t i = 0; i < n_bytes; i++)
+    {
+        hash ^= current[i];
+        hash *= kCacheHashPrime;
+    }
+
+    return hash;
+}
+
+static TreeErrorType ComputeCacheKey(DerivativeCache* cache, Tree* source, const char* variable, int order,
+                                     uint64_t* key)
+{
+    unsigned char* data = NULL;
+    size_t size = 0;
+
+    TreeErrorType error = SerializeTrees(NULL, source, 1, &data, &size);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    uint64_t hash = kCacheHashOffset;
+    hash = HashBytes(hash, data, size);
+    hash = HashBytes(hash, variable, strlen(variable) + 1);
+    hash = HashBytes(hash, &order, sizeof(order));
+    hash = HashBytes(hash, &cache->optimization_level, sizeof(cache->optimization_level));
+
+    free(data);
+    *key = hash;
+    return TREE_ERROR_NO;
+}
+
+static void MakeEntryLabel(DerivativeCache* cache, char* label, size_t label_size, const char* variable, int order)
+{
+    snprintf(label, label_size, "%s#%d/O%d", variable, order, (int)cache->optimization_level);
+}
+
+static bool MakeEntryPath(DerivativeCache* cache, uint64_t key, char* path, size_t path_size)
+{
+    int length = snprintf(path, path_size, "%s/%016llx%s", cache->directory,
+                          (unsigned long long)key, kCacheEntrySuffix);
+    return length > 0 && (size_t)length < path_size;
+}
+
+// ==================== ИНИЦИАЛИЗАЦИЯ ====================
+
+TreeErrorType InitDerivativeCache(DerivativeCache* cache, const char* directory, size_t max_bytes,
+                                  OptimizationLevel optimization_level)
+{
+    if (cache == NULL || directory == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+        return TREE_ERROR_OPENING_FILE;
+
+    // EEXIST бывает и у обычного файла с тем же именем
+    struct stat info = {};
+    if (stat(directory, &info) != 0 || !S_ISDIR(info.st_mode))
+        return TREE_ERROR_OPENING_FILE;
+
+    cache->directory = directory;
+    cache->max_bytes = max_bytes;
+    cache->optimization_level = optimization_level;
+    return TREE_ERROR_NO;
+}
+
+// ==================== ПОИСК И ЗАПИСЬ ====================
+
+TreeErrorType LookupCachedDerivative(DerivativeCache* cache, Tree* source, const char* variable, int order,
+                                     Tree* derivative, bool* found)
+{
+    if (cache == NULL || source == NULL || variable == NULL || derivative == NULL || found == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    *found = false;
+
+    uint64_t key = 0;
+    TreeErrorType error = ComputeCacheKey(cache, source, variable, order, &key);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    char path[kMaxLengthOfFilename] = {0};
+    if (!MakeEntryPath(cache, key, path, sizeof(path)) || access(path, R_OK) != 0)
+        return TREE_ERROR_NO;
+
+    Tree stored[2] = {};
+    char label[kMaxCacheLabelLength] = {0};
+    int  n_stored = 0;
+
+    // битая или чужая запись - просто промах, ее перезапишут
+    if (LoadTreesFromFile(path, label, sizeof(label), stored, 2, &n_stored) != TREE_ERROR_NO)
+        return TREE_ERROR_NO;
+
+    char expected_label[kMaxCacheLabelLength] = {0};
+    MakeEntryLabel(cache, expected_label, sizeof(expected_label), variable, order);
+
+    if (n_stored == 2 && strcmp(label, expected_label) == 0 && TreesHaveSameStructure(&stored[0], source))
+    {
+        TreeDtor(derivative);
+        *derivative = stored[1];
+        stored[1] = {};
+        *found = true;
+
+        // время изменения служит отметкой последнего использования для вытеснения
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+
+    for (int i = 0; i < n_stored; i++)
+        TreeDtor(&stored[i]);
+
+    return TREE_ERROR_NO;
+}
+
+TreeErrorType StoreCachedDerivative(DerivativeCache* cache, Tree* source, const char* variable, int order,
+                                    Tree* derivative)
+{
+    if (cache == NULL || source == NULL || variable == NULL || derivative == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    uint64_t key = 0;
+    TreeErrorType error = ComputeCacheKey(cache, source, variable, order, &key);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    char path[kMaxLengthOfFilename] = {0};
+    char temp_path[kMaxLengthOfFilename] = {0};
+    if (!MakeEntryPath(cache, key, path, sizeof(path)))
+        return TREE_ERROR_OPENING_FILE;
+
+    int length = snprintf(temp_path, sizeof(temp_path), "%s.tmp.%ld", path, (long)getpid());
+    if (length <= 0 || (size_t)length >= sizeof(temp_path))
+        return TREE_ERROR_OPENING_FILE;
+
+    char label[kMaxCacheLabelLength] = {0};
+    MakeEntryLabel(cache, label, sizeof(label), variable, order);
+
+    Tree entry[2] = {*source, *derivative};
+
+    // запись во временный файл и rename: другие процессы видят либо старую запись, либо целую новую
+    error = SaveTreesToFile(temp_path, label, entry, 2);
+    if (error == TREE_ERROR_NO && rename(temp_path, path) != 0)
+        error = TREE_ERROR_IO;
+
+    if (error != TREE_ERROR_NO)
+    {
+        unlink(temp_path);
+        return error;
+    }
+
+    return EvictDerivativeCache(cache);
+}
+
+// ==================== ВЫТЕСНЕНИЕ ====================
+
+static bool IsCacheEntryName(const char* name)
+{
+    size_t name_length = strlen(name);
+    size_t suffix_length = strlen(kCacheEntrySuffix);
+
+    return name_length > suffix_length && strcmp(name + name_length - suffix_length, kCacheEntrySuffix) == 0;
+}
+
+static int CompareEntriesByLastUse(const void* first, const void* second)
+{
+    const CacheEntryInfo* first_entry  = (const CacheEntryInfo*)first;
+    const CacheEntryInfo* second_entry = (const CacheEntryInfo*)second;
+
+    if (first_entry->last_used.tv_sec  != second_entry->last_used.tv_sec)
+        return (first_entry->last_used.tv_sec  < second_entry->last_used.tv_sec)  ? -1 : 1;
+    if (first_entry->last_used.tv_nsec != second_entry->last_used.tv_nsec)
+        return (first_entry->last_used.tv_nsec < second_entry->last_used.tv_nsec) ? -1 : 1;
+    return strcmp(first_entry->name, second_entry->name);
+}
+
+static TreeErrorType CollectCacheEntries(DerivativeCache* cache, CacheEntryInfo** entries,
+                                         size_t* n_entries, size_t* total_bytes)
+{
+    DIR* directory = opendir(cache->directory);
+    if (!directory)
+        return TREE_ERROR_OPENING_FILE;
+
+    size_t capacity = 0;
+    *entries = NULL;
+    *n_entries = 0;
+    *total_bytes = 0;
+
+    struct dirent* item = NULL;
+    while ((item = readdir(directory)) != NULL)
+    {
+        if (!IsCacheEntryName(item->d_name) || strlen(item->d_name) >= kMaxLengthOfFilename)
+            continue;
+
+        struct stat info = {};
+        if (fstatat(dirfd(directory), item->d_name, &info, 0) != 0 || !S_ISREG(info.st_mode))
+            continue;
+
+        if (*n_entries == capacity)
+        {
+            size_t new_capacity = (capacity == 0) ? kBatchChunkSize : capacity * 2;
+            CacheEntryInfo* new_entries = (CacheEntryInfo*)realloc(*entries, new_capacity * sizeof(CacheEntryInfo));
+            if (!new_entries)
+            {
+                closedir(directory);
+                free(*entries);
+                *entries = NULL;
+                return TREE_ERROR_ALLOCATION;
+            }
+
+            *entries = new_entries;
+            capacity = new_capacity;
+        }
+
+        CacheEntryInfo* entry = &(*entries)[(*n_entries)++];
+        strcpy(entry->name, item->d_name);
+        entry->last_used = info.st_mtim;
+        entry->size = (size_t)info.st_size;
+
+        *total_bytes += entry->size;
+    }
+
+    closedir(directory);
+    return TREE_ERROR_NO;
+}
+
+TreeErrorType EvictDerivativeCache(DerivativeCache* cache)
+{
+    if (cache == NULL || cache->directory == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    CacheEntryInfo* entries = NULL;
+    size_t n_entries = 0;
+    size_t total_bytes = 0;
+
+    TreeErrorType error = CollectCacheEntries(cache, &entries, &n_entries, &total_bytes);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    if (total_bytes > cache->max_bytes)
+    {
+        qsort(entries, n_entries, sizeof(CacheEntryInfo), CompareEntriesByLastUse);
+
+        int directory_fd = open(cache->directory, O_RDONLY | O_DIRECTORY);
+        for (size_t i = 0; i < n_entries && total_bytes > cache->max_bytes && directory_fd >= 0; i++)
+        {
+            // запись мог уже удалить другой процесс - это не ошибка
+            if (unlinkat(directory_fd, entries[i].name, 0) == 0 || errno == ENOENT)
+                total_bytes -= entries[i].size;
+        }
+
+        if (directory_fd >= 0)
+            close(directory_fd);
+    }
+
+    free(entries);
+    return TREE_ERROR_NO;
+}
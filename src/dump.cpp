@@ -6,6 +6,7 @@
 #include <time.h>
 #include <string.h>
 #include "tree_error_types.h"
+#include "tree_traversal.h"
 
 static const char* NodeDataToString(const Node* node, char* buffer, size_t buffer_size)
 {
@@ -65,11 +66,8 @@ TreeErrorType GenerateDotFile(Tree* tree, const char* filename)
     return TREE_ERROR_NO;
 }
 
-static void CreateNodeRecursive(Node* node, Tree* tree, FILE* dot_file)
+static void CreateDotNode(Node* node, Tree* tree, FILE* dot_file)
 {
-    if (node == NULL)
-        return;
-
     const char* color = GetNodeColor(node, tree);
     const char* shape = "record"; // форма по умолчанию
 
@@ -92,10 +90,6 @@ static void CreateNodeRecursive(Node* node, Tree* tree, FILE* dot_file)
                 (void*)node, node_data, (void*)node,
                 (void*)node->left, (void*)node->right, (void*)node->parent, color, shape);
     }
-
-
-    CreateNodeRecursive(node->left,  tree, dot_file);
-    CreateNodeRecursive(node->right, tree, dot_file);
 }
 
 void CreateDotNodes(Tree* tree, FILE* dot_file)
@@ -103,51 +97,54 @@ void CreateDotNodes(Tree* tree, FILE* dot_file)
     assert(tree);
     assert(dot_file);
 
-    CreateNodeRecursive(tree->root, tree, dot_file);
+    TreeTraversal traversal = {};
+    if (BeginTreeTraversal(&traversal, tree->root) != TREE_ERROR_NO)
+        return;
+
+    Node* node = NULL;
+    while ((node = NextPreOrderNode(&traversal)) != NULL)
+        CreateDotNode(node, tree, dot_file);
+
+    EndTreeTraversal(&traversal);
 }
 
-void CreateTreeConnections(Node* node, FILE* dot_file)
+static void CreateDotEdge(Node* node, Node* child, const char* color, const char* label,
+                          const char* error_style, FILE* dot_file)
 {
-    if (node == NULL)
+    if (child->parent == node)
+    {
+        fprintf(dot_file, "    node_%p -> node_%p [color=%s, dir=both, arrowtail=normal, arrowhead=normal, label=\"%s\"];\n",
+                (void*)node, (void*)child, color, label);
         return;
+    }
 
-    if (node->left != NULL)
-    {
-        if (node->left->parent == node)
-        {
-            fprintf(dot_file, "    node_%p -> node_%p [color=blue, dir=both, arrowtail=normal, arrowhead=normal, label=\"L\"];\n",
-                    (void*)node, (void*)node->left);
-        }
-        else
-        {
-            fprintf(dot_file, "    node_%p -> node_%p [color=blue, label=\"L\"];\n",
-                    (void*)node, (void*)node->left);
+    fprintf(dot_file, "    node_%p -> node_%p [color=%s, label=\"%s\"];\n",
+            (void*)node, (void*)child, color, label);
 
-            fprintf(dot_file, "    error_parent_%p [shape=ellipse, style=filled, fillcolor=orange, label=\"Parent address Error\"];\n",
-                    (void*)node->left);
-            fprintf(dot_file, "    node_%p -> error_parent_%p [color=red];\n", (void*)node->left, (void*)node->left);
-        }
-        CreateTreeConnections(node->left, dot_file);
-    }
+    fprintf(dot_file, "    error_parent_%p [shape=ellipse, style=filled, fillcolor=orange, label=\"Parent address Error\"];\n",
+            (void*)child);
+    fprintf(dot_file, "    node_%p -> error_parent_%p [%s];\n", (void*)child, (void*)child, error_style);
+}
+
+// ребро к левому ребенку выводится до его поддерева, к правому - после левого поддерева
+void CreateTreeConnections(Node* node, FILE* dot_file)
+{
+    TreeTraversal traversal = {};
+    if (node == NULL || BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
+        return;
 
-    if (node->right != NULL)
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(&traversal)) != NULL)
     {
-        if (node->right->parent == node)
-        {
-            fprintf(dot_file, "    node_%p -> node_%p [color=green, dir=both, arrowtail=normal, arrowhead=normal, label=\"R\"];\n",
-                    (void*)node, (void*)node->right);
-        }
-        else
-        {
-            fprintf(dot_file, "    node_%p -> node_%p [color=green, label=\"R\"];\n",
-                    (void*)node, (void*)node->right);
+        Node* current = frame->node;
 
-            fprintf(dot_file, "    error_parent_%p [shape=ellipse, style=filled, fillcolor=orange, label=\"Parent address Error\"];\n",
-                    (void*)node->right);
-            fprintf(dot_file, "    node_%p -> error_parent_%p [color=red, style=dashed];\n", (void*)node->right, (void*)node->right);
-        }
-        CreateTreeConnections(node->right, dot_file);
+        if (frame->event == TRAVERSAL_ENTER && current->left != NULL)
+            CreateDotEdge(current, current->left, "blue", "L", "color=red", dot_file);
+        else if (frame->event == TRAVERSAL_BETWEEN && current->right != NULL)
+            CreateDotEdge(current, current->right, "green", "R", "color=red, style=dashed", dot_file);
     }
+
+    EndTreeTraversal(&traversal);
 }
 
 const char* GetNodeColor(Node* node, Tree* tree)
@@ -0,0 +1,808 @@
+#include "egraph.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "operations.h"
+#include "logic_functions.h"
+#include "cost_model.h"
+#include "rewrite_pattern.h"
+#include "DSL.h"
+
+// ==================== ПРАВИЛА ====================
+
+// тождества, верные всюду, где определена левая часть
+static const char* const saturation_rules[] = {
+    "add(?a, ?b) -> add(?b, ?a)",
+    "mul(?a, ?b) -> mul(?b, ?a)",
+    "add(add(?a, ?b), ?c) -> add(?a, add(?b, ?c))",
+    "add(?a, add(?b, ?c)) -> add(add(?a, ?b), ?c)",
+    "mul(mul(?a, ?b), ?c) -> mul(?a, mul(?b, ?c))",
+    "mul(?a, mul(?b, ?c)) -> mul(mul(?a, ?b), ?c)",
+    "add(?a, 0) -> ?a",
+    "sub(?a, 0) -> ?a",
+    "mul(?a, 1) -> ?a",
+    "mul(?a, 0) -> 0",
+    "div(?a, 1) -> ?a",
+    "pow(?a, 1) -> ?a",
+    "sub(?a, ?a) -> 0",
+    "sub(add(?a, ?b), ?b) -> ?a",
+    "add(?a, ?a) -> mul(2, ?a)",
+    "mul(?a, ?a) -> pow(?a, 2)",
+    "pow(?a, 2) -> mul(?a, ?a)",
+    "add(mul(?a, ?b), mul(?a, ?c)) -> mul(?a, add(?b, ?c))",
+    "sub(mul(?a, ?b), mul(?a, ?c)) -> mul(?a, sub(?b, ?c))",
+    "add(pow(sin(?x), 2), pow(cos(?x), 2)) -> 1",
+    "sub(1, pow(sin(?x), 2)) -> pow(cos(?x), 2)",
+    "sub(1, pow(cos(?x), 2)) -> pow(sin(?x), 2)",
+    "sub(pow(cosh(?x), 2), pow(sinh(?x), 2)) -> 1",
+    "div(sin(?x), cos(?x)) -> tan(?x)",
+    "div(cos(?x), sin(?x)) -> cot(?x)",
+    "ln(exp(?x)) -> ?x",
+    "mul(exp(?a), exp(?b)) -> exp(add(?a, ?b))",
+    "div(exp(?a), exp(?b)) -> exp(sub(?a, ?b))",
+    "pow(exp(?a), ?b) -> exp(mul(?a, ?b))"
+};
+
+static const size_t n_saturation_rules = sizeof(saturation_rules) / sizeof(saturation_rules[0]);
+
+static bool ParseSaturationRules(RewriteRule* rules)
+{
+    for (size_t r = 0; r < n_saturation_rules; r++)
+        if (ParseRewriteRule(saturation_rules[r], &rules[r]) != TREE_ERROR_NO)
+            return false;
+
+    return true;
+}
+
+// разбираются один раз; инициализация статической переменной потокобезопасна
+static const RewriteRule* GetSaturationRules()
+{
+    static RewriteRule rules[n_saturation_rules] = {};
+    static const bool is_parsed = ParseSaturationRules(rules);
+
+    return is_parsed ? rules : NULL;
+}
+
+// ==================== E-ГРАФ ====================
+
+typedef struct {
+    NodeType      type;
+    OperationType op;
+    double        value;
+    int           variable;     // номер имени в EGraph::variable_names
+    int           children[2];  // e-классы аргументов, -1 - нет; аргумент унарной операции справа
+    int           eclass;
+    bool          is_dead;      // совпал с другим e-узлом после слияния классов
+} ENode;
+
+typedef struct {
+    int    parent;              // система непересекающихся множеств
+    bool   has_constant;
+    double constant;
+} EClass;
+
+typedef struct {
+    ENode*      enodes;
+    size_t      n_enodes;
+    EClass*     classes;
+    size_t      n_classes;
+    int*        table;          // хеш-таблица e-узлов, -1 - пустая ячейка
+    int*        class_start;    // e-узлы класса c: class_members[class_start[c] .. class_start[c + 1])
+    int*        class_members;
+    const char* variable_names[kMaxNOfVariables];
+    int         n_variable_names;
+} EGraph;
+
+typedef struct {
+    int root;
+    int classes[kMaxPatternWildcards];
+} Substitution;
+
+typedef struct {
+    Substitution* items;
+    size_t        n_items;
+    size_t        capacity;
+} SubstitutionList;
+
+// сопоставление останавливается по времени и по числу совпадений изнутри рекурсии:
+// одно правило на большом графе может перебирать варианты дольше всего лимита
+typedef struct {
+    double deadline;
+    size_t n_steps;
+    bool   is_expired;
+} MatchBudget;
+
+static TreeErrorType InitEGraph(EGraph* graph)
+{
+    memset(graph, 0, sizeof(*graph));
+
+    graph->enodes        = (ENode*) calloc(kMaxEGraphNodes, sizeof(ENode));
+    graph->classes       = (EClass*)calloc(kMaxEGraphNodes, sizeof(EClass));
+    graph->table         = (int*)   malloc(kEGraphTableSize * sizeof(int));
+    graph->class_start   = (int*)   calloc(kMaxEGraphNodes + 1, sizeof(int));
+    graph->class_members = (int*)   calloc(kMaxEGraphNodes, sizeof(int));
+
+    if (!graph->enodes || !graph->classes || !graph->table || !graph->class_start || !graph->class_members)
+        return TREE_ERROR_ALLOCATION;
+
+    memset(graph->table, -1, kEGraphTableSize * sizeof(int));
+    return TREE_ERROR_NO;
+}
+
+static void DestroyEGraph(EGraph* graph)
+{
+    free(graph->enodes);
+    free(graph->classes);
+    free(graph->table);
+    free(graph->class_start);
+    free(graph->class_members);
+    memset(graph, 0, sizeof(*graph));
+}
+
+static int FindClass(EGraph* graph, int id)
+{
+    while (graph->classes[id].parent != id)
+    {
+        graph->classes[id].parent = graph->classes[graph->classes[id].parent].parent;
+        id = graph->classes[id].parent;
+    }
+
+    return id;
+}
+
+// true - классы были разными
+static bool UnionClasses(EGraph* graph, int first, int second)
+{
+    first  = FindClass(graph, first);
+    second = FindClass(graph, second);
+    if (first == second)
+        return false;
+
+    graph->classes[second].parent = first;
+    if (!graph->classes[first].has_constant && graph->classes[second].has_constant)
+    {
+        graph->classes[first].has_constant = true;
+        graph->classes[first].constant = graph->classes[second].constant;
+    }
+
+    return true;
+}
+
+static void CanonicalizeENode(EGraph* graph, ENode* enode)
+{
+    for (int i = 0; i < 2; i++)
+        if (enode->children[i] >= 0)
+            enode->children[i] = FindClass(graph, enode->children[i]);
+}
+
+static unsigned long long HashENode(const ENode* enode)
+{
+    unsigned long long value_bits = 0;
+    memcpy(&value_bits, &enode->value, sizeof(value_bits));
+
+    unsigned long long words[] = {(unsigned long long)enode->type, (unsigned long long)enode->op, value_bits,
+                                  (unsigned long long)enode->variable, (unsigned long long)enode->children[0],
+                                  (unsigned long long)enode->children[1]};
+
+    unsigned long long hash = kCacheHashOffset;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+    {
+        hash ^= words[i];
+        hash *= kCacheHashPrime;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+static bool ENodesEqual(const ENode* first, const ENode* second)
+{
+    return first->type == second->type && first->op == second->op &&
+           memcmp(&first->value, &second->value, sizeof(double)) == 0 &&
+           first->variable == second->variable &&
+           first->children[0] == second->children[0] && first->children[1] == second->children[1];
+}
+
+// ячейка с равным e-узлом или пустая ячейка, куда его вставить
+static size_t FindTableSlot(EGraph* graph, const ENode* enode)
+{
+    size_t mask = kEGraphTableSize - 1;
+    size_t slot = (size_t)HashENode(enode) & mask;
+
+    while (graph->table[slot] >= 0)
+    {
+        ENode* stored = &graph->enodes[graph->table[slot]];
+        ENode  canonical = *stored;
+        CanonicalizeENode(graph, &canonical);
+
+        if (ENodesEqual(&canonical, enode))
+            return slot;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static bool ComputeENodeConstant(EGraph* graph, const ENode* enode, double* value)
+{
+    if (enode->type != NODE_OP)
+        return false;
+
+    double left = 0.0;
+    if (enode->children[0] >= 0)
+    {
+        EClass* left_class = &graph->classes[FindClass(graph, enode->children[0])];
+        if (!left_class->has_constant)
+            return false;
+        left = left_class->constant;
+    }
+
+    EClass* right_class = &graph->classes[FindClass(graph, enode->children[1])];
+    if (!right_class->has_constant)
+        return false;
+
+    return ApplyOperation(enode->op, left, right_class->constant, value) == TREE_ERROR_NO && isfinite(*value);
+}
+
+static int AddENode(EGraph* graph, ENode enode);
+
+// операция над константами сразу получает в свой класс и готовое число
+static int AddConstantFor(EGraph* graph, int eclass, double value)
+{
+    ENode number = {};
+    number.type = NODE_NUM;
+    number.value = value;
+    number.children[0] = number.children[1] = -1;
+
+    int number_class = AddENode(graph, number);
+    if (number_class < 0)
+        return -1;
+
+    UnionClasses(graph, eclass, number_class);
+    return FindClass(graph, eclass);
+}
+
+// номер класса e-узла, -1 - граф заполнен
+static int AddENode(EGraph* graph, ENode enode)
+{
+    CanonicalizeENode(graph, &enode);
+    enode.is_dead = false;
+
+    size_t slot = FindTableSlot(graph, &enode);
+    if (graph->table[slot] >= 0)
+        return FindClass(graph, graph->enodes[graph->table[slot]].eclass);
+
+    if (graph->n_enodes >= kMaxEGraphNodes)
+        return -1;
+
+    int eclass = (int)graph->n_classes++;
+    graph->classes[eclass].parent = eclass;
+    graph->classes[eclass].has_constant = (enode.type == NODE_NUM);
+    graph->classes[eclass].constant = enode.value;
+
+    enode.eclass = eclass;
+    graph->table[slot] = (int)graph->n_enodes;
+    graph->enodes[graph->n_enodes++] = enode;
+
+    double value = 0.0;
+    if (ComputeENodeConstant(graph, &enode, &value))
+        return AddConstantFor(graph, eclass, value);
+
+    return eclass;
+}
+
+static int AddTreeToEGraph(EGraph* graph, Node* node)
+{
+    if (node == NULL)
+        return -1;
+
+    ENode enode = {};
+    enode.type = node->type;
+    enode.children[0] = enode.children[1] = -1;
+
+    switch (node->type)
+    {
+        case NODE_NUM:
+            enode.value = node->data.num_value;
+            break;
+
+        case NODE_VAR:
+        {
+            const char* name = node->data.var_definition.name;
+            if (name == NULL)
+                return -1;
+
+            int index = 0;
+            while (index < graph->n_variable_names && strcmp(graph->variable_names[index], name) != 0)
+                index++;
+
+            if (index == graph->n_variable_names)
+            {
+                if (index >= kMaxNOfVariables)
+                    return -1;
+                graph->variable_names[graph->n_variable_names++] = name;
+            }
+
+            enode.variable = index;
+            break;
+        }
+
+        case NODE_OP:
+            enode.op = node->data.op_value;
+            if (is_binary(enode.op))
+            {
+                enode.children[0] = AddTreeToEGraph(graph, node->left);
+                if (enode.children[0] < 0)
+                    return -1;
+            }
+
+            enode.children[1] = AddTreeToEGraph(graph, node->right);
+            if (enode.children[1] < 0)
+                return -1;
+            break;
+
+        default:
+            return -1;
+    }
+
+    return AddENode(graph, enode);
+}
+
+// после слияний e-узлы с совпавшими аргументами становятся равными: такие
+// классы тоже сливаются, пока граф не станет снова согласованным
+static bool RebuildEGraph(EGraph* graph)
+{
+    bool is_full = false;
+    bool is_changed = true;
+
+    while (is_changed)
+    {
+        is_changed = false;
+        memset(graph->table, -1, kEGraphTableSize * sizeof(int));
+
+        for (size_t i = 0; i < graph->n_enodes; i++)
+        {
+            ENode* enode = &graph->enodes[i];
+            if (enode->is_dead)
+                continue;
+
+            CanonicalizeENode(graph, enode);
+
+            size_t slot = FindTableSlot(graph, enode);
+            if (graph->table[slot] >= 0)
+            {
+                enode->is_dead = true;
+                if (UnionClasses(graph, graph->enodes[graph->table[slot]].eclass, enode->eclass))
+                    is_changed = true;
+                continue;
+            }
+
+            graph->table[slot] = (int)i;
+
+            double value = 0.0;
+            if (!graph->classes[FindClass(graph, enode->eclass)].has_constant &&
+                ComputeENodeConstant(graph, enode, &value))
+            {
+                if (AddConstantFor(graph, enode->eclass, value) < 0)
+                    is_full = true;
+                is_changed = true;
+            }
+        }
+    }
+
+    return !is_full;
+}
+
+static void BuildClassIndex(EGraph* graph)
+{
+    memset(graph->class_start, 0, (graph->n_classes + 1) * sizeof(int));
+
+    for (size_t i = 0; i < graph->n_enodes; i++)
+        if (!graph->enodes[i].is_dead)
+            graph->class_start[FindClass(graph, graph->enodes[i].eclass) + 1]++;
+
+    for (size_t c = 0; c < graph->n_classes; c++)
+        graph->class_start[c + 1] += graph->class_start[c];
+
+    int* fill = (int*)calloc(graph->n_classes + 1, sizeof(int));
+    if (fill)
+        memcpy(fill, graph->class_start, (graph->n_classes + 1) * sizeof(int));
+
+    for (size_t i = 0; i < graph->n_enodes && fill; i++)
+        if (!graph->enodes[i].is_dead)
+            graph->class_members[fill[FindClass(graph, graph->enodes[i].eclass)]++] = (int)i;
+
+    free(fill);
+}
+
+// ==================== СОПОСТАВЛЕНИЕ ====================
+
+static bool AppendSubstitution(SubstitutionList* list, const Substitution* substitution)
+{
+    if (list->n_items >= kMaxSaturationMatches)
+        return false;
+
+    if (list->n_items == list->capacity)
+    {
+        size_t new_capacity = (list->capacity == 0) ? 16 : list->capacity * 2;
+        Substitution* new_items = (Substitution*)realloc(list->items, new_capacity * sizeof(Substitution));
+        if (!new_items)
+            return false;
+
+        list->items = new_items;
+        list->capacity = new_capacity;
+    }
+
+    list->items[list->n_items++] = *substitution;
+    return true;
+}
+
+static double GetSaturationSeconds()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static bool IsMatchingStopped(MatchBudget* budget, const SubstitutionList* matches)
+{
+    if (budget->is_expired || matches->n_items >= kMaxSaturationMatches)
+        return true;
+
+    if (++budget->n_steps % kSaturationClockInterval == 0 && GetSaturationSeconds() > budget->deadline)
+        budget->is_expired = true;
+
+    return budget->is_expired;
+}
+
+// все продолжения partial, при которых шаблон совпадает с каким-то e-узлом класса
+static void MatchPattern(EGraph* graph, const RewriteRule* rule, int pattern, int eclass,
+                         const Substitution* partial, SubstitutionList* matches, MatchBudget* budget)
+{
+    if (IsMatchingStopped(budget, matches))
+        return;
+
+    const PatternNode* pattern_node = &rule->nodes[pattern];
+    eclass = FindClass(graph, eclass);
+
+    switch (pattern_node->kind)
+    {
+        case PATTERN_WILDCARD:
+        {
+            int bound = partial->classes[pattern_node->wildcard];
+            if (bound >= 0 && FindClass(graph, bound) != eclass)
+                return;
+
+            Substitution extended = *partial;
+            extended.classes[pattern_node->wildcard] = eclass;
+            AppendSubstitution(matches, &extended);
+            return;
+        }
+
+        case PATTERN_NUM:
+            if (graph->classes[eclass].has_constant && is_zero(graph->classes[eclass].constant - pattern_node->value))
+                AppendSubstitution(matches, partial);
+            return;
+
+        case PATTERN_OP:
+            break;
+
+        default:
+            return;
+    }
+
+    for (int m = graph->class_start[eclass]; m < graph->class_start[eclass + 1]; m++)
+    {
+        if (IsMatchingStopped(budget, matches))
+            return;
+
+        const ENode* enode = &graph->enodes[graph->class_members[m]];
+        if (enode->type != NODE_OP || enode->op != pattern_node->op)
+            continue;
+
+        if (pattern_node->left < 0)
+        {
+            MatchPattern(graph, rule, pattern_node->right, enode->children[1], partial, matches, budget);
+            continue;
+        }
+
+        SubstitutionList left_matches = {};
+        MatchPattern(graph, rule, pattern_node->left, enode->children[0], partial, &left_matches, budget);
+
+        for (size_t i = 0; i < left_matches.n_items && !IsMatchingStopped(budget, matches); i++)
+            MatchPattern(graph, rule, pattern_node->right, enode->children[1], &left_matches.items[i], matches, budget);
+
+        free(left_matches.items);
+    }
+}
+
+static int InstantiatePattern(EGraph* graph, const RewriteRule* rule, int pattern, const Substitution* substitution)
+{
+    const PatternNode* pattern_node = &rule->nodes[pattern];
+
+    ENode enode = {};
+    enode.children[0] = enode.children[1] = -1;
+
+    switch (pattern_node->kind)
+    {
+        case PATTERN_WILDCARD:
+            return substitution->classes[pattern_node->wildcard];
+
+        case PATTERN_NUM:
+            enode.type = NODE_NUM;
+            enode.value = pattern_node->value;
+            return AddENode(graph, enode);
+
+        case PATTERN_OP:
+            enode.type = NODE_OP;
+            enode.op = pattern_node->op;
+
+            if (pattern_node->left >= 0)
+            {
+                enode.children[0] = InstantiatePattern(graph, rule, pattern_node->left, substitution);
+                if (enode.children[0] < 0)
+                    return -1;
+            }
+
+            enode.children[1] = InstantiatePattern(graph, rule, pattern_node->right, substitution);
+            if (enode.children[1] < 0)
+                return -1;
+
+            return AddENode(graph, enode);
+
+        default:
+            return -1;
+    }
+}
+
+// ==================== НАСЫЩЕНИЕ ====================
+
+// nonzero(?x): в классе нет числа ноль
+static bool CheckSaturationGuards(EGraph* graph, const RewriteRule* rule, const Substitution* substitution)
+{
+    for (int w = 0; w < rule->n_wildcards; w++)
+    {
+        if (!rule->is_nonzero[w])
+            continue;
+
+        EClass* eclass = &graph->classes[FindClass(graph, substitution->classes[w])];
+        if (eclass->has_constant && is_zero(eclass->constant))
+            return false;
+    }
+
+    return true;
+}
+
+// одна итерация: сначала все совпадения по неизменному графу, затем все замены.
+// false - граф не изменился; is_stopped - граф заполнен или время вышло
+static bool RunSaturationIteration(EGraph* graph, const RewriteRule* rules, size_t n_rules, double deadline,
+                                   bool* is_stopped)
+{
+    BuildClassIndex(graph);
+
+    SubstitutionList* matches = (SubstitutionList*)calloc(n_rules, sizeof(SubstitutionList));
+    if (!matches)
+    {
+        *is_stopped = true;
+        return false;
+    }
+
+    MatchBudget budget = {};
+    budget.deadline   = deadline;
+    budget.is_expired = GetSaturationSeconds() > deadline;
+
+    size_t n_classes = graph->n_classes;
+    for (size_t r = 0; r < n_rules && !budget.is_expired; r++)
+    {
+        for (size_t c = 0; c < n_classes && !IsMatchingStopped(&budget, &matches[r]); c++)
+        {
+            if (FindClass(graph, (int)c) != (int)c)
+                continue;
+
+            Substitution empty = {};
+            empty.root = (int)c;
+            for (int w = 0; w < kMaxPatternWildcards; w++)
+                empty.classes[w] = -1;
+
+            MatchPattern(graph, &rules[r], rules[r].lhs, (int)c, &empty, &matches[r], &budget);
+        }
+    }
+
+    if (budget.is_expired)
+        *is_stopped = true;
+
+    size_t old_n_enodes = graph->n_enodes;
+    bool is_changed = false;
+
+    // найденные до остановки совпадения все равно применяются
+    bool is_full = false;
+    for (size_t r = 0; r < n_rules && !is_full; r++)
+    {
+        for (size_t i = 0; i < matches[r].n_items; i++)
+        {
+            if (!CheckSaturationGuards(graph, &rules[r], &matches[r].items[i]))
+                continue;
+
+            int new_class = InstantiatePattern(graph, &rules[r], rules[r].rhs, &matches[r].items[i]);
+            if (new_class < 0)
+            {
+                is_full = true;
+                break;
+            }
+
+            if (UnionClasses(graph, matches[r].items[i].root, new_class))
+                is_changed = true;
+        }
+    }
+
+    for (size_t r = 0; r < n_rules; r++)
+        free(matches[r].items);
+    free(matches);
+
+    if (!RebuildEGraph(graph) || is_full)
+        *is_stopped = true;
+
+    return is_changed || graph->n_enodes != old_n_enodes;
+}
+
+// ==================== ИЗВЛЕЧЕНИЕ ====================
+
+// стоимости классов уточняются, пока не перестанут падать; стоимость e-узла
+// строго больше стоимостей аргументов, поэтому выбранные узлы не образуют циклов
+static void ComputeBestENodes(EGraph* graph, double* best_costs, int* best_enodes)
+{
+    for (size_t c = 0; c < graph->n_classes; c++)
+    {
+        best_costs[c]  = INFINITY;
+        best_enodes[c] = -1;
+    }
+
+    bool is_changed = true;
+    while (is_changed)
+    {
+        is_changed = false;
+
+        for (size_t i = 0; i < graph->n_enodes; i++)
+        {
+            const ENode* enode = &graph->enodes[i];
+            if (enode->is_dead)
+                continue;
+
+            double cost = kLeafEvaluationCost;
+            if (enode->type == NODE_OP)
+            {
+                cost = GetOperationCost(enode->op);
+                for (int k = 0; k < 2; k++)
+                    if (enode->children[k] >= 0)
+                        cost += best_costs[FindClass(graph, enode->children[k])];
+            }
+
+            int eclass = FindClass(graph, enode->eclass);
+            if (cost < best_costs[eclass])
+            {
+                best_costs[eclass]  = cost;
+                best_enodes[eclass] = (int)i;
+                is_changed = true;
+            }
+        }
+    }
+}
+
+static Node* ExtractBestTree(EGraph* graph, const int* best_enodes, int eclass)
+{
+    eclass = FindClass(graph, eclass);
+    if (best_enodes[eclass] < 0)
+        return NULL;
+
+    const ENode* enode = &graph->enodes[best_enodes[eclass]];
+
+    switch (enode->type)
+    {
+        case NODE_NUM:
+            return NUM(enode->value);
+
+        case NODE_VAR:
+            return VAR(graph->variable_names[enode->variable]);
+
+        case NODE_OP:
+        {
+            Node* left = NULL;
+            if (enode->children[0] >= 0)
+            {
+                left = ExtractBestTree(graph, best_enodes, enode->children[0]);
+                if (left == NULL)
+                    return NULL;
+            }
+
+            Node* right = ExtractBestTree(graph, best_enodes, enode->children[1]);
+            if (right == NULL)
+            {
+                FreeSubtree(left);
+                return NULL;
+            }
+
+            ValueOfTreeElement data = {};
+            data.op_value = enode->op;
+            return CreateNode(NODE_OP, data, left, right);
+        }
+
+        default:
+            return NULL;
+    }
+}
+
+TreeErrorType SimplifyBySaturation(Node* node, Node** result, SaturationStats* stats)
+{
+    if (node == NULL || result == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    *result = NULL;
+
+    const RewriteRule* rules = GetSaturationRules();
+    if (rules == NULL)
+        return TREE_ERROR_FORMAT;
+
+    EGraph graph = {};
+    TreeErrorType error = InitEGraph(&graph);
+    if (error != TREE_ERROR_NO)
+    {
+        DestroyEGraph(&graph);
+        return error;
+    }
+
+    int root = AddTreeToEGraph(&graph, node);
+    if (root < 0)
+    {
+        DestroyEGraph(&graph);
+        return TREE_ERROR_INVALID_NODE;
+    }
+
+    double deadline = GetSaturationSeconds() + kSaturationTimeLimit;
+    bool is_stopped = !RebuildEGraph(&graph);
+    bool is_saturated = false;
+    int n_iterations = 0;
+
+    while (!is_stopped && n_iterations < kMaxSaturationIterations)
+    {
+        n_iterations++;
+        if (!RunSaturationIteration(&graph, rules, n_saturation_rules, deadline, &is_stopped))
+        {
+            is_saturated = !is_stopped;
+            break;
+        }
+    }
+
+    double* best_costs  = (double*)calloc(graph.n_classes, sizeof(double));
+    int*    best_enodes = (int*)   calloc(graph.n_classes, sizeof(int));
+    if (!best_costs || !best_enodes)
+    {
+        free(best_costs);
+        free(best_enodes);
+        DestroyEGraph(&graph);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    ComputeBestENodes(&graph, best_costs, best_enodes);
+    *result = ExtractBestTree(&graph, best_enodes, root);
+
+    if (stats != NULL)
+    {
+        stats->n_enodes     = graph.n_enodes;
+        stats->n_classes    = graph.n_classes;
+        stats->n_iterations = n_iterations;
+        stats->is_saturated = is_saturated;
+    }
+
+    free(best_costs);
+    free(best_enodes);
+    DestroyEGraph(&graph);
+
+    return (*result != NULL) ? TREE_ERROR_NO : TREE_ERROR_ALLOCATION;
+}
+
+#include "DSL_undef.h"
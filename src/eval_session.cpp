@@ -0,0 +1,279 @@
+#include "eval_session.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "operations.h"
+#include "tree_base.h"
+#include "logic_functions.h"
+
+// ==================== МНОЖЕСТВА ЗАВИСИМОСТЕЙ ====================
+
+static void AddDependency(DependencySet* set, int variable)
+{
+    set->words[variable / kDependencyWordBits] |= 1ULL << (variable % kDependencyWordBits);
+}
+
+static void UniteDependencies(DependencySet* set, const DependencySet* other)
+{
+    for (int i = 0; i < kDependencyWords; i++)
+        set->words[i] |= other->words[i];
+}
+
+static bool DependenciesIntersect(const DependencySet* first, const DependencySet* second)
+{
+    for (int i = 0; i < kDependencyWords; i++)
+    {
+        if (first->words[i] & second->words[i])
+            return true;
+    }
+
+    return false;
+}
+
+// ==================== ПОСТРОЕНИЕ СЕССИИ ====================
+
+static int FindSessionVariable(EvaluationSession* session, const char* name)
+{
+    for (int i = 0; i < session->n_variables; i++)
+    {
+        if (strcmp(session->variables[i].name, name) == 0)
+            return i;
+    }
+
+    if (session->n_variables >= kMaxNOfVariables)
+        return -1;
+
+    SessionVariable* variable = &session->variables[session->n_variables];
+    strncpy(variable->name, name, kMaxVariableLength - 1);
+    variable->name[kMaxVariableLength - 1] = '\0';
+
+    return session->n_variables++;
+}
+
+// stack - номера уже разобранных поддеревьев, ожидающих родителя
+static TreeErrorType FlattenNode(EvaluationSession* session, Node* node, size_t position, int* stack, size_t* depth)
+{
+    if (node == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    SessionNode flat = {};
+    flat.type = node->type;
+    flat.left = -1;
+    flat.right = -1;
+    flat.variable = -1;
+
+    switch (node->type)
+    {
+        case NODE_NUM:
+            flat.value = node->data.num_value;
+            break;
+
+        case NODE_VAR:
+            if (node->data.var_definition.name == NULL)
+                return TREE_ERROR_VARIABLE_NOT_FOUND;
+
+            flat.variable = FindSessionVariable(session, node->data.var_definition.name);
+            if (flat.variable < 0)
+                return TREE_ERROR_VARIABLE_TABLE;
+
+            AddDependency(&flat.depends, flat.variable);
+            break;
+
+        case NODE_OP:
+        {
+            flat.op = node->data.op_value;
+
+            if (node->right == NULL || (is_binary(node->data.op_value) && node->left == NULL))
+                return TREE_ERROR_NULL_PTR;
+
+            flat.right = stack[--(*depth)];
+            UniteDependencies(&flat.depends, &session->nodes[flat.right].depends);
+
+            // левый аргумент унарной операции не вычисляется, но лежит в линеаризации
+            int left = (node->left != NULL) ? stack[--(*depth)] : -1;
+            if (is_binary(node->data.op_value))
+            {
+                flat.left = left;
+                UniteDependencies(&flat.depends, &session->nodes[flat.left].depends);
+            }
+            break;
+        }
+
+        default:
+            return TREE_ERROR_INVALID_NODE;
+    }
+
+    assert(position < session->n_nodes);
+    session->nodes[position] = flat;
+    stack[(*depth)++] = (int)position;
+
+    return TREE_ERROR_NO;
+}
+
+// номера узлов сессии совпадают с позициями в линеаризации дерева
+TreeErrorType InitEvaluationSession(EvaluationSession* session, Tree* tree, VariableTable* var_table)
+{
+    if (session == NULL || tree == NULL || var_table == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(session, 0, sizeof(*session));
+
+    if (tree->root == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    Node* const* post_order = GetTreePostOrder(tree);
+    if (!post_order)
+        return TREE_ERROR_ALLOCATION;
+
+    session->var_table = var_table;
+    session->n_nodes = tree->size;
+    session->nodes = (SessionNode*)calloc(session->n_nodes, sizeof(SessionNode));
+    int* stack = (int*)calloc(session->n_nodes, sizeof(int));
+    if (!session->nodes || !stack)
+    {
+        free(stack);
+        DestroyEvaluationSession(session);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    TreeErrorType error = TREE_ERROR_NO;
+    size_t depth = 0;
+    for (size_t position = 0; position < session->n_nodes && error == TREE_ERROR_NO; position++)
+        error = FlattenNode(session, post_order[position], position, stack, &depth);
+
+    free(stack);
+
+    if (error != TREE_ERROR_NO)
+    {
+        DestroyEvaluationSession(session);
+        return error;
+    }
+
+    return TREE_ERROR_NO;
+}
+
+void DestroyEvaluationSession(EvaluationSession* session)
+{
+    if (session == NULL)
+        return;
+
+    free(session->nodes);
+    session->nodes = NULL;
+    session->n_nodes = 0;
+    session->n_variables = 0;
+    session->is_computed = false;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ ====================
+
+// переменные ищутся по имени каждый раз: номера в таблице меняются при ее сортировке
+static TreeErrorType CollectChangedVariables(EvaluationSession* session, DependencySet* changed)
+{
+    for (int i = 0; i < session->n_variables; i++)
+    {
+        SessionVariable* variable = &session->variables[i];
+
+        int slot = FindVariableByName(session->var_table, variable->name);
+        if (slot < 0)
+            return TREE_ERROR_VARIABLE_NOT_FOUND;
+
+        double value    = session->var_table->variables[slot].value;
+        bool is_defined = session->var_table->variables[slot].is_defined;
+
+        // побитовое сравнение: смена 0.0 на -0.0 тоже пересчитывается
+        if (!session->is_computed || is_defined != variable->is_defined ||
+            memcmp(&value, &variable->value, sizeof(value)) != 0)
+        {
+            AddDependency(changed, i);
+            variable->value = value;
+            variable->is_defined = is_defined;
+        }
+    }
+
+    return TREE_ERROR_NO;
+}
+
+static void ComputeSessionNode(EvaluationSession* session, SessionNode* node)
+{
+    node->error = TREE_ERROR_NO;
+
+    switch (node->type)
+    {
+        case NODE_NUM:
+            break;
+
+        case NODE_VAR:
+        {
+            SessionVariable* variable = &session->variables[node->variable];
+            if (!variable->is_defined)
+                node->error = TREE_ERROR_VARIABLE_UNDEFINED;
+            else
+                node->value = variable->value;
+            break;
+        }
+
+        case NODE_OP:
+        {
+            double left_value = 0.0;
+            if (node->left >= 0)
+            {
+                if (session->nodes[node->left].error != TREE_ERROR_NO)
+                {
+                    node->error = session->nodes[node->left].error;
+                    break;
+                }
+                left_value = session->nodes[node->left].value;
+            }
+
+            if (session->nodes[node->right].error != TREE_ERROR_NO)
+            {
+                node->error = session->nodes[node->right].error;
+                break;
+            }
+
+            node->error = ApplyOperation(node->op, left_value, session->nodes[node->right].value, &node->value);
+            break;
+        }
+
+        default:
+            node->error = TREE_ERROR_INVALID_NODE;
+            break;
+    }
+}
+
+TreeErrorType EvaluateSession(EvaluationSession* session, double* result)
+{
+    if (session == NULL || result == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (session->nodes == NULL || session->n_nodes == 0)
+        return TREE_ERROR_NULL_PTR;
+
+    DependencySet changed = {};
+    TreeErrorType error = CollectChangedVariables(session, &changed);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    session->n_recomputed = 0;
+
+    for (size_t i = 0; i < session->n_nodes; i++)
+    {
+        SessionNode* node = &session->nodes[i];
+
+        if (session->is_computed && !DependenciesIntersect(&node->depends, &changed))
+            continue;
+
+        ComputeSessionNode(session, node);
+        session->n_recomputed++;
+    }
+
+    session->is_computed = true;
+
+    SessionNode* root = &session->nodes[session->n_nodes - 1];
+    if (root->error != TREE_ERROR_NO)
+        return root->error;
+
+    *result = root->value;
+    return TREE_ERROR_NO;
+}
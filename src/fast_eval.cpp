@@ -0,0 +1,624 @@
+#include "fast_eval.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "operations.h"
+#include "tree_base.h"
+#include "logic_functions.h"
+#include "interval_eval.h"
+#include "polynomial.h"
+#include "tree_traversal.h"
+
+// ==================== КОМПИЛЯЦИЯ ====================
+
+// форма, число узлов и высота поддерева, в прямом порядке обхода
+typedef struct {
+    PolynomialShape shape;
+    size_t          n_nodes;
+    size_t          height;
+} SubtreeShape;
+
+typedef struct {
+    Instruction*   code;
+    size_t         length;
+    size_t         capacity;
+    size_t         depth;
+    size_t         max_depth;
+    int            n_slots;
+    VariableTable* var_table;
+    double*        constants;
+    size_t         n_constants;
+    size_t         constants_capacity;
+    SubtreeShape*  shapes;
+    size_t         n_shapes;
+    size_t         shapes_capacity;
+    size_t         next_shape;     // номер текущего узла при компиляции
+} CompileContext;
+
+static TreeErrorType EmitInstruction(CompileContext* context, Instruction instruction)
+{
+    if (context->length == context->capacity)
+    {
+        size_t new_capacity = (context->capacity == 0) ? kBatchChunkSize : context->capacity * 2;
+        Instruction* new_code = (Instruction*)realloc(context->code, new_capacity * sizeof(Instruction));
+        if (!new_code)
+            return TREE_ERROR_ALLOCATION;
+
+        context->code = new_code;
+        context->capacity = new_capacity;
+    }
+
+    context->code[context->length++] = instruction;
+    return TREE_ERROR_NO;
+}
+
+// возвращает смещение коэффициентов в пуле или -1, если не хватило памяти
+static int AppendConstants(CompileContext* context, const double* values, size_t n_values)
+{
+    if (context->n_constants + n_values > context->constants_capacity)
+    {
+        size_t new_capacity = (context->constants_capacity == 0) ? kBatchChunkSize : context->constants_capacity * 2;
+        while (new_capacity < context->n_constants + n_values)
+            new_capacity *= 2;
+
+        double* new_constants = (double*)realloc(context->constants, new_capacity * sizeof(double));
+        if (!new_constants)
+            return -1;
+
+        context->constants = new_constants;
+        context->constants_capacity = new_capacity;
+    }
+
+    int offset = (int)context->n_constants;
+    memcpy(context->constants + offset, values, n_values * sizeof(double));
+    context->n_constants += n_values;
+    return offset;
+}
+
+static void PushDepth(CompileContext* context)
+{
+    context->depth++;
+    if (context->depth > context->max_depth)
+        context->max_depth = context->depth;
+}
+
+static TreeErrorType ReserveSubtreeShape(CompileContext* context)
+{
+    if (context->n_shapes < context->shapes_capacity)
+        return TREE_ERROR_NO;
+
+    size_t new_capacity = (context->shapes_capacity == 0) ? kBatchChunkSize : context->shapes_capacity * 2;
+    SubtreeShape* new_shapes = (SubtreeShape*)realloc(context->shapes, new_capacity * sizeof(SubtreeShape));
+    if (!new_shapes)
+        return TREE_ERROR_ALLOCATION;
+
+    context->shapes = new_shapes;
+    context->shapes_capacity = new_capacity;
+    return TREE_ERROR_NO;
+}
+
+// формы всех поддеревьев за один проход снизу вверх, чтобы многочлен извлекался
+// один раз в вершине наибольшего многочленного поддерева, а не в каждом его узле.
+// Разбор многочлена рекурсивен, поэтому слишком высокие поддеревья многочленом
+// не считаются
+static TreeErrorType ClassifySubtrees(CompileContext* context, Node* root)
+{
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, root);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    TraversalFrame* frame = NULL;
+    while (error == TREE_ERROR_NO && (frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        if (frame->event == TRAVERSAL_ENTER)
+        {
+            error = ReserveSubtreeShape(context);
+            frame->mark = context->n_shapes++;
+            continue;
+        }
+
+        if (frame->event != TRAVERSAL_LEAVE)
+            continue;
+
+        // в прямом порядке левый ребенок идет сразу за узлом, правый - после левого поддерева
+        size_t index = frame->mark;
+        size_t child = index + 1;
+        SubtreeShape left  = {};
+        SubtreeShape right = {};
+
+        if (frame->node->left != NULL)
+        {
+            left = context->shapes[child];
+            child += left.n_nodes;
+        }
+
+        if (frame->node->right != NULL)
+            right = context->shapes[child];
+
+        SubtreeShape* subtree = &context->shapes[index];
+        subtree->n_nodes = context->n_shapes - index;
+        subtree->height  = 1 + ((left.height > right.height) ? left.height : right.height);
+        subtree->shape   = (subtree->height > kMaxRecursiveTreeDepth) ? POLYNOMIAL_SHAPE_NONE :
+                           PolynomialNodeShape(frame->node, left.shape, right.shape);
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+    return error;
+}
+
+// одночлены остаются INSTR_POWI: x^8 возведением в квадрат дешевле восьми fma
+static bool IsCompiledAsPolynomial(Node* node, Polynomial* polynomial)
+{
+    return ExtractPolynomial(node, polynomial) && polynomial->variable != NULL &&
+           polynomial->degree >= 2 && CountPolynomialTerms(polynomial) > 1;
+}
+
+static TreeErrorType CompilePolynomial(CompileContext* context, const Polynomial* polynomial)
+{
+    Instruction instruction = {};
+    instruction.kind = INSTR_VAR;
+    instruction.slot = FindVariableByName(context->var_table, polynomial->variable);
+    if (instruction.slot < 0)
+        return TREE_ERROR_VARIABLE_NOT_FOUND;
+
+    if (instruction.slot >= context->n_slots)
+        context->n_slots = instruction.slot + 1;
+
+    PushDepth(context);
+    TreeErrorType error = EmitInstruction(context, instruction);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    instruction.kind  = INSTR_POLY;
+    instruction.count = polynomial->degree;
+    instruction.slot  = AppendConstants(context, polynomial->coefficients, (size_t)polynomial->degree + 1);
+    if (instruction.slot < 0)
+        return TREE_ERROR_ALLOCATION;
+
+    return EmitInstruction(context, instruction);
+}
+
+static bool IsCompiledAsPowi(Node* node)
+{
+    return IsNodeOp(node, OP_POW) && IsNodeType(node->right, NODE_NUM) &&
+           fabs(node->right->data.num_value) <= kMaxSquaringExponent &&
+           fpclassify(node->right->data.num_value - trunc(node->right->data.num_value)) == FP_ZERO;
+}
+
+static TreeErrorType CompileSingleNode(CompileContext* context, Node* node)
+{
+    Instruction instruction = {};
+
+    switch (node->type)
+    {
+        case NODE_NUM:
+            instruction.kind = INSTR_CONST;
+            instruction.value = node->data.num_value;
+            PushDepth(context);
+            return EmitInstruction(context, instruction);
+
+        case NODE_VAR:
+            if (node->data.var_definition.name == NULL)
+                return TREE_ERROR_VARIABLE_NOT_FOUND;
+
+            instruction.kind = INSTR_VAR;
+            instruction.slot = FindVariableByName(context->var_table, node->data.var_definition.name);
+            if (instruction.slot < 0)
+                return TREE_ERROR_VARIABLE_NOT_FOUND;
+
+            if (instruction.slot >= context->n_slots)
+                context->n_slots = instruction.slot + 1;
+
+            PushDepth(context);
+            return EmitInstruction(context, instruction);
+
+        case NODE_OP:
+            instruction.op = node->data.op_value;
+
+            if (IsCompiledAsPowi(node))
+            {
+                instruction.kind = INSTR_POWI;
+                instruction.slot = (int)node->right->data.num_value;
+                instruction.value = node->right->data.num_value;
+            }
+            else if (is_binary(node->data.op_value))
+            {
+                instruction.kind = INSTR_BINARY;
+                context->depth--;
+            }
+            else
+            {
+                instruction.kind = INSTR_UNARY;
+            }
+
+            return EmitInstruction(context, instruction);
+
+        default:
+            return TREE_ERROR_UNKNOWN_OPERATION;
+    }
+}
+
+// отметки кадра при компиляции
+enum {
+    COMPILE_MARK_CHILDREN_TOP = 1,  // узел не многочлен, его дети могут стать INSTR_POLY
+    COMPILE_MARK_EMITTED      = 2   // поддерево уже собрано в INSTR_POLY
+};
+
+// постфиксная программа: инструкция узла выдается на LEAVE, после детей
+static TreeErrorType CompileNodes(CompileContext* context, Node* root)
+{
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, root);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    TraversalFrame* frame = NULL;
+    while (error == TREE_ERROR_NO && (frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        Node* node = frame->node;
+
+        switch (frame->event)
+        {
+            case TRAVERSAL_ENTER:
+            {
+                SubtreeShape subtree = context->shapes[context->next_shape++];
+                bool is_polynomial_top = traversal.depth < 2 ||
+                                         (traversal.frames[traversal.depth - 2].mark & COMPILE_MARK_CHILDREN_TOP);
+
+                frame->mark = (subtree.shape == POLYNOMIAL_SHAPE_NONE) ? COMPILE_MARK_CHILDREN_TOP : 0;
+
+                Polynomial polynomial = {};
+                if (node->type == NODE_OP && is_polynomial_top && subtree.shape == POLYNOMIAL_SHAPE_SUM &&
+                    IsCompiledAsPolynomial(node, &polynomial))
+                {
+                    context->next_shape += subtree.n_nodes - 1;
+                    frame->mark = COMPILE_MARK_EMITTED;
+                    SkipTraversalChildren(&traversal);
+                    error = CompilePolynomial(context, &polynomial);
+                }
+                break;
+            }
+
+            // показатель INSTR_POWI не компилируется, но в прямом порядке занимает один номер
+            case TRAVERSAL_BETWEEN:
+                if (node->type == NODE_OP && IsCompiledAsPowi(node))
+                {
+                    context->next_shape++;
+                    SkipTraversalChildren(&traversal);
+                }
+                break;
+
+            case TRAVERSAL_LEAVE:
+                if (!(frame->mark & COMPILE_MARK_EMITTED))
+                    error = CompileSingleNode(context, node);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+    return error;
+}
+
+TreeErrorType CompileTree(Tree* tree, VariableTable* var_table, CompiledTree* compiled)
+{
+    if (tree == NULL || var_table == NULL || compiled == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(compiled, 0, sizeof(*compiled));
+
+    if (tree->root == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    CompileContext context = {};
+    context.var_table = var_table;
+
+    TreeErrorType error = ClassifySubtrees(&context, tree->root);
+    if (error == TREE_ERROR_NO)
+        error = CompileNodes(&context, tree->root);
+
+    free(context.shapes);
+    if (error != TREE_ERROR_NO)
+    {
+        free(context.code);
+        free(context.constants);
+        return error;
+    }
+
+    compiled->code = context.code;
+    compiled->length = context.length;
+    compiled->max_stack_depth = context.max_depth;
+    compiled->n_slots = context.n_slots;
+    compiled->constants = context.constants;
+    compiled->n_constants = context.n_constants;
+
+    return TREE_ERROR_NO;
+}
+
+TreeErrorType CompileSpecializedTree(Tree* tree, VariableTable* var_table, const VariableBinding* bindings,
+                                     int n_bindings, CompiledTree* compiled)
+{
+    if (tree == NULL || var_table == NULL || compiled == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    Tree specialized = {};
+    TreeErrorType error = SpecializeTree(tree, bindings, n_bindings, &specialized);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    error = CompileTree(&specialized, var_table, compiled);
+    TreeDtor(&specialized);
+
+    return error;
+}
+
+void DestroyCompiledTree(CompiledTree* compiled)
+{
+    if (compiled == NULL)
+        return;
+
+    free(compiled->code);
+    free(compiled->constants);
+    memset(compiled, 0, sizeof(*compiled));
+}
+
+void FillVariableValues(VariableTable* var_table, double* values)
+{
+    assert(var_table);
+    assert(values);
+
+    for (int i = 0; i < var_table->number_of_variables; i++)
+        values[i] = var_table->variables[i].is_defined ? var_table->variables[i].value : NAN;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ В ОДНОЙ ТОЧКЕ ====================
+
+TreeErrorType ExecuteCompiledTree(const CompiledTree* compiled, const double* values, double* result)
+{
+    if (compiled == NULL || values == NULL || result == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (compiled->length == 0)
+        return TREE_ERROR_NULL_PTR;
+
+    double  local_stack[kFastEvalStackSize] = {};
+    double* stack = local_stack;
+    if (compiled->max_stack_depth > kFastEvalStackSize)
+    {
+        stack = (double*)calloc(compiled->max_stack_depth, sizeof(double));
+        if (!stack)
+            return TREE_ERROR_ALLOCATION;
+    }
+
+    size_t top = 0;
+    TreeErrorType error = TREE_ERROR_NO;
+
+    for (size_t i = 0; i < compiled->length && error == TREE_ERROR_NO; i++)
+    {
+        const Instruction* instruction = &compiled->code[i];
+
+        switch (instruction->kind)
+        {
+            case INSTR_CONST:
+                stack[top++] = instruction->value;
+                break;
+
+            case INSTR_VAR:
+                stack[top] = values[instruction->slot];
+                if (isnan(stack[top]))
+                    error = TREE_ERROR_VARIABLE_UNDEFINED;
+                top++;
+                break;
+
+            case INSTR_UNARY:
+                error = ApplyOperation(instruction->op, 0.0, stack[top - 1], &stack[top - 1]);
+                break;
+
+            case INSTR_BINARY:
+                top--;
+                error = ApplyOperation(instruction->op, stack[top - 1], stack[top], &stack[top - 1]);
+                break;
+
+            case INSTR_POWI:
+                // те же ошибки, что у ApplyOperation(OP_POW): отрицательная степень нуля - полюс
+                if (instruction->slot < 0 && is_zero(stack[top - 1]))
+                    error = TREE_ERROR_DIVISION_BY_ZERO;
+                else
+                    stack[top - 1] = PowerBySquaring(stack[top - 1], instruction->slot);
+                break;
+
+            case INSTR_POLY:
+                stack[top - 1] = EvaluatePolynomialHorner(compiled->constants + instruction->slot,
+                                                          instruction->count, stack[top - 1]);
+                break;
+
+            default:
+                error = TREE_ERROR_UNKNOWN_OPERATION;
+                break;
+        }
+    }
+
+    if (error == TREE_ERROR_NO)
+        *result = stack[0];
+
+    if (stack != local_stack)
+        free(stack);
+
+    return error;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ НА СЕТКЕ ====================
+
+// каждая инструкция выполняется сразу для блока точек, поэтому разбор
+// инструкции и переход по switch делаются один раз на kFastEvalBlockSize значений
+static void ExecuteBlock(const CompiledTree* compiled, const double* values, int grid_slot,
+                         const double* grid, size_t n_points, double* stack, double* results)
+{
+    size_t top = 0;
+
+    for (size_t i = 0; i < compiled->length; i++)
+    {
+        const Instruction* instruction = &compiled->code[i];
+        double* current = stack + top * kFastEvalBlockSize;
+
+        switch (instruction->kind)
+        {
+            case INSTR_CONST:
+                for (size_t j = 0; j < n_points; j++)
+                    current[j] = instruction->value;
+                top++;
+                break;
+
+            case INSTR_VAR:
+                if (instruction->slot == grid_slot)
+                    memcpy(current, grid, n_points * sizeof(double));
+                else
+                    for (size_t j = 0; j < n_points; j++)
+                        current[j] = values[instruction->slot];
+                top++;
+                break;
+
+            case INSTR_UNARY:
+            {
+                double* argument = current - kFastEvalBlockSize;
+                for (size_t j = 0; j < n_points; j++)
+                {
+                    if (ApplyOperation(instruction->op, 0.0, argument[j], &argument[j]) != TREE_ERROR_NO)
+                        argument[j] = NAN;
+                }
+                break;
+            }
+
+            case INSTR_BINARY:
+            {
+                double* right = current - kFastEvalBlockSize;
+                double* left  = right - kFastEvalBlockSize;
+
+                switch (instruction->op)
+                {
+                    case OP_ADD:
+                        for (size_t j = 0; j < n_points; j++) left[j] += right[j];
+                        break;
+                    case OP_SUB:
+                        for (size_t j = 0; j < n_points; j++) left[j] -= right[j];
+                        break;
+                    case OP_MUL:
+                        for (size_t j = 0; j < n_points; j++) left[j] *= right[j];
+                        break;
+
+                    // деление и степень проверяют область определения в каждой точке;
+                    // унарные операции сюда не попадают
+                    case OP_DIV:
+                    case OP_POW:
+                    case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+                    case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+                    case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+                    case OP_LN:     case OP_EXP:    case OP_SQRT:
+                    case OP_COUNT:
+                    default:
+                        for (size_t j = 0; j < n_points; j++)
+                        {
+                            if (ApplyOperation(instruction->op, left[j], right[j], &left[j]) != TREE_ERROR_NO)
+                                left[j] = NAN;
+                        }
+                        break;
+                }
+
+                top--;
+                break;
+            }
+
+            case INSTR_POWI:
+            {
+                double* argument = current - kFastEvalBlockSize;
+                switch (instruction->slot)
+                {
+                    case 2:
+                        for (size_t j = 0; j < n_points; j++) argument[j] *= argument[j];
+                        break;
+                    case 3:
+                        for (size_t j = 0; j < n_points; j++) argument[j] *= argument[j] * argument[j];
+                        break;
+                    default:
+                        for (size_t j = 0; j < n_points; j++)
+                        {
+                            if (instruction->slot < 0 && is_zero(argument[j]))
+                                argument[j] = NAN;
+                            else
+                                argument[j] = PowerBySquaring(argument[j], instruction->slot);
+                        }
+                        break;
+                }
+                break;
+            }
+
+            case INSTR_POLY:
+            {
+                double* argument = current - kFastEvalBlockSize;
+                EvaluatePolynomialEstrin(compiled->constants + instruction->slot, instruction->count,
+                                         argument, n_points, argument);
+                break;
+            }
+
+            default:
+                for (size_t j = 0; j < n_points; j++)
+                    results[j] = NAN;
+                return;
+        }
+    }
+
+    memcpy(results, stack, n_points * sizeof(double));
+}
+
+TreeErrorType ExecuteCompiledTreeOnGrid(const CompiledTree* compiled, const double* values, int grid_slot,
+                                        const double* grid, size_t n_points, double* results)
+{
+    if (compiled == NULL || values == NULL || grid == NULL || results == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (compiled->length == 0)
+        return TREE_ERROR_NULL_PTR;
+
+    double* stack = (double*)calloc(compiled->max_stack_depth * kFastEvalBlockSize, sizeof(double));
+    if (!stack)
+        return TREE_ERROR_ALLOCATION;
+
+    Interval boxes[kMaxNOfVariables] = {};
+    FillPointBoxes(values, compiled->n_slots, boxes);
+
+    for (size_t first = 0; first < n_points; first += kFastEvalBlockSize)
+    {
+        size_t block_size = n_points - first;
+        if (block_size > kFastEvalBlockSize)
+            block_size = kFastEvalBlockSize;
+
+        if (grid_slot >= 0 && grid_slot < compiled->n_slots)
+        {
+            boxes[grid_slot] = {grid[first], grid[first + block_size - 1]};
+
+            IntervalResult bound = {};
+            if (EvaluateCompiledOnBox(compiled, boxes, &bound) == TREE_ERROR_NO && bound.domain == DOMAIN_OUTSIDE)
+            {
+                for (size_t j = 0; j < block_size; j++)
+                    results[first + j] = NAN;
+                continue;
+            }
+        }
+
+        ExecuteBlock(compiled, values, grid_slot, grid + first, block_size, stack, results + first);
+    }
+
+    free(stack);
+    return TREE_ERROR_NO;
+}
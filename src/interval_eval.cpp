@@ -0,0 +1,561 @@
+#include "interval_eval.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "operations.h"
+#include "logic_functions.h"
+
+typedef struct {
+    Interval     range;
+    DomainStatus domain;
+} IntervalValue;
+
+static const Interval kWholeLine = {-INFINITY, INFINITY};
+
+// ==================== ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ ====================
+
+static Interval MakeInterval(double first, double second)
+{
+    Interval result = {fmin(first, second), fmax(first, second)};
+    return result;
+}
+
+// libm не гарантирует направленного округления, поэтому границы отодвигаются на ulp наружу
+static Interval Widen(Interval interval)
+{
+    if (isfinite(interval.lower))
+        interval.lower = nextafter(interval.lower, -INFINITY);
+    if (isfinite(interval.upper))
+        interval.upper = nextafter(interval.upper, INFINITY);
+
+    return interval;
+}
+
+static Interval Hull(Interval first, Interval second)
+{
+    Interval result = {fmin(first.lower, second.lower), fmax(first.upper, second.upper)};
+    return result;
+}
+
+static DomainStatus WorseDomain(DomainStatus first, DomainStatus second)
+{
+    return (first > second) ? first : second;
+}
+
+// есть ли на [lower, upper] точка offset + k * period
+static bool ContainsPeriodicPoint(Interval interval, double offset, double period)
+{
+    double k = ceil((interval.lower - offset) / period);
+    return offset + k * period <= interval.upper;
+}
+
+// делитель обращается в ноль в смысле is_zero, как в ApplyOperation
+static DomainStatus ClassifyDivisor(Interval divisor)
+{
+    if (divisor.lower > -kZeroEpsilon && divisor.upper < kZeroEpsilon)
+        return DOMAIN_OUTSIDE;
+
+    if (divisor.lower < kZeroEpsilon && divisor.upper > -kZeroEpsilon)
+        return DOMAIN_PARTIAL;
+
+    return DOMAIN_INSIDE;
+}
+
+static bool IsPoint(Interval interval)
+{
+    return !(interval.lower < interval.upper);
+}
+
+static bool IsExactInteger(double value)
+{
+    return isfinite(value) && fpclassify(value - trunc(value)) == FP_ZERO;
+}
+
+static double MultiplyBounds(double first, double second)
+{
+    // 0 * inf в интервальной арифметике дает 0
+    if (fpclassify(first) == FP_ZERO || fpclassify(second) == FP_ZERO)
+        return 0.0;
+
+    return first * second;
+}
+
+static Interval MultiplyIntervals(Interval first, Interval second)
+{
+    double a = MultiplyBounds(first.lower, second.lower);
+    double b = MultiplyBounds(first.lower, second.upper);
+    double c = MultiplyBounds(first.upper, second.lower);
+    double d = MultiplyBounds(first.upper, second.upper);
+
+    Interval result = {fmin(fmin(a, b), fmin(c, d)), fmax(fmax(a, b), fmax(c, d))};
+    return result;
+}
+
+// деление на отрезок, не содержащий нуля
+static Interval DivideBySigned(Interval numerator, Interval divisor)
+{
+    Interval reciprocal = MakeInterval(1.0 / divisor.lower, 1.0 / divisor.upper);
+    return MultiplyIntervals(numerator, reciprocal);
+}
+
+static IntervalValue DivideIntervals(Interval numerator, Interval divisor)
+{
+    IntervalValue result = {kWholeLine, ClassifyDivisor(divisor)};
+
+    if (result.domain == DOMAIN_INSIDE)
+    {
+        result.range = DivideBySigned(numerator, divisor);
+    }
+    else if (result.domain == DOMAIN_PARTIAL)
+    {
+        // делим отдельно на отрицательную и положительную части без окрестности нуля
+        bool has_negative = divisor.lower <= -kZeroEpsilon;
+        bool has_positive = divisor.upper >=  kZeroEpsilon;
+
+        Interval negative = {divisor.lower, -kZeroEpsilon};
+        Interval positive = {kZeroEpsilon, divisor.upper};
+
+        if (has_negative && has_positive)
+            result.range = Hull(DivideBySigned(numerator, negative), DivideBySigned(numerator, positive));
+        else if (has_negative)
+            result.range = DivideBySigned(numerator, negative);
+        else if (has_positive)
+            result.range = DivideBySigned(numerator, positive);
+    }
+
+    return result;
+}
+
+// границы считаются той же функцией, что и точечные значения: округленное
+// возведение в квадрат монотонно, поэтому результаты вычислителя не выходят за отрезок
+static Interval IntegerPower(Interval base, long exponent)
+{
+    double lower_power = RaiseToPower(base.lower, (double)exponent);
+    double upper_power = RaiseToPower(base.upper, (double)exponent);
+
+    if (exponent % 2 != 0)
+        return MakeInterval(lower_power, upper_power);
+
+    if (base.lower <= 0.0 && base.upper >= 0.0)
+        return MakeInterval(0.0, fmax(lower_power, upper_power));
+
+    return MakeInterval(lower_power, upper_power);
+}
+
+static IntervalValue PowerIntervals(Interval base, Interval exponent)
+{
+    IntervalValue result = {kWholeLine, DOMAIN_INSIDE};
+
+    bool is_integer_exponent = IsPoint(exponent) && IsExactInteger(exponent.lower) &&
+                               fabs(exponent.lower) < kMaxIntervalIntegerExponent;
+
+    if (is_integer_exponent)
+    {
+        long n = (long)exponent.lower;
+        if (n == 0)
+        {
+            result.range = MakeInterval(1.0, 1.0);
+        }
+        else if (n > 0)
+        {
+            result.range = IntegerPower(base, n);
+        }
+        else
+        {
+            // pow(0, -n) = inf: значение есть, но на графике это разрыв
+            Interval positive_power = IntegerPower(base, -n);
+            if (positive_power.lower <= 0.0 && positive_power.upper >= 0.0)
+                result.domain = DOMAIN_PARTIAL;
+            else
+                result.range = DivideBySigned(MakeInterval(1.0, 1.0), positive_power);
+        }
+    }
+    else if (base.lower >= 0.0)
+    {
+        // при неотрицательном основании pow монотонна по каждому аргументу
+        double a = pow(base.lower, exponent.lower);
+        double b = pow(base.lower, exponent.upper);
+        double c = pow(base.upper, exponent.lower);
+        double d = pow(base.upper, exponent.upper);
+
+        result.range.lower = fmin(fmin(a, b), fmin(c, d));
+        result.range.upper = fmax(fmax(a, b), fmax(c, d));
+    }
+    else
+    {
+        // отрицательное основание в нецелой степени дает NaN
+        result.domain = (base.upper < 0.0 && IsPoint(exponent)) ? DOMAIN_OUTSIDE : DOMAIN_PARTIAL;
+        result.range = kWholeLine;
+    }
+
+    return result;
+}
+
+// ==================== УНАРНЫЕ ФУНКЦИИ ====================
+
+static Interval SinInterval(Interval argument)
+{
+    if (argument.upper - argument.lower >= 2 * M_PI)
+        return MakeInterval(-1.0, 1.0);
+
+    Interval result = MakeInterval(sin(argument.lower), sin(argument.upper));
+
+    if (ContainsPeriodicPoint(argument,  M_PI / 2, 2 * M_PI)) result.upper =  1.0;
+    if (ContainsPeriodicPoint(argument, -M_PI / 2, 2 * M_PI)) result.lower = -1.0;
+
+    return result;
+}
+
+static Interval CosInterval(Interval argument)
+{
+    if (argument.upper - argument.lower >= 2 * M_PI)
+        return MakeInterval(-1.0, 1.0);
+
+    Interval result = MakeInterval(cos(argument.lower), cos(argument.upper));
+
+    if (ContainsPeriodicPoint(argument, 0.0,  2 * M_PI)) result.upper =  1.0;
+    if (ContainsPeriodicPoint(argument, M_PI, 2 * M_PI)) result.lower = -1.0;
+
+    return result;
+}
+
+static IntervalValue ApplyUnaryInterval(OperationType op, Interval argument)
+{
+    IntervalValue result = {kWholeLine, DOMAIN_INSIDE};
+
+    switch (op)
+    {
+        case OP_SIN:
+            result.range = SinInterval(argument);
+            break;
+
+        case OP_COS:
+            result.range = CosInterval(argument);
+            break;
+
+        case OP_TAN:
+            // в полюсе tan конечна, но сколь угодно велика
+            if (argument.upper - argument.lower >= M_PI || ContainsPeriodicPoint(argument, M_PI / 2, M_PI))
+                result.range = kWholeLine;
+            else
+                result.range = MakeInterval(tan(argument.lower), tan(argument.upper));
+            break;
+
+        case OP_COT:
+        {
+            // у нулей tan вычисление падает с делением на ноль, как и в их eps-окрестности
+            Interval near_zeros = {argument.lower - kZeroEpsilon, argument.upper + kZeroEpsilon};
+            if (argument.upper - argument.lower >= M_PI || ContainsPeriodicPoint(near_zeros, 0.0, M_PI))
+            {
+                double k = round(argument.lower / M_PI);
+                bool near_single_zero = fabs(argument.lower - k * M_PI) < kZeroEpsilon &&
+                                        fabs(argument.upper - k * M_PI) < kZeroEpsilon;
+                result.domain = near_single_zero ? DOMAIN_OUTSIDE : DOMAIN_PARTIAL;
+                result.range = kWholeLine;
+            }
+            else
+            {
+                result.range = MakeInterval(1.0 / tan(argument.lower), 1.0 / tan(argument.upper));
+            }
+            break;
+        }
+
+        case OP_ARCSIN:
+        case OP_ARCCOS:
+            if (argument.upper < -1.0 || argument.lower > 1.0)
+            {
+                result.domain = DOMAIN_OUTSIDE;
+                break;
+            }
+
+            if (argument.lower < -1.0 || argument.upper > 1.0)
+                result.domain = DOMAIN_PARTIAL;
+
+            argument.lower = fmax(argument.lower, -1.0);
+            argument.upper = fmin(argument.upper,  1.0);
+
+            if (op == OP_ARCSIN)
+                result.range = MakeInterval(asin(argument.lower), asin(argument.upper));
+            else
+                result.range = MakeInterval(acos(argument.lower), acos(argument.upper));
+            break;
+
+        case OP_ARCTAN:
+            result.range = MakeInterval(atan(argument.lower), atan(argument.upper));
+            break;
+
+        case OP_ARCCOT:
+            result.range = MakeInterval(M_PI / 2 - atan(argument.lower), M_PI / 2 - atan(argument.upper));
+            break;
+
+        case OP_SINH:
+            result.range = MakeInterval(sinh(argument.lower), sinh(argument.upper));
+            break;
+
+        case OP_COSH:
+            result.range = MakeInterval(cosh(argument.lower), cosh(argument.upper));
+            if (argument.lower <= 0.0 && argument.upper >= 0.0)
+                result.range.lower = 1.0;
+            break;
+
+        case OP_TANH:
+            result.range = MakeInterval(tanh(argument.lower), tanh(argument.upper));
+            break;
+
+        case OP_COTH:
+        {
+            Interval tanh_range = MakeInterval(tanh(argument.lower), tanh(argument.upper));
+            result = DivideIntervals(MakeInterval(1.0, 1.0), tanh_range);
+            break;
+        }
+
+        case OP_LN:
+            if (argument.upper <= 0.0)
+            {
+                result.domain = DOMAIN_OUTSIDE;
+                break;
+            }
+
+            if (argument.lower <= 0.0)
+            {
+                result.domain = DOMAIN_PARTIAL;
+                result.range = MakeInterval(-INFINITY, log(argument.upper));
+            }
+            else
+            {
+                result.range = MakeInterval(log(argument.lower), log(argument.upper));
+            }
+            break;
+
+        case OP_EXP:
+            result.range = MakeInterval(exp(argument.lower), exp(argument.upper));
+            break;
+
+        case OP_SQRT:
+            if (argument.upper < 0.0)
+            {
+                result.domain = DOMAIN_OUTSIDE;
+                break;
+            }
+
+            if (argument.lower < 0.0)
+            {
+                result.domain = DOMAIN_PARTIAL;
+                result.range = MakeInterval(0.0, sqrt(argument.upper));
+            }
+            else
+            {
+                result.range = MakeInterval(sqrt(argument.lower), sqrt(argument.upper));
+            }
+            break;
+
+        // бинарные операции сюда не попадают
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_POW:
+        case OP_COUNT:
+        default:
+            result.domain = DOMAIN_OUTSIDE;
+            break;
+    }
+
+    return result;
+}
+
+static IntervalValue ApplyBinaryInterval(OperationType op, Interval left, Interval right)
+{
+    IntervalValue result = {kWholeLine, DOMAIN_INSIDE};
+
+    switch (op)
+    {
+        case OP_ADD:
+            result.range.lower = left.lower + right.lower;
+            result.range.upper = left.upper + right.upper;
+            break;
+
+        case OP_SUB:
+            result.range.lower = left.lower - right.upper;
+            result.range.upper = left.upper - right.lower;
+            break;
+
+        case OP_MUL:
+            result.range = MultiplyIntervals(left, right);
+            break;
+
+        case OP_DIV:
+            result = DivideIntervals(left, right);
+            break;
+
+        case OP_POW:
+            result = PowerIntervals(left, right);
+            break;
+
+        // унарные операции сюда не попадают
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_LN:     case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            result.domain = DOMAIN_OUTSIDE;
+            break;
+    }
+
+    // inf - inf и подобные дают NaN: границы неизвестны
+    if (isnan(result.range.lower)) result.range.lower = -INFINITY;
+    if (isnan(result.range.upper)) result.range.upper =  INFINITY;
+
+    return result;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ ====================
+
+TreeErrorType EvaluateCompiledOnBox(const CompiledTree* compiled, const Interval* boxes, IntervalResult* result)
+{
+    if (compiled == NULL || boxes == NULL || result == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (compiled->length == 0)
+        return TREE_ERROR_NULL_PTR;
+
+    IntervalValue  local_stack[kFastEvalStackSize] = {};
+    IntervalValue* stack = local_stack;
+    if (compiled->max_stack_depth > kFastEvalStackSize)
+    {
+        stack = (IntervalValue*)calloc(compiled->max_stack_depth, sizeof(IntervalValue));
+        if (!stack)
+            return TREE_ERROR_ALLOCATION;
+    }
+
+    size_t top = 0;
+    TreeErrorType error = TREE_ERROR_NO;
+
+    for (size_t i = 0; i < compiled->length && error == TREE_ERROR_NO; i++)
+    {
+        const Instruction* instruction = &compiled->code[i];
+
+        switch (instruction->kind)
+        {
+            case INSTR_CONST:
+                stack[top].range = MakeInterval(instruction->value, instruction->value);
+                stack[top].domain = DOMAIN_INSIDE;
+                top++;
+                break;
+
+            case INSTR_VAR:
+            {
+                Interval box = boxes[instruction->slot];
+                stack[top].range = box;
+                stack[top].domain = (isnan(box.lower) || isnan(box.upper)) ? DOMAIN_OUTSIDE : DOMAIN_INSIDE;
+                top++;
+                break;
+            }
+
+            case INSTR_UNARY:
+            {
+                IntervalValue* argument = &stack[top - 1];
+                if (argument->domain == DOMAIN_OUTSIDE)
+                    break;
+
+                IntervalValue value = ApplyUnaryInterval(instruction->op, argument->range);
+                argument->range  = Widen(value.range);
+                argument->domain = WorseDomain(argument->domain, value.domain);
+                break;
+            }
+
+            case INSTR_BINARY:
+            {
+                top--;
+                IntervalValue* left  = &stack[top - 1];
+                IntervalValue* right = &stack[top];
+
+                DomainStatus domain = WorseDomain(left->domain, right->domain);
+                if (domain == DOMAIN_OUTSIDE)
+                {
+                    left->domain = DOMAIN_OUTSIDE;
+                    break;
+                }
+
+                IntervalValue value = ApplyBinaryInterval(instruction->op, left->range, right->range);
+                left->range  = Widen(value.range);
+                left->domain = WorseDomain(domain, value.domain);
+                break;
+            }
+
+            case INSTR_POWI:
+            {
+                IntervalValue* argument = &stack[top - 1];
+                if (argument->domain == DOMAIN_OUTSIDE)
+                    break;
+
+                IntervalValue value = PowerIntervals(argument->range, MakeInterval(instruction->value,
+                                                                                    instruction->value));
+                argument->range  = Widen(value.range);
+                argument->domain = WorseDomain(argument->domain, value.domain);
+                break;
+            }
+
+            case INSTR_POLY:
+            {
+                IntervalValue* argument = &stack[top - 1];
+                if (argument->domain == DOMAIN_OUTSIDE)
+                    break;
+
+                // fma округляет один раз, поэтому Widen после каждого шага схемы Горнера хватает
+                const double* coefficients = compiled->constants + instruction->slot;
+                Interval value = MakeInterval(coefficients[instruction->count], coefficients[instruction->count]);
+                for (int k = instruction->count - 1; k >= 0; k--)
+                {
+                    value = Widen(MultiplyIntervals(value, argument->range));
+                    value = Widen(MakeInterval(value.lower + coefficients[k], value.upper + coefficients[k]));
+                }
+
+                argument->range = value;
+                break;
+            }
+
+            default:
+                error = TREE_ERROR_UNKNOWN_OPERATION;
+                break;
+        }
+    }
+
+    if (error == TREE_ERROR_NO)
+    {
+        result->range  = stack[0].range;
+        result->domain = stack[0].domain;
+    }
+
+    if (stack != local_stack)
+        free(stack);
+
+    return error;
+}
+
+TreeErrorType EvaluateTreeOnBox(Tree* tree, VariableTable* var_table, const Interval* boxes,
+                                IntervalResult* result)
+{
+    CompiledTree compiled = {};
+    TreeErrorType error = CompileTree(tree, var_table, &compiled);
+    if (error == TREE_ERROR_NO)
+        error = EvaluateCompiledOnBox(&compiled, boxes, result);
+
+    DestroyCompiledTree(&compiled);
+    return error;
+}
+
+void FillPointBoxes(const double* values, int n_values, Interval* boxes)
+{
+    assert(values);
+    assert(boxes);
+
+    for (int i = 0; i < n_values; i++)
+    {
+        boxes[i].lower = values[i];
+        boxes[i].upper = values[i];
+    }
+}
@@ -2,6 +2,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "dump.h"
 #include "tree_base.h"
 #include "operations.h"
@@ -56,6 +60,59 @@ char* ReadExpressionFromFile(const char* filename)
     return expression;
 }
 
+TreeErrorType MapInputFile(const char* filename, MappedFile* mapped)
+{
+    if (filename == NULL || mapped == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    mapped->data = NULL;
+    mapped->size = 0;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Error: cannot open file %s\n", filename);
+        return TREE_ERROR_OPENING_FILE;
+    }
+
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        return TREE_ERROR_IO;
+    }
+
+    if (file_stat.st_size == 0)
+    {
+        close(fd);
+        return TREE_ERROR_NO;
+    }
+
+    size_t size = (size_t)file_stat.st_size;
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return TREE_ERROR_IO;
+
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    mapped->data = (char*)data;
+    mapped->size = size;
+
+    return TREE_ERROR_NO;
+}
+
+void UnmapInputFile(MappedFile* mapped)
+{
+    if (mapped == NULL || mapped->data == NULL)
+        return;
+
+    munmap(mapped->data, mapped->size);
+    mapped->data = NULL;
+    mapped->size = 0;
+}
+
 size_t GetFileSize(FILE* file)
 {
     fseek(file, 0, SEEK_END);
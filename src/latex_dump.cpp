@@ -4,6 +4,10 @@
 #include <string.h>
 #include <math.h>
 #include "logic_functions.h"
+#include "fast_eval.h"
+#include "plot_sampling.h"
+#include "tree_traversal.h"
+#include "eval_session.h"
 
 static const OpFormat formats[OP_COUNT] = {
     /* OP_ADD */    {"", " + ", "",        true,  true,  false},
@@ -24,7 +28,32 @@ static const OpFormat formats[OP_COUNT] = {
     /* OP_TANH */   {"\\tanh(", "", ")",   false, false, false},
     /* OP_COTH */   {"\\coth(", "", ")",   false, false, false},
     /* OP_LN */     {"\\ln(", "", ")",     false, false, false},
-    /* OP_EXP */    {"e^{", "", "}",       false, false, false}
+    /* OP_EXP */    {"e^{", "", "}",       false, false, false},
+    /* OP_SQRT */   {"\\sqrt{", "", "}",  false, false, false}
+};
+
+// синтаксис pgfmath при trig format=rad; недостающие функции выражаются через имеющиеся
+static const OpFormat pgfplot_formats[OP_COUNT] = {
+    /* OP_ADD */    {"", " + ", "",              true,  true,  false},
+    /* OP_SUB */    {"", " - ", "",              true,  true,  true },
+    /* OP_MUL */    {"", "*", "",                true,  true,  false},
+    /* OP_DIV */    {"(", ")/(", ")",            false, true,  false},
+    /* OP_POW */    {"(", ")^(", ")",            false, true,  false},
+    /* OP_SIN */    {"sin(", "", ")",            false, false, false},
+    /* OP_COS */    {"cos(", "", ")",            false, false, false},
+    /* OP_TAN */    {"tan(", "", ")",            false, false, false},
+    /* OP_COT */    {"cot(", "", ")",            false, false, false},
+    /* OP_ARCSIN */ {"asin(", "", ")",           false, false, false},
+    /* OP_ARCCOS */ {"acos(", "", ")",           false, false, false},
+    /* OP_ARCTAN */ {"atan(", "", ")",           false, false, false},
+    /* OP_ARCCOT */ {"(pi/2 - atan(", "", "))",  false, false, false},
+    /* OP_SINH */   {"sinh(", "", ")",           false, false, false},
+    /* OP_COSH */   {"cosh(", "", ")",           false, false, false},
+    /* OP_TANH */   {"tanh(", "", ")",           false, false, false},
+    /* OP_COTH */   {"(1/tanh(", "", "))",       false, false, false},
+    /* OP_LN */     {"ln(", "", ")",             false, false, false},
+    /* OP_EXP */    {"exp(", "", ")",            false, false, false},
+    /* OP_SQRT */   {"sqrt(", "", ")",           false, false, false}
 };
 
 const OpFormat* GetOpFormat(OperationType op_type)
@@ -36,267 +65,227 @@ const OpFormat* GetOpFormat(OperationType op_type)
     return NULL;
 }
 
-void TreeToStringSimple(Node* node, char* buffer, int* pos, int buffer_size)
+const OpFormat* GetPGFPlotFormat(OperationType op_type)
 {
-    if (node == NULL || *pos >= buffer_size - 1)
-        return;
+    if (op_type >= 0 && op_type < OP_COUNT)
+    {
+        return &pgfplot_formats[op_type];
+    }
+    return NULL;
+}
+
+static void AppendNumber(StringBuilder* builder, double value)
+{
+    // для отрицательных чисел всегда добавляем скобки
+    if (value < 0)
+    {
+        AppendChar(builder, '(');
+        AppendDouble(builder, value);
+        AppendChar(builder, ')');
+    }
+    else
+    {
+        AppendDouble(builder, value);
+    }
+}
+
+static bool IsLeftParenthesized(Node* node, const OpFormat* fmt)
+{
+    return fmt->is_binary && fmt->should_compare_priority &&
+           IsNodeType(node->left, NODE_OP) && (node->left->priority < node->priority);
+}
+
+static bool IsRightParenthesized(Node* node, const OpFormat* fmt)
+{
+    if (!fmt->is_binary || !fmt->should_compare_priority || !IsNodeType(node->right, NODE_OP))
+        return false;
+
+    if (fmt->right_use_less_equal)
+        return node->right->priority <= node->priority;
+
+    return node->right->priority < node->priority;
+}
+
+// запоминает отрисовку поддерева, начавшуюся в builder с позиции begin
+static void StoreRenderedTexCache(Node* node, const StringBuilder* builder, size_t begin)
+{
+    if (!builder->failed)
+        StoreTexCache(node, builder->data + begin, builder->length - begin);
+}
+
+// ENTER: префикс операции и открывающая скобка левого аргумента
+static void RenderNodeEnter(TreeTraversal* traversal, TraversalFrame* frame, StringBuilder* builder,
+                            FormatGetter get_format, RenderVariableFunction render_variable, void* context)
+{
+    Node* node = frame->node;
 
     switch (node->type)
     {
         case NODE_NUM:
-            // для отрицательных чисел всегда добавляем скобки
-            if (node->data.num_value < 0)
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "(%g)", node->data.num_value);
-            else
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%g", node->data.num_value);
+            AppendNumber(builder, node->data.num_value);
             break;
 
         case NODE_VAR:
-            if (node->data.var_definition.name)
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", node->data.var_definition.name);
-            else
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "?");
+            render_variable(node, builder, context);
             break;
 
         case NODE_OP:
         {
-            const OpFormat* fmt = GetOpFormat(node->data.op_value);
+            const OpFormat* fmt = get_format(node->data.op_value);
             if (fmt == NULL)
             {
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "?");
-                break;
-            }
-
-            if (!fmt->is_binary)
-            {
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", fmt->prefix);
-                TreeToStringSimple(node->right, buffer, pos, buffer_size);
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", fmt->postfix);
-                break;
-            }
-
-            if (!fmt->should_compare_priority)
-            {
-                // простые бинарные операторы (деление, степень)
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", fmt->prefix);
-                TreeToStringSimple(node->left, buffer, pos, buffer_size);
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", fmt->infix);
-                TreeToStringSimple(node->right, buffer, pos, buffer_size);
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", fmt->postfix);
+                AppendChar(builder, '?');
+                SkipTraversalChildren(traversal);
                 break;
             }
 
-            // сложные бинарные операторы (с проверкой приоритетов)
-            bool left_needs_parentheses = IsNodeType(node->left, NODE_OP) &&
-                                          (node->left->priority < node->priority);
-
-            bool right_needs_parentheses = false;
-            if (IsNodeType(node->right, NODE_OP))
-            {
-                if (fmt->right_use_less_equal)
-                    right_needs_parentheses = (node->right->priority <= node->priority);
-                else
-                    right_needs_parentheses = (node->right->priority < node->priority);
-            }
-
-            // левый аргумент
-            if (left_needs_parentheses)
-            {
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "(");
-                TreeToStringSimple(node->left, buffer, pos, buffer_size);
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, ")");
-            }
-            else
-            {
-                TreeToStringSimple(node->left, buffer, pos, buffer_size);
-            }
-
-            // сам оператор
-            if (fmt->infix[0] != '\0')
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "%s", fmt->infix);
-
-            // правый аргумент
-            if (right_needs_parentheses)
-            {
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, "(");
-                TreeToStringSimple(node->right, buffer, pos, buffer_size);
-                *pos += snprintf(buffer + *pos, buffer_size - *pos, ")");
-            }
-            else
-            {
-                TreeToStringSimple(node->right, buffer, pos, buffer_size);
-            }
+            AppendString(builder, fmt->prefix);
+            if (IsLeftParenthesized(node, fmt))
+                AppendChar(builder, '(');
             break;
         }
 
         default:
-            *pos += snprintf(buffer + *pos, buffer_size - *pos, "?");
+            AppendChar(builder, '?');
     }
 }
 
-char* ConvertLatexToPGFPlot(const char* latex_expr)
+// BETWEEN: знак бинарной операции и скобки вокруг него
+static void RenderNodeBetween(Node* node, StringBuilder* builder, FormatGetter get_format)
+{
+    const OpFormat* fmt = IsNodeType(node, NODE_OP) ? get_format(node->data.op_value) : NULL;
+    if (fmt == NULL || !fmt->is_binary)
+        return;
+
+    if (IsLeftParenthesized(node, fmt))
+        AppendChar(builder, ')');
+
+    AppendString(builder, fmt->infix);
+
+    if (IsRightParenthesized(node, fmt))
+        AppendChar(builder, '(');
+}
+
+// LEAVE: закрывающая скобка правого аргумента и постфикс
+static void RenderNodeLeave(Node* node, StringBuilder* builder, FormatGetter get_format)
 {
-    if (!latex_expr)
-        return NULL;
+    const OpFormat* fmt = IsNodeType(node, NODE_OP) ? get_format(node->data.op_value) : NULL;
+    if (fmt == NULL)
+        return;
 
-    size_t len = strlen(latex_expr);
-    char* result = (char*)calloc(len * 2 + 1, sizeof(char));
-    if (!result)
-        return NULL;
+    if (IsRightParenthesized(node, fmt))
+        AppendChar(builder, ')');
 
-    char* dest = result;
-    const char* src = latex_expr;
+    AppendString(builder, fmt->postfix);
+}
 
-    while (*src)
+// общая для LaTeX и PGFPlots расстановка аргументов и скобок по таблице форматов;
+// с use_tex_cache готовые фрагменты поддеревьев берутся из узлов, а новые запоминаются
+static void RenderTree(Node* root, StringBuilder* builder, FormatGetter get_format,
+                       RenderVariableFunction render_variable, void* context, bool use_tex_cache)
+{
+    TreeTraversal traversal = {};
+    if (BeginTreeTraversal(&traversal, root) != TREE_ERROR_NO)
     {
-        if (strncmp(src, "\\sin", 4) == 0)
-        {
-            strcpy(dest, "sin");
-            dest += 3;
-            src += 4;
-        }
-        else if (strncmp(src, "\\cos", 4) == 0)
-        {
-            strcpy(dest, "cos");
-            dest += 3;
-            src += 4;
-        }
-        else if (strncmp(src, "\\tan", 4) == 0)
-        {
-            strcpy(dest, "tan");
-            dest += 3;
-            src += 4;
-        }
-        else if (strncmp(src, "\\ln", 3) == 0)
-        {
-            strcpy(dest, "ln");
-            dest += 2;
-            src += 3;
-        }
-        else if (strncmp(src, "\\cdot", 5) == 0)
-        {
-            *dest++ = '*';
-            src += 5;
-        }
-        else if (strncmp(src, "\\frac", 5) == 0)
-        {
-            *dest++ = '(';
-            src += 5;
-            while (*src && *src != '}')
-            {
-                *dest++ = *src++;
-            }
-            if (*src == '}')
-            {
-                *dest++ = ')';
-                src++;
-            }
-            *dest++ = '/';
-            *dest++ = '(';
-            while (*src && *src != '}')
-            {
-                *dest++ = *src++;
-            }
-            if (*src == '}')
-            {
-                *dest++ = ')';
-                src++;
-            }
-        }
-        else if (strncmp(src, "e^{", 3) == 0)
-        {
-            strcpy(dest, "exp(");
-            dest += 4;
-            src += 3;
-        }
-        else if (*src == '^' && src[1] == '{')
-        {
-            *dest++ = '^';
-            *dest++ = '(';
-            src += 2;
-        }
-        else if (*src == '{')
-        {
-            *dest++ = '(';
-            src++;
-        }
-        else if (*src == '}')
-        {
-            *dest++ = ')';
-            src++;
-        }
-        else if (*src == '\\')
-        {
-            src++;
-        }
-        else if (strncmp(src, "\\tan", 4) == 0)
-        {
-            strcpy(dest, "tan");
-            dest += 3;
-            src += 4;
-        }
-        else if (strncmp(src, "\\cot", 4) == 0)
-        {
-            strcpy(dest, "cot");
-            dest += 3;
-            src += 4;
-        }
-        else if (strncmp(src, "\\arcsin", 7) == 0)
-        {
-            strcpy(dest, "asin");
-            dest += 4;
-            src += 7;
-        }
-        else if (strncmp(src, "\\arccos", 7) == 0)
-        {
-            strcpy(dest, "acos");
-            dest += 4;
-            src += 7;
-        }
-        else if (strncmp(src, "\\arctan", 7) == 0)
-        {
-            strcpy(dest, "atan");
-            dest += 4;
-            src += 7;
-        }
-        else if (strncmp(src, "\\arccot", 7) == 0)
-        {
-            strcpy(dest, "atan");
-            dest += 4;
-            src += 7;
-        }
-        else if (strncmp(src, "\\sinh", 5) == 0)
-        {
-            strcpy(dest, "sinh");
-            dest += 4;
-            src += 5;
-        }
-        else if (strncmp(src, "\\cosh", 5) == 0)
-        {
-            strcpy(dest, "cosh");
-            dest += 4;
-            src += 5;
-        }
-        else if (strncmp(src, "\\tanh", 5) == 0)
-        {
-            strcpy(dest, "tanh");
-            dest += 4;
-            src += 5;
-        }
-        else if (strncmp(src, "\\coth", 5) == 0)
-        {
-            strcpy(dest, "coth");
-            dest += 4;
-            src += 5;
-        }
-        else
+        builder->failed = true;
+        return;
+    }
+
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        Node* node = frame->node;
+        bool is_cached = use_tex_cache && node->tex_cache != NULL;
+
+        switch (frame->event)
         {
-            *dest++ = *src++;
+            case TRAVERSAL_ENTER:
+                if (is_cached)
+                {
+                    AppendChars(builder, node->tex_cache, node->tex_cache_length);
+                    SkipTraversalChildren(&traversal);
+                    break;
+                }
+
+                frame->mark = builder->length;
+                RenderNodeEnter(&traversal, frame, builder, get_format, render_variable, context);
+                break;
+
+            case TRAVERSAL_BETWEEN:
+                RenderNodeBetween(node, builder, get_format);
+                break;
+
+            case TRAVERSAL_LEAVE:
+                if (is_cached)
+                    break;
+
+                RenderNodeLeave(node, builder, get_format);
+                if (use_tex_cache)
+                    StoreRenderedTexCache(node, builder, frame->mark);
+                break;
+
+            default:
+                break;
         }
     }
 
-    *dest = '\0';
-    return result;
+    if (traversal.error != TREE_ERROR_NO)
+        builder->failed = true;
+
+    EndTreeTraversal(&traversal);
+}
+
+static void RenderLatexVariable(Node* node, StringBuilder* builder, void* context)
+{
+    (void)context;
+
+    if (node->data.var_definition.name)
+        AppendString(builder, node->data.var_definition.name);
+    else
+        AppendChar(builder, '?');
+}
+
+// фрагменты поддеревьев запоминаются в узлах, поэтому после шага оптимизации
+// заново отрисовывается только путь от замененного узла к корню
+void TreeToStringSimple(Node* node, StringBuilder* builder)
+{
+    if (node == NULL || builder == NULL)
+        return;
+
+    RenderTree(node, builder, GetOpFormat, RenderLatexVariable, NULL, true);
+}
+
+// ==================== PGFPLOTS ====================
+
+typedef struct {
+    const char*    plot_variable;
+    VariableTable* var_table;
+} PlotRenderContext;
+
+static void RenderPlotVariable(Node* node, StringBuilder* builder, void* context)
+{
+    PlotRenderContext* plot = (PlotRenderContext*)context;
+
+    // pgfplots перебирает по оси x, остальные переменные - константы из таблицы
+    const char* name = node->data.var_definition.name;
+    double value = 0.0;
+
+    if (name != NULL && strcmp(name, plot->plot_variable) == 0)
+        AppendChar(builder, 'x');
+    else if (name != NULL && plot->var_table != NULL &&
+             GetVariableValue(plot->var_table, name, &value) == TREE_ERROR_NO)
+        AppendNumber(builder, value);
+    else
+        AppendString(builder, name ? name : "?");
+}
+
+void TreeToPGFPlotString(Node* node, const char* plot_variable, VariableTable* var_table, StringBuilder* builder)
+{
+    if (node == NULL || plot_variable == NULL || builder == NULL)
+        return;
+
+    PlotRenderContext context = {plot_variable, var_table};
+    RenderTree(node, builder, GetPGFPlotFormat, RenderPlotVariable, &context, false);
 }
 
 TreeErrorType StartLatexDump(FILE* file)
@@ -352,20 +341,257 @@ TreeErrorType StartLatexDump(FILE* file)
     return TREE_ERROR_NO;
 }
 
-TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* diff_variable)
+// ==================== ГРАФИКИ ====================
+
+static const char* const plot_colors[] = {"blue", "red", "green!60!black", "orange", "violet"};
+
+static const char* GetDerivativeNotation(int derivative_order, char* buffer, size_t buffer_size)
+{
+    switch (derivative_order)
+    {
+        case 0:  return "f(x)";
+        case 1:  return "f'(x)";
+        case 2:  return "f''(x)";
+        case 3:  return "f'''(x)";
+        default:
+            snprintf(buffer, buffer_size, "f^{(%d)}(x)", derivative_order);
+            return buffer;
+    }
+}
+
+static void WritePlotValue(FILE* file, double value)
+{
+    // pgfplots с unbounded coords=jump разрывает линию в неопределенных точках
+    if (isfinite(value))
+        fprintf(file, " %.10g", value);
+    else
+        fprintf(file, " nan");
+}
+
+// блочному вычислителю нужно глубина стека * kFastEvalBlockSize чисел, сессии - одно
+// значение на узел; при смене переменной графика она пересчитывает только зависящие узлы
+static TreeErrorType SampleCurveWithSession(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                                            Tree* curve, const double* grid, size_t n_points, double* samples)
+{
+    double saved_value = 0.0;
+    TreeErrorType error = GetVariableValue(&diff_struct->var_table, diff_variable, &saved_value);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    EvaluationSession session = {};
+    error = InitEvaluationSession(&session, curve, &diff_struct->var_table);
+
+    for (size_t j = 0; j < n_points && error == TREE_ERROR_NO; j++)
+    {
+        error = SetVariableValue(&diff_struct->var_table, diff_variable, grid[j]);
+
+        double value = NAN;
+        if (error == TREE_ERROR_NO && EvaluateSession(&session, &value) != TREE_ERROR_NO)
+            value = NAN;
+
+        samples[j] = value;
+    }
+
+    SetVariableValue(&diff_struct->var_table, diff_variable, saved_value);
+    DestroyEvaluationSession(&session);
+    return error;
+}
+
+// f и ее производные считаются на сетке скомпилированными программами,
+// pdflatex получает готовые координаты вместо выражения
+static TreeErrorType SamplePlotCurves(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                                      Tree** curves, int n_curves, double* grid, size_t n_points,
+                                      double** samples)
+{
+    double values[kMaxNOfVariables] = {};
+    FillVariableValues(&diff_struct->var_table, values);
+    int grid_slot = FindVariableByName(&diff_struct->var_table, diff_variable);
+
+    VariableBinding bindings[kMaxNOfVariables] = {};
+    int n_bindings = CollectVariableBindings(&diff_struct->var_table, diff_variable, bindings);
+
+    for (int i = 0; i < n_curves; i++)
+    {
+        CompiledTree compiled = {};
+        TreeErrorType error = CompileSpecializedTree(curves[i], &diff_struct->var_table, bindings, n_bindings,
+                                                     &compiled);
+        if (error == TREE_ERROR_NO && compiled.max_stack_depth > kMaxGridStackDepth)
+            error = SampleCurveWithSession(diff_struct, diff_variable, curves[i], grid, n_points, samples[i]);
+        else if (error == TREE_ERROR_NO)
+            error = ExecuteCompiledTreeOnGrid(&compiled, values, grid_slot, grid, n_points, samples[i]);
+
+        DestroyCompiledTree(&compiled);
+
+        if (error != TREE_ERROR_NO)
+            return error;
+    }
+
+    return TREE_ERROR_NO;
+}
+
+// адаптивная сетка строится по f (и f'', если она посчитана), num_points - бюджет точек
+static TreeErrorType BuildAdaptiveGrid(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                                       Tree** curves, int n_curves, double x_min, double x_max,
+                                       int num_points, double** grid, size_t* n_points)
+{
+    double values[kMaxNOfVariables] = {};
+    FillVariableValues(&diff_struct->var_table, values);
+    int grid_slot = FindVariableByName(&diff_struct->var_table, diff_variable);
+
+    VariableBinding bindings[kMaxNOfVariables] = {};
+    int n_bindings = CollectVariableBindings(&diff_struct->var_table, diff_variable, bindings);
+
+    CompiledTree function = {};
+    CompiledTree second_derivative = {};
+
+    TreeErrorType error = CompileSpecializedTree(curves[0], &diff_struct->var_table, bindings, n_bindings,
+                                                 &function);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    bool has_second_derivative = n_curves > 2 &&
+                                 CompileSpecializedTree(curves[2], &diff_struct->var_table, bindings, n_bindings,
+                                                        &second_derivative) == TREE_ERROR_NO;
+
+    PlotSamples samples = {};
+    error = SampleAdaptively(&function, has_second_derivative ? &second_derivative : NULL, values, grid_slot,
+                             x_min, x_max, (size_t)num_points, &samples);
+
+    DestroyCompiledTree(&function);
+    DestroyCompiledTree(&second_derivative);
+
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    printf("Adaptive sampling: %zu points (budget %d)\n", samples.count, num_points);
+
+    *grid = samples.x;
+    *n_points = samples.count;
+    free(samples.y);
+    return TREE_ERROR_NO;
+}
+
+static TreeErrorType BuildUniformGrid(double x_min, double x_max, int num_points, double** grid, size_t* n_points)
+{
+    *n_points = (size_t)num_points;
+    *grid = (double*)calloc(*n_points, sizeof(double));
+    if (!*grid)
+        return TREE_ERROR_ALLOCATION;
+
+    double step = (num_points > 1) ? (x_max - x_min) / (num_points - 1) : 0.0;
+    for (size_t i = 0; i < *n_points; i++)
+        (*grid)[i] = x_min + step * (double)i;
+
+    return TREE_ERROR_NO;
+}
+
+static TreeErrorType WriteSampledPlots(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                                       Tree** curves, int n_curves, const char* expression,
+                                       double x_min, double x_max, int num_points)
+{
+    double* grid     = NULL;
+    size_t  n_points = 0;
+
+    TreeErrorType error = diff_struct->options.adaptive_plot ?
+                          BuildAdaptiveGrid(diff_struct, diff_variable, curves, n_curves, x_min, x_max,
+                                            num_points, &grid, &n_points) :
+                          BuildUniformGrid(x_min, x_max, num_points, &grid, &n_points);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    double* buffer = (double*)calloc(n_points * (size_t)n_curves, sizeof(double));
+    double* samples[kMaxNumberOfDerivative + 1] = {};
+    if (!buffer)
+    {
+        free(grid);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    for (int i = 0; i < n_curves; i++)
+        samples[i] = buffer + (size_t)i * n_points;
+
+    error = SamplePlotCurves(diff_struct, diff_variable, curves, n_curves, grid, n_points, samples);
+
+    bool use_data_file = (diff_struct->options.plot_mode == PLOT_MODE_DATA_FILE);
+    if (error == TREE_ERROR_NO && use_data_file)
+    {
+        FILE* data_file = fopen(kPlotDataFilename, "w");
+        if (data_file)
+        {
+            fprintf(data_file, "x");
+            for (int i = 0; i < n_curves; i++)
+                fprintf(data_file, " d%d", i);
+            fprintf(data_file, "\n");
+
+            for (size_t j = 0; j < n_points; j++)
+            {
+                fprintf(data_file, "%.10g", grid[j]);
+                for (int i = 0; i < n_curves; i++)
+                    WritePlotValue(data_file, samples[i][j]);
+                fprintf(data_file, "\n");
+            }
+
+            fclose(data_file);
+            printf("Plot data written to %s\n", kPlotDataFilename);
+        }
+        else
+        {
+            error = TREE_ERROR_OPENING_FILE;
+        }
+    }
+
+    FILE* tex = diff_struct->tex_file;
+    for (int i = 0; i < n_curves && error == TREE_ERROR_NO; i++)
+    {
+        const char* color = plot_colors[(size_t)i % (sizeof(plot_colors) / sizeof(plot_colors[0]))];
+
+        if (use_data_file)
+        {
+            fprintf(tex, "\\addplot[%s, thick] table[x index=0, y index=%d] {%s};\n",
+                    color, i + 1, kPlotDataFilename);
+        }
+        else
+        {
+            fprintf(tex, "\\addplot[%s, thick] table[header=false] {\n", color);
+            for (size_t j = 0; j < n_points; j++)
+            {
+                fprintf(tex, "%.10g", grid[j]);
+                WritePlotValue(tex, samples[i][j]);
+                fprintf(tex, "\n");
+            }
+            fprintf(tex, "};\n");
+        }
+
+        char notation_buffer[kMaxCustomNotationLength] = {0};
+        if (i == 0)
+            fprintf(tex, "\\addlegendentry{$f(%s) = %s$}\n", diff_variable, expression);
+        else
+            fprintf(tex, "\\addlegendentry{$%s$}\n",
+                    GetDerivativeNotation(i, notation_buffer, sizeof(notation_buffer)));
+    }
+
+    free(grid);
+    free(buffer);
+    return error;
+}
+
+TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                              Tree* derivative_trees, int n_derivatives)
 {
     if (!diff_struct || !diff_variable)
         return TREE_ERROR_NULL_PTR;
 
     double x_min = -10.0, x_max = 10.0;
     int num_points = 200;
+    PlotMode plot_mode = diff_struct->options.plot_mode;
 
     printf("\n=== Function Plot Generation ===\n");
     printf("Function: ");
 
-    char expression[kMaxLengthOfTexExpression] = {0};
-    int pos = 0;
-    TreeToStringSimple(diff_struct->tree.root, expression, &pos, sizeof(expression));
+    StringBuilder builder = {};
+    InitStringBuilder(&builder);
+    TreeToStringSimple(diff_struct->tree.root, &builder);
+    const char* expression = GetStringBuilderData(&builder);
     printf("%s\n", expression);
 
     printf("Plot variable: %s\n", diff_variable);
@@ -378,7 +604,10 @@ TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* dif
         x_max = 10.0;
     }
 
-    printf("Enter number of points (default 200): ");
+    if (diff_struct->options.adaptive_plot)
+        printf("Enter maximum number of points (default 200): ");
+    else
+        printf("Enter number of points (default 200): ");
     if (scanf("%d", &num_points) != 1 || num_points <= 0)
     {
         num_points = 200;
@@ -387,14 +616,21 @@ TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* dif
     int c = 0;
     while ((c = getchar()) != '\n' && c != EOF);
 
-    char* pgf_expr = ConvertLatexToPGFPlot(expression);
-    if (!pgf_expr)
+    StringBuilder pgf_builder = {};
+    InitStringBuilder(&pgf_builder);
+    if (plot_mode == PLOT_MODE_EXPRESSION)
     {
-        fprintf(stderr, "Error converting expression to PGFPlots format\n");
-        return TREE_ERROR_MEMORY;
-    }
+        TreeToPGFPlotString(diff_struct->tree.root, diff_variable, &diff_struct->var_table, &pgf_builder);
+        if (pgf_builder.failed)
+        {
+            fprintf(stderr, "Error converting expression to PGFPlots format\n");
+            DestroyStringBuilder(&pgf_builder);
+            DestroyStringBuilder(&builder);
+            return TREE_ERROR_MEMORY;
+        }
 
-    printf("PGFPlots expression: %s\n", pgf_expr);
+        printf("PGFPlots expression: %s\n", GetStringBuilderData(&pgf_builder));
+    }
 
     fprintf(diff_struct->tex_file, "\\section*{Function Plot}\n");
     fprintf(diff_struct->tex_file, "Plot of function $f(%s) = %s$ in range $[%.2f, %.2f]$.\n\n",
@@ -413,14 +649,32 @@ TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* dif
     fprintf(diff_struct->tex_file, "    grid style = {dashed, gray!30},\n");
     fprintf(diff_struct->tex_file, "    legend pos = north west,\n");
     fprintf(diff_struct->tex_file, "    title = {Function Plot},\n");
-    fprintf(diff_struct->tex_file, "    domain = %.2f:%.2f,\n", x_min, x_max);
-    fprintf(diff_struct->tex_file, "    samples = %d,\n", num_points);
-    fprintf(diff_struct->tex_file, "    smooth,\n");
-    fprintf(diff_struct->tex_file, "    trig format=rad\n");
-    fprintf(diff_struct->tex_file, "]\n");
 
-    fprintf(diff_struct->tex_file, "\\addplot[blue, thick] {%s};\n", pgf_expr);
-    fprintf(diff_struct->tex_file, "\\addlegendentry{$f(%s) = %s$}\n", diff_variable, expression);
+    TreeErrorType error = TREE_ERROR_NO;
+    if (plot_mode == PLOT_MODE_EXPRESSION)
+    {
+        fprintf(diff_struct->tex_file, "    domain = %.2f:%.2f,\n", x_min, x_max);
+        fprintf(diff_struct->tex_file, "    samples = %d,\n", num_points);
+        fprintf(diff_struct->tex_file, "    smooth,\n");
+        fprintf(diff_struct->tex_file, "    trig format=rad\n");
+        fprintf(diff_struct->tex_file, "]\n");
+
+        fprintf(diff_struct->tex_file, "\\addplot[blue, thick] {%s};\n", GetStringBuilderData(&pgf_builder));
+        fprintf(diff_struct->tex_file, "\\addlegendentry{$f(%s) = %s$}\n", diff_variable, expression);
+    }
+    else
+    {
+        fprintf(diff_struct->tex_file, "    unbounded coords = jump\n");
+        fprintf(diff_struct->tex_file, "]\n");
+
+        Tree* curves[kMaxNumberOfDerivative + 1] = {&diff_struct->tree};
+        int n_curves = 1;
+        for (int i = 0; i < n_derivatives && n_curves < kMaxNumberOfDerivative + 1; i++)
+            curves[n_curves++] = &derivative_trees[i];
+
+        error = WriteSampledPlots(diff_struct, diff_variable, curves, n_curves, expression,
+                                  x_min, x_max, num_points);
+    }
 
     fprintf(diff_struct->tex_file, "\\end{axis}\n");
     fprintf(diff_struct->tex_file, "\\end{tikzpicture}\n");
@@ -429,10 +683,13 @@ TreeErrorType AddFunctionPlot(DifferentiatorStruct* diff_struct, const char* dif
     fprintf(diff_struct->tex_file, "\\end{figure}\n");
     fprintf(diff_struct->tex_file, "\\vspace{1cm}\n\n");
 
-    free(pgf_expr);
-    printf("Plot successfully added to document.\n");
+    DestroyStringBuilder(&pgf_builder);
+    DestroyStringBuilder(&builder);
 
-    return TREE_ERROR_NO;
+    if (error == TREE_ERROR_NO)
+        printf("Plot successfully added to document.\n");
+
+    return error;
 }
 
 TreeErrorType EndLatexDump(FILE* file)
@@ -449,13 +706,14 @@ TreeErrorType DumpOriginalFunctionToFile(FILE* file, Tree* tree, double result_v
     if (file == NULL || tree == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    char expression[kMaxLengthOfTexExpression] = {0};
-    int pos = 0;
-    TreeToStringSimple(tree->root, expression, &pos, sizeof(expression));
+    StringBuilder expression = {};
+    InitStringBuilder(&expression);
+    TreeToStringSimple(tree->root, &expression);
 
     fprintf(file, "\\subsection*{Original Expression}\n");
     fprintf(file, "Expression:\n");
-    fprintf(file, "\\begin{dmath} %s \\end{dmath}\n\n", expression);
+    fprintf(file, "\\begin{dmath} %s \\end{dmath}\n\n", GetStringBuilderData(&expression));
+    DestroyStringBuilder(&expression);
     fprintf(file, "Evaluation result:\n");
     fprintf(file, "\\begin{dmath} %.6f \\end{dmath}\n\n", result_value);
 
@@ -470,11 +728,12 @@ TreeErrorType DumpOptimizationStepToFile(FILE* file, const char* description, Tr
     fprintf(file, "\\subsubsection*{Optimization Step}\n");
     fprintf(file, "It is easy to see that %s:\n\n", description);
 
-    char expression[kMaxLengthOfTexExpression] = {0};
-    int pos = 0;
-    TreeToStringSimple(tree->root, expression, &pos, sizeof(expression));
+    StringBuilder expression = {};
+    InitStringBuilder(&expression);
+    TreeToStringSimple(tree->root, &expression);
 
-    fprintf(file, "\\begin{dmath} %s \\end{dmath}\n\n", expression);
+    fprintf(file, "\\begin{dmath} %s \\end{dmath}\n\n", GetStringBuilderData(&expression));
+    DestroyStringBuilder(&expression);
     fprintf(file, "\\vspace{0.5em}\n");
 
     return TREE_ERROR_NO;
@@ -485,34 +744,19 @@ TreeErrorType DumpDerivativeToFile(FILE* file, Tree* derivative_tree, double der
     if (file == NULL || derivative_tree == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    char derivative_expr[kMaxLengthOfTexExpression] = {0};
-    int pos = 0;
-    TreeToStringSimple(derivative_tree->root, derivative_expr, &pos, sizeof(derivative_expr));
+    StringBuilder derivative_expr = {};
+    InitStringBuilder(&derivative_expr);
+    TreeToStringSimple(derivative_tree->root, &derivative_expr);
 
-    const char* derivative_notation = NULL;
     char custom_notation[kMaxCustomNotationLength] = {0};
-
-    if (derivative_order == 1)
-    {
-        derivative_notation = "f'(x)";
-    }
-    else if (derivative_order == 2)
-    {
-        derivative_notation = "f''(x)";
-    }
-    else if (derivative_order == 3)
-    {
-        derivative_notation = "f'''(x)";
-    }
-    else
-    {
-        snprintf(custom_notation, sizeof(custom_notation), "f^{(%d)}(x)", derivative_order);
-        derivative_notation = custom_notation;
-    }
+    const char* derivative_notation = GetDerivativeNotation(derivative_order, custom_notation,
+                                                            sizeof(custom_notation));
 
     fprintf(file, "\\subsection*{Derivative of Order %d}\n", derivative_order);
     fprintf(file, "Derivative:\n");
-    fprintf(file, "\\begin{dmath} %s = %s \\end{dmath}\n\n", derivative_notation, derivative_expr);
+    fprintf(file, "\\begin{dmath} %s = %s \\end{dmath}\n\n", derivative_notation,
+            GetStringBuilderData(&derivative_expr));
+    DestroyStringBuilder(&derivative_expr);
     fprintf(file, "Value of derivative at point:\n");
     fprintf(file, "\\begin{dmath} %s = %.6f \\end{dmath}\n\n", derivative_notation, derivative_result);
 
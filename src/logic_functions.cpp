@@ -3,17 +3,17 @@
 
 bool is_zero(double number)
 {
-    return fabs(number) < 1e-10;
+    return fabs(number) < kZeroEpsilon;
 }
 
 bool is_one(double number)
 {
-    return fabs(number - 1) < 1e-10;
+    return fabs(number - 1) < kZeroEpsilon;
 }
 
 bool is_minus_one(double number)
 {
-    return fabs(number + 1) < 1e-10;
+    return fabs(number + 1) < kZeroEpsilon;
 }
 
 bool is_unary(OperationType op)
@@ -21,7 +21,7 @@ bool is_unary(OperationType op)
     return (op == OP_SIN    || op == OP_COS    || op == OP_TAN    || op == OP_COT    ||
             op == OP_ARCSIN || op == OP_ARCCOS || op == OP_ARCTAN || op == OP_ARCCOT ||
             op == OP_SINH   || op == OP_COSH   || op == OP_TANH   || op == OP_COTH   ||
-            op == OP_LN     || op == OP_EXP);
+            op == OP_LN     || op == OP_EXP    || op == OP_SQRT);
 }
 
 bool is_binary(OperationType op)
@@ -4,10 +4,38 @@
 #include "processing_diff.h"
 #include "tree_error_types.h"
 #include "user_interface.h"
+#include "batch_diff.h"
+#include "cost_model.h"
 
 // FIXME - сделай так, чтобы у тебя код помещался до этой вертикальной линии ======================>
 int main(int argc, const char** argv)
 {
+    ProgramOptions options = {};
+    if (ParseProgramOptions(argc, argv, &options) != TREE_ERROR_NO)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.measure_costs)
+    {
+        double costs[OP_COUNT] = {};
+        TreeErrorType cost_error = MeasureOperationCosts(costs, kCostBenchmarkIterations);
+        if (cost_error == TREE_ERROR_NO)
+            PrintOperationCostTable(stdout, costs);
+
+        return (cost_error == TREE_ERROR_NO) ? 0 : 1;
+    }
+
+    if (options.batch_mode)
+    {
+        TreeErrorType batch_error = RunBatchMode(&options);
+        if (batch_error != TREE_ERROR_NO)
+            fprintf(stderr, "Пакетная обработка завершилась c ошибкой: %s\n", GetTreeErrorString(batch_error));
+
+        return (batch_error == TREE_ERROR_NO) ? 0 : 1;
+    }
+
     InitTreeLog("penis");
 
     DifferentiatorStruct* diff_struct = CreateDifferentiatorStruct();
@@ -17,6 +45,8 @@ int main(int argc, const char** argv)
         return 1;
     }
 
+    diff_struct->options = options;
+
     InitTreeLog("differenciator_tree");
     InitTreeLog("differentiator_parse");
 
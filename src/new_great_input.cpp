@@ -4,11 +4,20 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <charconv>
 #include "tree_base.h"
 #include "DSL.h"
 #include "logic_functions.h"
 
 
+static bool ComputeOperationHashes(OperationInfo* operations, size_t operations_count)
+{
+    for (size_t i = 0; i < operations_count; i++)
+        operations[i].hash = ComputeHash(operations[i].name);
+
+    return true;
+}
+
 static ParserContext* CreateParserContext(VariableTable* var_table)
 {
     static OperationInfo default_operations[] = {
@@ -25,11 +34,17 @@ static ParserContext* CreateParserContext(VariableTable* var_table)
         {0, "sinh", OP_SINH},
         {0, "cosh", OP_COSH},
         {0, "tanh", OP_TANH},
-        {0, "coth", OP_COTH}
+        {0, "coth", OP_COTH},
+        {0, "sqrt", OP_SQRT}
     };
 
     static size_t default_operations_count = sizeof(default_operations) / sizeof(default_operations[0]);
 
+    // инициализация статической переменной потокобезопасна, поэтому хеши
+    // считаются ровно один раз, даже если парсеры работают в нескольких потоках
+    static const bool default_hashes_initialized = ComputeOperationHashes(default_operations,
+                                                                          default_operations_count);
+
     ParserContext* context = (ParserContext*)calloc(1, sizeof(ParserContext));
     if (!context)
         return NULL;
@@ -38,8 +53,11 @@ static ParserContext* CreateParserContext(VariableTable* var_table)
 
     context->operations = default_operations; //сохраняем указатель на статический массив зарезервированных операций
     context->operations_count = default_operations_count;
-    context->hashes_initialized = false;
+    context->hashes_initialized = default_hashes_initialized;
     context->original_string = NULL;
+    context->name_buffer = NULL;
+    context->name_buffer_size = 0;
+    context->name_buffer_used = 0;
 
     return context;
 }
@@ -85,6 +103,7 @@ static Node* CreateOperation(OperationType op, Node* left, Node* right)
             case OP_COSH:   result = COSH(right);   break;
             case OP_TANH:   result = TANH(right);   break;
             case OP_COTH:   result = COTH(right);   break;
+            case OP_SQRT:   result = SQRT(right);   break;
             default: break;
         }
 
@@ -128,15 +147,49 @@ static Node* CreateVariableNode(const char* name)
     return CreateNode(NODE_VAR, data, NULL, NULL);
 }
 
-Node* GetGovnoNaBosuNogu(const char** string, VariableTable* var_table)
+static Node* CreateVariableView(char* name)
 {
-    assert(string);
-    assert(var_table);
+    ValueOfTreeElement data = {};
+    data.var_definition.name = name;
+    data.var_definition.is_view = true;
 
-    ParserContext* context = CreateParserContext(var_table);
-    if (!context)
+    return CreateNode(NODE_VAR, data, NULL, NULL);
+}
+
+// каждое имя хранится в буфере дерева один раз, узлы ссылаются на него без выделения памяти
+static char* InternVariableName(ParserContext* context, const char* name, size_t length)
+{
+    assert(context);
+    assert(context->name_buffer);
+
+    size_t offset = 0;
+    while (offset < context->name_buffer_used)
+    {
+        char* stored = context->name_buffer + offset;
+        size_t stored_length = strlen(stored);
+
+        if (stored_length == length && memcmp(stored, name, length) == 0)
+            return stored;
+
+        offset += stored_length + 1;
+    }
+
+    if (context->name_buffer_used + length + 1 > context->name_buffer_size)
         return NULL;
 
+    char* stored = context->name_buffer + context->name_buffer_used;
+    memcpy(stored, name, length);
+    stored[length] = '\0';
+    context->name_buffer_used += length + 1;
+
+    return stored;
+}
+
+static Node* ParseWithContext(const char** string, ParserContext* context)
+{
+    assert(string);
+    assert(context);
+
     context->original_string = *string;
 
     Node* val = GetE(string, context);
@@ -145,17 +198,76 @@ Node* GetGovnoNaBosuNogu(const char** string, VariableTable* var_table)
     {
         printf("Expected end of expression '$'\n");
         SyntaxError();
-        printf("%s\n", *string);
+        printf("%.*s\n", (int)strcspn(*string, "$"), *string);
         if (val)
             FreeSubtree(val);
 
-        FreeParserContext(context);
         return NULL;
     }
 
+    return val;
+}
+
+Node* GetGovnoNaBosuNogu(const char** string, VariableTable* var_table)
+{
+    assert(string);
+    assert(var_table);
+
+    ParserContext* context = CreateParserContext(var_table);
+    if (!context)
+        return NULL;
+
+    Node* val = ParseWithContext(string, context);
+
     FreeParserContext(context);
     return val;
 }
+
+TreeErrorType ParseExpressionIntoTree(Tree* tree, const char* expression, VariableTable* var_table)
+{
+    if (tree == NULL || expression == NULL || var_table == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (tree->root != NULL || tree->file_buffer != NULL)
+        return TREE_ERROR_ALREADY_INITIALIZED;
+
+    // каждое имя в тексте занимает L байт и за ним идет хотя бы один другой символ,
+    // поэтому копиям имен с '\0' хватает длины выражения; больше kMaxNOfVariables имен не бывает
+    size_t buffer_size = strcspn(expression, "$") + 1;
+    size_t max_buffer_size = (size_t)kMaxNOfVariables * (size_t)kMaxVariableLength;
+    if (buffer_size > max_buffer_size)
+        buffer_size = max_buffer_size;
+
+    char* name_buffer = (char*)calloc(buffer_size, sizeof(char));
+    if (!name_buffer)
+        return TREE_ERROR_ALLOCATION;
+
+    ParserContext* context = CreateParserContext(var_table);
+    if (!context)
+    {
+        free(name_buffer);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    context->name_buffer = name_buffer;
+    context->name_buffer_size = buffer_size;
+
+    const char* ptr = expression;
+    Node* root = ParseWithContext(&ptr, context);
+
+    FreeParserContext(context);
+
+    if (root == NULL)
+    {
+        free(name_buffer);
+        return TREE_ERROR_FORMAT;
+    }
+
+    SetTreeRoot(tree, root);
+    tree->file_buffer = name_buffer;
+
+    return TREE_ERROR_NO;
+}
 // FIXME static
 Node* GetE(const char** string, ParserContext* context)
 {
@@ -292,31 +404,61 @@ Node* GetP(const char** string, ParserContext* context)
     return NULL;
 }
 
+static bool IsNumberTokenChar(const char* current)
+{
+    if (isxdigit(*current) || *current == '.' || *current == 'x' || *current == 'X' ||
+        *current == 'p'    || *current == 'P')
+        return true;
+
+    // знак допустим только сразу после показателя степени: 1e-5, 0x1p+3
+    return (*current == '+' || *current == '-') &&
+           (current[-1] == 'e' || current[-1] == 'E' || current[-1] == 'p' || current[-1] == 'P');
+}
+
 Node* GetN(const char** string)
 {
     assert(string);
 
-    if (isdigit(**string))
+    const char* start = *string;
+    if (!isdigit(*start) && !(*start == '.' && isdigit(start[1])))
+        return NULL;
+
+    // быстрый путь: короткое целое без дробной части и порядка точно представимо в double
+    const char* current = start;
+    unsigned long long integer_value = 0;
+    while (isdigit(*current))
     {
-        int val = 0;
-        const char* start = *string;
+        integer_value = integer_value * 10 + (unsigned long long)(*current - '0');
+        current++;
+    }
 
-        while ('0' <= **string && **string <= '9') //FIXME
-        {
-            val = **string - '0' + val * 10;
-            (*string)++;
-        }
+    bool has_fraction_or_exponent = (*current != '\0' && strchr(".eExXpP", *current) != NULL);
+    if (current - start <= kMaxExactIntegerDigits && !has_fraction_or_exponent)
+    {
+        *string = current;
+        return NUM((double)integer_value);
+    }
 
-        if (start == *string)
-        {
-            SyntaxError();
-            return NULL;
-        }
+    // общий случай: десятичная дробь, порядок, шестнадцатеричная запись (0x1.8p3)
+    const char* end = current;
+    while (*end != '\0' && IsNumberTokenChar(end))
+        end++;
+
+    bool is_hex = (start[0] == '0' && (start[1] == 'x' || start[1] == 'X'));
+    const char* digits = is_hex ? start + 2 : start;
 
-        return NUM((double)val);
+    double val = 0.0;
+    std::from_chars_result parsed = std::from_chars(digits, end, val,
+                                                    is_hex ? std::chars_format::hex
+                                                           : std::chars_format::general);
+    if (parsed.ec != std::errc() || parsed.ptr == digits)
+    {
+        SyntaxError();
+        return NULL;
     }
 
-    return NULL;
+    *string = parsed.ptr;
+    return NUM(val);
 }
 
 Node* GetV(const char** string, ParserContext* context)
@@ -327,22 +469,32 @@ Node* GetV(const char** string, ParserContext* context)
     if (!isalpha(**string))
         return NULL;
 
-    char var_name[kMaxVariableLength] = {0};
-    int i = 0;
-    const char* start = *string;
+    size_t length = 0;
+    while ('a' <= (*string)[length] && (*string)[length] <= 'z' && length < (size_t)kMaxVariableLength - 1)
+        length++;
 
-    while (**string >= 'a' && **string <= 'z' && i < 255)
+    if (length == 0)
     {
-        var_name[i++] = **string;
-        (*string)++;
+        SyntaxError();
+        return NULL;
     }
 
-    if (start == *string)
+    char  local_name[kMaxVariableLength] = {0};
+    char* var_name = local_name;
+
+    if (context->name_buffer != NULL)
     {
-        SyntaxError();
-        return NULL;
+        var_name = InternVariableName(context, *string, length);
+        if (!var_name)
+            return NULL;
+    }
+    else
+    {
+        memcpy(local_name, *string, length);
     }
 
+    *string += length;
+
     TreeErrorType error = AddVariable(context->var_table, var_name);
     if (error != TREE_ERROR_NO && error != TREE_ERROR_VARIABLE_ALREADY_EXISTS &&
         error != TREE_ERROR_REDEFINITION_VARIABLE)
@@ -351,21 +503,27 @@ Node* GetV(const char** string, ParserContext* context)
         return NULL;
     }
 
+    if (context->name_buffer != NULL)
+        return CreateVariableView(var_name);
+
     return CreateVariableNode(var_name);
     // return VAR(var_name); //FIXME какая-то хуйня происходит в этом случае
 }
 
-static bool FindOperationByName(ParserContext* context, const char* func_name, OperationType* found_op) //используется в GetV
+static bool FindOperationByName(ParserContext* context, const char* func_name, size_t name_length,
+                                OperationType* found_op) //используется в GetV
 {
     assert(context);
     assert(func_name);
     assert(found_op);
 
-    unsigned int func_hash = ComputeHash(func_name);
+    unsigned int func_hash = ComputeHashOfSpan(func_name, name_length);
 
     for (size_t j = 0; j < context->operations_count; j++)
     {
-        if (func_hash == context->operations[j].hash)
+        const char* op_name = context->operations[j].name;
+        if (func_hash == context->operations[j].hash &&
+            strncmp(op_name, func_name, name_length) == 0 && op_name[name_length] == '\0')
         {
             *found_op = context->operations[j].op_value;
             return true;
@@ -384,22 +542,17 @@ Node* GetFunction(const char** string, ParserContext* context)
 
     const char* original_pos = *string;
 
-    char func_name[kMaxFuncNameLength] = {0};
+    // имя не копируется: вход может быть отображенным файлом без '\0' в конце
+    size_t chars_read = 0;
+    while ('a' <= (*string)[chars_read] && (*string)[chars_read] <= 'z' && chars_read < (size_t)kMaxFuncNameLength - 1)
+        chars_read++;
 
-    int chars_read = 0;
-    assert(kMaxFuncNameLength == 256);
-    if(sscanf(*string, "%255[a-z]%n", func_name, &chars_read) == 1)
-    {
-        *string += chars_read;
-    }
-    else
-    {
-        *string = original_pos;
+    if (chars_read == 0)
         return NULL;
-    }
 
     OperationType found_op = OP_ADD;
-    bool found = FindOperationByName(context, func_name, &found_op);
+    bool found = FindOperationByName(context, *string, chars_read, &found_op);
+    *string += chars_read;
 
     if (!found)
     {
@@ -12,183 +12,218 @@
 #include "tree_base.h"
 #include "latex_dump.h"
 #include "dump.h"
+#include "cost_model.h"
+#include "canonical_form.h"
+#include "polynomial.h"
+#include "egraph.h"
+#include "rule_matcher.h"
+#include "tree_traversal.h"
+#include "tree_fingerprint.h"
 #include "DSL.h"
 
 // ==================== ПРОТОТИПЫ ФУНКЦИЙ ====================
 static bool  ContainsVariable(Node* node, const char* variable_name);
-static void  ReplaceNode(Node** node_ptr, Node* new_node);
+static void  ReplaceNode(Tree* tree, Node** node_ptr, Node* new_node);
 static Node* DifferentiateNode(Node* node, const char* variable_name);
 
 // ==================== ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ ====================
 
 void FreeSubtree(Node* node)
 {
-    if (node == NULL)
-        return;
+    FreeNode(node);
+}
+
+// для унарных операций аргумент передается в right
+// x^n для целого n возведением в квадрат: log2(n) умножений вместо вызова pow
+double PowerBySquaring(double base, long exponent)
+{
+    bool is_negative = exponent < 0;
+    unsigned long rest = is_negative ? (unsigned long)(-exponent) : (unsigned long)exponent;
 
-    FreeSubtree(node->left);
-    FreeSubtree(node->right);
+    double result = 1.0;
+    while (rest != 0)
+    {
+        if (rest & 1)
+            result *= base;
 
-    if (node->type == NODE_VAR && node->data.var_definition.name != NULL)
-        free(node->data.var_definition.name);
+        rest >>= 1;
+        if (rest != 0)
+            base *= base;
+    }
 
-    free(node);
+    return is_negative ? 1.0 / result : result;
 }
 
-static TreeErrorType EvaluateTreeRecursive(Node* node, VariableTable* var_table, double* result, int depth)
+double RaiseToPower(double base, double exponent)
 {
-    if (node == NULL)
-        return TREE_ERROR_NULL_PTR;
+    if (fabs(exponent) <= kMaxSquaringExponent && fpclassify(exponent - trunc(exponent)) == FP_ZERO)
+        return PowerBySquaring(base, (long)exponent);
 
-    if (result == NULL)
-        return TREE_ERROR_NULL_PTR;
+    return pow(base, exponent);
+}
 
-    switch (node->type)
+TreeErrorType ApplyOperation(OperationType op, double left, double right, double* result)
+{
+    switch (op)
     {
-        case NODE_NUM:
-            *result = node->data.num_value;
-            return TREE_ERROR_NO;
+        case OP_ADD:
+            *result = left + right;
+            break;
+        case OP_SUB:
+            *result = left - right;
+            break;
+        case OP_MUL:
+            *result = left * right;
+            break;
+        case OP_DIV:
+            if (is_zero(right))
+                return TREE_ERROR_DIVISION_BY_ZERO;
+            *result = left / right;
+            break;
+        case OP_SIN:
+            *result = sin(right);
+            break;
+        case OP_COS:
+            *result = cos(right);
+            break;
+        case OP_TAN:
+            *result = tan(right);
+            break;
+        case OP_COT:
+            if (is_zero(tan(right)))
+                return TREE_ERROR_DIVISION_BY_ZERO;
+            *result = 1.0 / tan(right);
+            break;
+        case OP_ARCSIN:
+            if (right < -1.0 || right > 1.0)
+                return TREE_ERROR_MATH_DOMAIN;
+            *result = asin(right);
+            break;
+        case OP_ARCCOS:
+            if (right < -1.0 || right > 1.0)
+                return TREE_ERROR_MATH_DOMAIN;
+            *result = acos(right);
+            break;
+        case OP_ARCTAN:
+            *result = atan(right);
+            break;
+        case OP_ARCCOT:
+            *result = M_PI/2.0 - atan(right);
+            break;
+        case OP_SINH:
+            *result = sinh(right);
+            break;
+        case OP_COSH:
+            *result = cosh(right);
+            break;
+        case OP_TANH:
+            *result = tanh(right);
+            break;
+        case OP_COTH:
+            if (is_zero(tanh(right)))
+                return TREE_ERROR_DIVISION_BY_ZERO;
+            *result = 1.0 / tanh(right);
+            break;
+        case OP_POW:
+            // те же ошибки, что у 1/x и sqrt(x): понижение x^-1 и x^0.5 не меняет область определения
+            if (is_zero(left) && right < 0)
+                return TREE_ERROR_DIVISION_BY_ZERO;
+            if (left < 0 && fpclassify(right - trunc(right)) != FP_ZERO)
+                return TREE_ERROR_MATH_DOMAIN;
+            *result = RaiseToPower(left, right);
+            break;
+        case OP_LN:
+            if (right <= 0)
+                return TREE_ERROR_YCHI_MATAN;
+            *result = log(right);
+            break;
+        case OP_EXP:
+            *result = exp(right);
+            break;
+        case OP_SQRT:
+            if (right < 0)
+                return TREE_ERROR_MATH_DOMAIN;
+            *result = sqrt(right);
+            break;
+        default:
+            return TREE_ERROR_UNKNOWN_OPERATION;
+    }
 
-        case NODE_OP:
-            {
-                double left_result = 0, right_result = 0;
-                TreeErrorType error = TREE_ERROR_NO;
+    return TREE_ERROR_NO;
+}
 
-                if (node->right == NULL)
-                    return TREE_ERROR_NULL_PTR;
+static TreeErrorType EvaluateVariable(Node* node, VariableTable* var_table, double* result)
+{
+    if (node->data.var_definition.name == NULL)
+        return TREE_ERROR_VARIABLE_NOT_FOUND;
 
-                if (is_binary(node->data.op_value))
-                {
-                    if (node->left == NULL)
-                        return TREE_ERROR_NULL_PTR;
+    char* var_name = node->data.var_definition.name;
+    double value = 0.0;
+    TreeErrorType error = GetVariableValue(var_table, var_name, &value);
 
-                    error = EvaluateTreeRecursive(node->left, var_table, &left_result, depth + 1);
-                    if (error != TREE_ERROR_NO)
-                        return error;
-                }
+    if (error == TREE_ERROR_VARIABLE_NOT_FOUND)
+    {
+        error = AddVariable(var_table, var_name);
+        if (error != TREE_ERROR_NO)
+            return error;
 
-                error = EvaluateTreeRecursive(node->right, var_table, &right_result, depth + 1);
-                if (error != TREE_ERROR_NO)
-                    return error;
+        error = RequestVariableValue(var_table, var_name);
+        if (error != TREE_ERROR_NO) return error;
 
-                switch (node->data.op_value)
-                {
-                    case OP_ADD:
-                        *result = left_result + right_result;
-                        break;
-                    case OP_SUB:
-                        *result = left_result - right_result;
-                        break;
-                    case OP_MUL:
-                        *result = left_result * right_result;
-                        break;
-                    case OP_DIV:
-                        if (is_zero(right_result))
-                            return TREE_ERROR_DIVISION_BY_ZERO;
-                        *result = left_result / right_result;
-                        break;
-                    case OP_SIN:
-                        *result = sin(right_result);
-                        break;
-                    case OP_COS:
-                        *result = cos(right_result);
-                        break;
-                    case OP_TAN:
-                        *result = tan(right_result);
-                        break;
-                    case OP_COT:
-                        if (is_zero(tan(right_result)))
-                            return TREE_ERROR_DIVISION_BY_ZERO;
-                        *result = 1.0 / tan(right_result);
-                        break;
-                    case OP_ARCSIN:
-                        if (right_result < -1.0 || right_result > 1.0)
-                            return TREE_ERROR_MATH_DOMAIN;
-                        *result = asin(right_result);
-                        break;
-                    case OP_ARCCOS:
-                        if (right_result < -1.0 || right_result > 1.0)
-                            return TREE_ERROR_MATH_DOMAIN;
-                        *result = acos(right_result);
-                        break;
-                    case OP_ARCTAN:
-                        *result = atan(right_result);
-                        break;
-                    case OP_ARCCOT:
-                        *result = M_PI/2.0 - atan(right_result);
-                        break;
-                    case OP_SINH:
-                        *result = sinh(right_result);
-                        break;
-                    case OP_COSH:
-                        *result = cosh(right_result);
-                        break;
-                    case OP_TANH:
-                        *result = tanh(right_result);
-                        break;
-                    case OP_COTH:
-                        if (is_zero(tanh(right_result)))
-                            return TREE_ERROR_DIVISION_BY_ZERO;
-                        *result = 1.0 / tanh(right_result);
-                        break;
-                    case OP_POW:
-                        *result = pow(left_result, right_result);
-                        break;
-                    case OP_LN:
-                        if (right_result <= 0)
-                            return TREE_ERROR_YCHI_MATAN;
-                        *result = log(right_result);
-                        break;
-                    case OP_EXP:
-                        *result = exp(right_result);
-                        break;
-                    default:
-                        return TREE_ERROR_UNKNOWN_OPERATION;
-                }
-                return TREE_ERROR_NO;
-            }
+        error = GetVariableValue(var_table, var_name, &value);
+        if (error != TREE_ERROR_NO) return error;
+    }
+    else if (error == TREE_ERROR_VARIABLE_UNDEFINED)
+    {
+        error = RequestVariableValue(var_table, var_name);
+        if (error != TREE_ERROR_NO) return error;
 
-        case NODE_VAR:
-            {
-                if (node->data.var_definition.name == NULL)
-                    return TREE_ERROR_VARIABLE_NOT_FOUND;
+        error = GetVariableValue(var_table, var_name, &value);
+        if (error != TREE_ERROR_NO) return error;
+    }
+    else if (error != TREE_ERROR_NO)
+    {
+        return error;
+    }
 
-                char* var_name = node->data.var_definition.name;
-                double value = 0.0;
-                TreeErrorType error = GetVariableValue(var_table, var_name, &value);
+    *result = value;
+    return TREE_ERROR_NO;
+}
 
-                if (error == TREE_ERROR_VARIABLE_NOT_FOUND)
-                {
-                    error = AddVariable(var_table, var_name);
-                    if (error != TREE_ERROR_NO)
-                        return error;
+// по линеаризации дерева со стеком значений: левое поддерево вычисляется целиком
+// раньше правого, поэтому значения переменных запрашиваются слева направо
+static TreeErrorType EvaluatePostOrderNode(Node* node, double* stack, size_t* depth, VariableTable* var_table)
+{
+    double value = 0.0;
+    TreeErrorType error = TREE_ERROR_NO;
 
-                    error = RequestVariableValue(var_table, var_name);
-                    if (error != TREE_ERROR_NO) return error;
+    switch (node->type)
+    {
+        case NODE_NUM:
+            value = node->data.num_value;
+            break;
 
-                    error = GetVariableValue(var_table, var_name, &value);
-                    if (error != TREE_ERROR_NO) return error;
-                }
-                else if (error == TREE_ERROR_VARIABLE_UNDEFINED)
-                {
-                    error = RequestVariableValue(var_table, var_name);
-                    if (error != TREE_ERROR_NO) return error;
+        case NODE_VAR:
+            error = EvaluateVariable(node, var_table, &value);
+            break;
 
-                    error = GetVariableValue(var_table, var_name, &value);
-                    if (error != TREE_ERROR_NO) return error;
-                }
-                else if (error != TREE_ERROR_NO)
-                {
-                    return error;
-                }
+        case NODE_OP:
+        {
+            if (node->right == NULL || (is_binary(node->data.op_value) && node->left == NULL))
+                return TREE_ERROR_NULL_PTR;
 
-                *result = value;
-                return TREE_ERROR_NO;
-            }
+            double right = stack[--(*depth)];
+            double left  = (node->left != NULL) ? stack[--(*depth)] : 0.0;
+            error = ApplyOperation(node->data.op_value, left, right, &value);
+            break;
+        }
 
         default:
             return TREE_ERROR_UNKNOWN_OPERATION;
     }
+
+    stack[(*depth)++] = value;
+    return error;
 }
 
 TreeErrorType EvaluateTree(Tree* tree, VariableTable* var_table, double* result)
@@ -199,62 +234,66 @@ TreeErrorType EvaluateTree(Tree* tree, VariableTable* var_table, double* result)
     if (tree->root == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    return EvaluateTreeRecursive(tree->root, var_table, result, 0);
+    Node* const* nodes = GetTreePostOrder(tree);
+    double* stack = nodes ? (double*)malloc(tree->size * sizeof(double)) : NULL;
+    if (!stack)
+        return TREE_ERROR_ALLOCATION;
+
+    TreeErrorType error = TREE_ERROR_NO;
+    size_t depth = 0;
+    for (size_t i = 0; i < tree->size && error == TREE_ERROR_NO; i++)
+        error = EvaluatePostOrderNode(nodes[i], stack, &depth, var_table);
+
+    if (error == TREE_ERROR_NO)
+        *result = stack[0];
+
+    free(stack);
+    return error;
 }
 
-Node* CreateNode(NodeType type, ValueOfTreeElement data, Node* left, Node* right)
+// приоритет для расстановки скобок; функции вне этого списка скобок вокруг себя не требуют
+static const int operation_priorities[OP_COUNT] = {
+    /* OP_ADD */    1,
+    /* OP_SUB */    1,
+    /* OP_MUL */    2,
+    /* OP_DIV */    2,
+    /* OP_POW */    4,
+    /* OP_SIN */    3,
+    /* OP_COS */    3,
+    /* OP_TAN */    0,
+    /* OP_COT */    0,
+    /* OP_ARCSIN */ 0,
+    /* OP_ARCCOS */ 0,
+    /* OP_ARCTAN */ 0,
+    /* OP_ARCCOT */ 0,
+    /* OP_SINH */   0,
+    /* OP_COSH */   0,
+    /* OP_TANH */   0,
+    /* OP_COTH */   0,
+    /* OP_LN */     3,
+    /* OP_EXP */    3,
+    /* OP_SQRT */   0
+};
+
+int GetOperationPriority(OperationType op)
 {
-    Node* node = (Node*)calloc(1, sizeof(Node));
-    if (!node)
-        return NULL;
+    if (op < 0 || op >= OP_COUNT)
+        return 0;
+
+    return operation_priorities[op];
+}
 
+// поля узла в обнуленной памяти; block задается тем, кто выделил память
+static Node* InitNode(Node* node, NodeType type, ValueOfTreeElement data, Node* left, Node* right)
+{
     node->type = type;
     node->left = left;
     node->right = right;
     node->parent = NULL;
     node->data = data;
+    node->subtree_size = 1 + (left ? left->subtree_size : 0) + (right ? right->subtree_size : 0);
 
-    switch (type)
-    {
-        case NODE_NUM:
-        case NODE_VAR:
-            node->priority = 0;
-            break;
-
-        case NODE_OP:
-            switch (data.op_value)
-            {
-                case OP_ADD:
-                case OP_SUB:
-                    node->priority = 1;
-                    break;
-
-                case OP_MUL:
-                case OP_DIV:
-                    node->priority = 2;
-                    break;
-
-                case OP_SIN:
-                case OP_COS:
-                case OP_LN:
-                case OP_EXP:
-                    node->priority = 3;
-                    break;
-
-                case OP_POW:
-                    node->priority = 4;
-                    break;
-
-                default:
-                    node->priority = 0;
-                    break;
-            }
-            break;
-
-        default:
-            node->priority = 0;
-            break;
-    }
+    node->priority = (type == NODE_OP) ? GetOperationPriority(data.op_value) : 0;
 
     if (type == NODE_VAR && data.var_definition.name != NULL)
     {
@@ -270,6 +309,15 @@ Node* CreateNode(NodeType type, ValueOfTreeElement data, Node* left, Node* right
     return node;
 }
 
+Node* CreateNode(NodeType type, ValueOfTreeElement data, Node* left, Node* right)
+{
+    Node* node = (Node*)calloc(1, sizeof(Node));
+    if (!node)
+        return NULL;
+
+    return InitNode(node, type, data, left, right);
+}
+
 static Node* CreateVariableNode(const char* name)
 {
     if (!name)
@@ -284,11 +332,31 @@ static Node* CreateVariableNode(const char* name)
     return CreateNode(NODE_VAR, data, NULL, NULL);
 }
 
-Node* CopyNode(Node* original)
+// поддеревья, построенные для еще не законченных узлов, после прерванного обхода
+static void FreeTraversalResults(TreeTraversal* traversal)
 {
-    if (original == NULL)
-        return NULL;
+    for (size_t i = 0; i < traversal->depth; i++)
+    {
+        FreeSubtree(traversal->frames[i].left_result.node);
+        FreeSubtree(traversal->frames[i].right_result.node);
+    }
+
+    FreeSubtree(traversal->result.node);
+    traversal->result.node = NULL;
+}
 
+// узел копии берется из блока, а если блок исчерпан - выделяется отдельно
+static Node* CreateCopyNode(NodeBlock* block, NodeType type, ValueOfTreeElement data, Node* left, Node* right)
+{
+    Node* node = TakeBlockNode(block);
+    if (node == NULL)
+        node = (Node*)calloc(1, sizeof(Node));
+
+    return node ? InitNode(node, type, data, left, right) : NULL;
+}
+
+static Node* CopySingleNode(Node* original, Node* left, Node* right, NodeBlock* block)
+{
     ValueOfTreeElement data = {};
     Node* new_node = NULL;
 
@@ -296,37 +364,89 @@ Node* CopyNode(Node* original)
     {
         case NODE_NUM:
             data.num_value = original->data.num_value;
-            new_node = NUM(data.num_value);
+            new_node = CreateCopyNode(block, NODE_NUM, data, NULL, NULL);
             break;
 
         case NODE_VAR:
-            new_node = CreateVariableNode(original->data.var_definition.name ?
-                                          original->data.var_definition.name : "?");
+            data.var_definition.name = strdup(original->data.var_definition.name ?
+                                              original->data.var_definition.name : "?");
+            if (!data.var_definition.name)
+                break;
+
+            new_node = CreateCopyNode(block, NODE_VAR, data, NULL, NULL);
+            if (new_node == NULL)
+                free(data.var_definition.name);
             break;
 
         case NODE_OP:
             data.op_value = original->data.op_value;
-            if (original->data.op_value == OP_SIN || original->data.op_value == OP_COS ||
-                original->data.op_value == OP_LN || original->data.op_value == OP_EXP)
+            if (is_unary(original->data.op_value))
             {
-                new_node = CreateNode(NODE_OP, data, NULL, CopyNode(original->right));
-            }
-            else
-            {
-                new_node = CreateNode(NODE_OP, data, CopyNode(original->left), CopyNode(original->right));
+                FreeSubtree(left);
+                left = NULL;
             }
+            new_node = CreateCopyNode(block, NODE_OP, data, left, right);
             break;
 
         default:
-            return NULL;
+            break;
     }
 
-    if (new_node != NULL)
-        new_node->priority = original->priority;
+    if (new_node == NULL)
+    {
+        FreeSubtree(left);
+        FreeSubtree(right);
+        return NULL;
+    }
+
+    new_node->priority = original->priority;
+    CopyTexCache(new_node, original);
 
     return new_node;
 }
 
+Node* CopyNode(Node* original)
+{
+    if (original == NULL)
+        return NULL;
+
+    TreeTraversal traversal = {};
+    if (BeginTreeTraversal(&traversal, original) != TREE_ERROR_NO)
+        return NULL;
+
+    // копия лежит подряд в одном блоке вместо subtree_size отдельных выделений;
+    // без блока узлы выделяются по одному
+    NodeBlock* block = (original->subtree_size > 1) ? CreateNodeBlock(original->subtree_size) : NULL;
+
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        if (frame->event != TRAVERSAL_LEAVE)
+            continue;
+
+        Node* copy = CopySingleNode(frame->node, frame->left_result.node, frame->right_result.node, block);
+        frame->left_result.node  = NULL;
+        frame->right_result.node = NULL;
+
+        if (copy == NULL)
+        {
+            traversal.error = TREE_ERROR_ALLOCATION;
+            break;
+        }
+
+        TraversalResultSlot(&traversal)->node = copy;
+    }
+
+    if (traversal.error != TREE_ERROR_NO)
+        FreeTraversalResults(&traversal);
+
+    ReleaseNodeBlock(block);
+
+    Node* result = traversal.result.node;
+    EndTreeTraversal(&traversal);
+    return result;
+}
+
 static bool ContainsVariable(Node* node, const char* variable_name)
 {
     if (node == NULL)
@@ -334,29 +454,35 @@ static bool ContainsVariable(Node* node, const char* variable_name)
 
     unsigned int target_hash = ComputeHash(variable_name);
 
-    switch (node->type)
-    {
-        case NODE_VAR:
-            return (node->data.var_definition.hash == target_hash) &&
-                   (node->data.var_definition.name != NULL)        &&
-                   (strcmp(node->data.var_definition.name, variable_name) == 0);
-
-        case NODE_OP:
-            return ContainsVariable(node->left, variable_name) ||
-                   ContainsVariable(node->right, variable_name);
+    TreeTraversal traversal = {};
+    if (BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
+        return false;
 
-        case NODE_NUM:
-        default:
-            return false;
+    bool is_found = false;
+    Node* current = NULL;
+    while (!is_found && (current = NextPreOrderNode(&traversal)) != NULL)
+    {
+        is_found = current->type == NODE_VAR                              &&
+                   current->data.var_definition.hash == target_hash       &&
+                   current->data.var_definition.name != NULL              &&
+                   strcmp(current->data.var_definition.name, variable_name) == 0;
     }
+
+    EndTreeTraversal(&traversal);
+    return is_found;
 }
 
 // ==================== ДИФФЕРЕНЦИРОВАНИЕ ЧЕРЕЗ DSL ====================
 
-static Node* DifferentiateNode(Node* node, const char* variable_name)
+// производная одного узла по уже готовым производным детей; d_left и d_right
+// забираются: неиспользованные освобождаются
+static Node* DifferentiateSingleNode(Node* node, Node* d_left, Node* d_right, const char* variable_name)
 {
-    if (node == NULL)
-        return NULL;
+    if (node->type == NODE_OP && !is_binary(node->data.op_value))
+    {
+        FreeSubtree(d_left);
+        d_left = NULL;
+    }
 
     switch (node->type)
     {
@@ -378,44 +504,48 @@ static Node* DifferentiateNode(Node* node, const char* variable_name)
             switch (node->data.op_value)
             {
                 case OP_ADD:
-                    return ADD(DIFF(node->left, variable_name),
-                              DIFF(node->right, variable_name));
+                    return ADD(d_left, d_right);
 
                 case OP_SUB:
-                    return SUB(DIFF(node->left, variable_name),
-                              DIFF(node->right, variable_name));
+                    return SUB(d_left, d_right);
 
                 case OP_MUL:
                     return ADD(MUL(COPY(node->left),
-                                   DIFF(node->right, variable_name)),
+                                   d_right),
                                MUL(COPY(node->right),
-                                   DIFF(node->left, variable_name)));
+                                   d_left));
 
                 case OP_DIV:
                     return DIV(SUB(MUL(COPY(node->right),
-                                        DIFF(node->left, variable_name)),
+                                        d_left),
                                    MUL(COPY(node->left),
-                                        DIFF(node->right, variable_name))),
+                                        d_right)),
                                MUL(COPY(node->right),
                                    COPY(node->right)));
 
                 case OP_SIN:
                     return MUL(COS(COPY(node->right)),
-                              DIFF(node->right, variable_name));
+                              d_right);
 
                 case OP_COS:
                     return MUL(MUL(NUM(-1.0),
                                    SIN(COPY(node->right))),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_LN:
                     return MUL(DIV(NUM(1.0),
                                    COPY(node->right)),
-                              DIFF(node->right, variable_name));
+                              d_right);
 
                 case OP_EXP:
                     return MUL(EXP(COPY(node->right)),
-                              DIFF(node->right, variable_name));
+                              d_right);
+
+                case OP_SQRT:
+                    return MUL(DIV(NUM(1.0),
+                                   MUL(NUM(2.0),
+                                       SQRT(COPY(node->right)))),
+                               d_right);
 
                 case OP_POW:
                 {
@@ -424,28 +554,32 @@ static Node* DifferentiateNode(Node* node, const char* variable_name)
 
                     if (left_has_var && !right_has_var)
                     {
-                        // x^a -> a * x^(a-1) * dx
+                        // x^a -> a * x^(a-1) * dx; показатель-выражение уменьшается узлом вычитания
+                        FreeSubtree(d_right);
+                        Node* reduced = IsNodeType(node->right, NODE_NUM) ?
+                                        NUM(node->right->data.num_value - 1.0) :
+                                        SUB(COPY(node->right), NUM(1.0));
                         return MUL(MUL(COPY(node->right),
-                                       POW(COPY(node->left),
-                                           NUM(node->right->data.num_value - 1.0))),
-                                  DIFF(node->left, variable_name));
+                                       POW(COPY(node->left), reduced)),
+                                  d_left);
                     }
                     else if (!left_has_var && right_has_var)
                     {
                         // a^x -> a^x * ln(a) * dx
+                        FreeSubtree(d_left);
                         return MUL(MUL(POW(COPY(node->left), COPY(node->right)),
                                        LN(COPY(node->left))),
-                                  DIFF(node->right, variable_name));
+                                  d_right);
                     }
                     else
                     {
                         // x^g(x) -> x^g(x) * (g'(x)*ln(x) + g(x)/x * dx)
                         Node* u_pow_v = POW(COPY(node->left), COPY(node->right));
-                        Node* bracket = ADD(MUL(DIFF(node->right, variable_name),
+                        Node* bracket = ADD(MUL(d_right,
                                                LN(COPY(node->left))),
                                            MUL(DIV(COPY(node->right),
                                                    COPY(node->left)),
-                                               DIFF(node->left, variable_name)));
+                                               d_left));
                         return MUL(u_pow_v, bracket);
                     }
                 }
@@ -453,21 +587,21 @@ static Node* DifferentiateNode(Node* node, const char* variable_name)
                     return MUL(DIV(NUM(1.0),
                                    MUL(COS(COPY(node->right)),
                                        COS(COPY(node->right)))),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_COT:
                     return MUL(NUM(-1.0),
                                MUL(DIV(NUM(1.0),
                                        MUL(SIN(COPY(node->right)),
                                            SIN(COPY(node->right)))),
-                                   DIFF(node->right, variable_name)));
+                                   d_right));
 
                 case OP_ARCSIN:
                     return MUL(DIV(NUM(1.0),
                                    SQRT(SUB(NUM(1.0),
                                             MUL(COPY(node->right),
                                                 COPY(node->right))))),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_ARCCOS:
                     return MUL(NUM(-1.0),
@@ -475,14 +609,14 @@ static Node* DifferentiateNode(Node* node, const char* variable_name)
                                        SQRT(SUB(NUM(1.0),
                                                 MUL(COPY(node->right),
                                                     COPY(node->right))))),
-                                   DIFF(node->right, variable_name)));
+                                   d_right));
 
                 case OP_ARCTAN:
                     return MUL(DIV(NUM(1.0),
                                    ADD(NUM(1.0),
                                        MUL(COPY(node->right),
                                            COPY(node->right)))),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_ARCCOT:
                     return MUL(NUM(-1.0),
@@ -490,36 +624,77 @@ static Node* DifferentiateNode(Node* node, const char* variable_name)
                                        ADD(NUM(1.0),
                                            MUL(COPY(node->right),
                                                COPY(node->right)))),
-                                   DIFF(node->right, variable_name)));
+                                   d_right));
 
                 case OP_SINH:
                     return MUL(COSH(COPY(node->right)),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_COSH:
                     return MUL(SINH(COPY(node->right)),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_TANH:
                     return MUL(SUB(NUM(1.0),
                                    MUL(TANH(COPY(node->right)),
                                        TANH(COPY(node->right)))),
-                               DIFF(node->right, variable_name));
+                               d_right);
 
                 case OP_COTH:
                     return MUL(SUB(NUM(1.0),
                                    MUL(COTH(COPY(node->right)),
                                        COTH(COPY(node->right)))),
-                               DIFF(node->right, variable_name));
-                                default:
-                                    return NUM(0.0);
+                               d_right);
+
+                default:
+                    FREE_NODES(2, d_left, d_right);
+                    return NUM(0.0);
             }
 
         default:
+            FREE_NODES(2, d_left, d_right);
             return NUM(0.0);
     }
 }
 
+// производные детей копятся в кадрах обхода, поэтому глубина дерева не ограничена стеком вызовов
+static Node* DifferentiateNode(Node* node, const char* variable_name)
+{
+    if (node == NULL)
+        return NULL;
+
+    TreeTraversal traversal = {};
+    if (BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
+        return NULL;
+
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        if (frame->event != TRAVERSAL_LEAVE)
+            continue;
+
+        Node* derivative = DifferentiateSingleNode(frame->node, frame->left_result.node, frame->right_result.node,
+                                                   variable_name);
+        frame->left_result.node  = NULL;
+        frame->right_result.node = NULL;
+
+        if (derivative == NULL)
+        {
+            traversal.error = TREE_ERROR_ALLOCATION;
+            break;
+        }
+
+        TraversalResultSlot(&traversal)->node = derivative;
+    }
+
+    if (traversal.error != TREE_ERROR_NO)
+        FreeTraversalResults(&traversal);
+
+    Node* result = traversal.result.node;
+    EndTreeTraversal(&traversal);
+    return result;
+}
+
 TreeErrorType DifferentiateTree(Tree* tree, const char* variable_name, Tree* result_tree)
 {
     if (tree == NULL || variable_name == NULL || result_tree == NULL)
@@ -532,13 +707,12 @@ TreeErrorType DifferentiateTree(Tree* tree, const char* variable_name, Tree* res
     if (derivative_root == NULL)
         return TREE_ERROR_ALLOCATION;
 
-    result_tree->root = derivative_root;
-    result_tree->size = CountTreeNodes(derivative_root);
+    SetTreeRoot(result_tree, derivative_root);
 
     return TREE_ERROR_NO;
 }
 
-static void ReplaceNode(Node** node_ptr, Node* new_node)
+static void ReplaceNode(Tree* tree, Node** node_ptr, Node* new_node)
 {
     if (node_ptr == NULL || *node_ptr == NULL)
         return;
@@ -549,169 +723,178 @@ static void ReplaceNode(Node** node_ptr, Node* new_node)
     if (new_node != NULL)
         new_node->parent = old_node->parent;
 
+    size_t old_size = old_node->subtree_size;
+    size_t new_size = (new_node != NULL) ? new_node->subtree_size : 0;
+
+    // отрисовки и размеры предков включают старое поддерево, даже если оно удалено без замены
+    for (Node* ancestor = old_node->parent; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        ClearTexCache(ancestor);
+        ancestor->subtree_size = ancestor->subtree_size - old_size + new_size;
+    }
+
+    // размеры поддеревьев хранятся в узлах, поэтому ни одно из них не обходится; линеаризация
+    // ссылается на освобождаемые узлы и строится заново при следующем EvaluateTree
+    if (tree != NULL)
+        tree->size = tree->size - old_size + new_size;
+
+    InvalidateTreePostOrder(tree);
     FreeSubtree(old_node);
 }
 
 // ==================== ФУНКЦИИ ОПТИМИЗАЦИИ С ДАМПОМ ====================
 
-static TreeErrorType ConstantFoldingOptimizationWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table)
+// свертка узла, все аргументы которого - числа; ошибки области определения и
+// нечисловые результаты оставляют узел как есть
+static bool TryFoldConstantNode(Node* node, double* result)
 {
-    if (node == NULL || *node == NULL)
-        return TREE_ERROR_NULL_PTR;
-
-    TreeErrorType error = TREE_ERROR_NO;
+    if (node == NULL || node->type != NODE_OP)
+        return false;
 
-    if ((*node)->left != NULL)
+    double left_val = 0.0;
+    if (is_binary(node->data.op_value))
     {
-        error = ConstantFoldingOptimizationWithDump(&(*node)->left, tex_file, tree, var_table);
-        if (error != TREE_ERROR_NO)
-            return error;
+        if (!IsNodeType(node->left, NODE_NUM))
+            return false;
+        left_val = node->left->data.num_value;
     }
 
-    if ((*node)->right != NULL)
+    if (!IsNodeType(node->right, NODE_NUM))
+        return false;
+
+    if (ApplyOperation(node->data.op_value, left_val, node->right->data.num_value, result) != TREE_ERROR_NO)
+        return false;
+
+    return isfinite(*result);
+}
+
+// предлагает замену узла, NULL - замены нет
+typedef Node* (*RewriteBuilder)(Node* node, const char** description);
+
+// шаг прохода над одним узлом; builder нужен только понижению стоимости
+typedef TreeErrorType (*NodeOptimizer)(Node** node, RewriteBuilder build_rewrite, FILE* tex_file,
+                                       Tree* tree, VariableTable* var_table);
+
+// ячейка, в которой лежит текущий узел обхода: у корня - root, иначе поле родителя
+static Node** TraversalNodeSlot(TreeTraversal* traversal, Node** root)
+{
+    if (traversal->depth < 2)
+        return root;
+
+    Node* parent = traversal->frames[traversal->depth - 2].node;
+    Node* node   = traversal->frames[traversal->depth - 1].node;
+
+    return (parent->left == node) ? &parent->left : &parent->right;
+}
+
+// проход снизу вверх с явным стеком; узел можно заменить на его LEAVE: кадр
+// замененного узла снимается следующим шагом, а родитель читает ребенка заново
+static TreeErrorType OptimizePostOrderWithDump(Node** root, NodeOptimizer optimize_node, RewriteBuilder build_rewrite,
+                                               FILE* tex_file, Tree* tree, VariableTable* var_table)
+{
+    if (root == NULL || *root == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, *root);
+
+    TraversalFrame* frame = NULL;
+    while (error == TREE_ERROR_NO && (frame = NextTraversalFrame(&traversal)) != NULL)
     {
-        error = ConstantFoldingOptimizationWithDump(&(*node)->right, tex_file, tree, var_table);
-        if (error != TREE_ERROR_NO)
-            return error;
+        if (frame->event == TRAVERSAL_LEAVE)
+            error = optimize_node(TraversalNodeSlot(&traversal, root), build_rewrite, tex_file, tree, var_table);
     }
 
-    if ((*node)->type == NODE_OP)
-    {
-    // FIXME - dsl
-        if (is_unary((*node)->data.op_value) && IsNodeType((*node)->right, NODE_NUM))
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+    return error;
+}
+
+static TreeErrorType FoldConstantNodeWithDump(Node** node, RewriteBuilder, FILE* tex_file,
+                                              Tree* tree, VariableTable* var_table)
+{
+    double result = 0.0;
+    if (TryFoldConstantNode(*node, &result))
+    {
+        Node* new_node = NUM(result);
+        if (new_node != NULL)
         {
-            double result = 0.0;
-            bool can_fold = true;
+            ReplaceNode(tree, node, new_node);
 
-            switch ((*node)->data.op_value)
+            double new_result = 0.0;
+            if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
             {
-                case OP_SIN:
-                    result = sin((*node)->right->data.num_value);
-                    break;
-                case OP_COS:
-                    result = cos((*node)->right->data.num_value);
-                    break;
-                case OP_TAN:
-                    result = tan((*node)->right->data.num_value);
-                    break;
-                case OP_COT:
-                    if (is_zero(tan((*node)->right->data.num_value)))
-                        can_fold = false;
-                    else
-                        result = 1.0 / tan((*node)->right->data.num_value);
-                    break;
-                case OP_ARCSIN:
-                    if ((*node)->right->data.num_value < -1.0 || (*node)->right->data.num_value > 1.0)
-                        can_fold = false;
-                    else
-                        result = asin((*node)->right->data.num_value);
-                    break;
-                case OP_ARCCOS:
-                    if ((*node)->right->data.num_value < -1.0 || (*node)->right->data.num_value > 1.0)
-                        can_fold = false;
-                    else
-                        result = acos((*node)->right->data.num_value);
-                    break;
-                case OP_ARCTAN:
-                    result = atan((*node)->right->data.num_value);
-                    break;
-                case OP_ARCCOT:
-                    result = M_PI/2.0 - atan((*node)->right->data.num_value);
-                    break;
-                case OP_SINH:
-                    result = sinh((*node)->right->data.num_value);
-                    break;
-                case OP_COSH:
-                    result = cosh((*node)->right->data.num_value);
-                    break;
-                case OP_TANH:
-                    result = tanh((*node)->right->data.num_value);
-                    break;
-                case OP_COTH:
-                    if (is_zero(tanh((*node)->right->data.num_value)))
-                        can_fold = false;
-                    else
-                        result = 1.0 / tanh((*node)->right->data.num_value);
-                    break;
-                case OP_LN:
-                    if ((*node)->right->data.num_value <= 0)
-                        can_fold = false;
-                    else
-                        result = log((*node)->right->data.num_value);
-                    break;
-                case OP_EXP:
-                    result = exp((*node)->right->data.num_value);
-                    break;
-                default:
-                    can_fold = false;
-                    break;
+                char description[kMaxTexDescriptionLength] = {0};
+                snprintf(description, sizeof(description),
+                        "constant folding simplified part of expression to: %.2f", result);
+                DumpOptimizationStepToFile(tex_file, description, tree, new_result);
             }
+        }
+    }
 
-            if (can_fold)
-            {
-                Node* new_node = NUM(result);
-                if (new_node != NULL)
-                {
-                    ReplaceNode(node, new_node);
+    return TREE_ERROR_NO;
+}
 
-                    double new_result = 0.0;
-                    if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
-                    {
-                        char description[kMaxTexDescriptionLength] = {0};
-                        snprintf(description, sizeof(description),
-                                "constant folding simplified part of expression to: %.2f", result);
-                        DumpOptimizationStepToFile(tex_file, description, tree, new_result);
-                    }
-                }
-            }
-        }
-        // FIXME - dsl
-        else if (IsNodeType((*node)->left, NODE_NUM) && IsNodeType((*node)->right, NODE_NUM))
-        {
-            double left_val  = (*node)->left->data.num_value;
-            double right_val = (*node)->right->data.num_value;
-            double result = 0.0;
-            bool can_fold = true;
+static TreeErrorType ConstantFoldingOptimizationWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table)
+{
+    return OptimizePostOrderWithDump(node, FoldConstantNodeWithDump, NULL, tex_file, tree, var_table);
+}
 
-            switch ((*node)->data.op_value)
-            {
-                case OP_ADD:
-                    result = left_val + right_val;
-                    break;
-                case OP_SUB:
-                    result = left_val - right_val;
-                    break;
-                case OP_MUL:
-                    result = left_val * right_val;
-                    break;
-                case OP_DIV:
-                    if (is_zero(right_val))
-                        can_fold = false;
-                    else
-                        result = left_val / right_val;
-                    break;
-                default:
-                    can_fold = false;
-                    break;
-            }
+// нейтральные и поглощающие элементы; правила проверяются по порядку, первое подошедшее применяется
+static const char* const neutral_element_rules[] = {
+    "add(?x, 0) -> ?x                 # adding zero simplified",
+    "add(0, ?x) -> ?x                 # adding zero simplified",
+    "sub(?x, 0) -> ?x                 # - 0 simplified",
+    "mul(0, ?x) -> 0                  # mul zero simplified",
+    "mul(?x, 0) -> 0                  # mul zero simplified",
+    "mul(?x, 1) -> ?x                 # mul one simplified",
+    "mul(1, ?x) -> ?x                 # mul one simplified",
+    "mul(-1, mul(-1, ?x)) -> ?x       # double minus simplified",
+    "mul(-1, mul(?x, -1)) -> ?x       # double minus simplified",
+    "mul(-1, -1) -> 1                 # minus times minus simplified",
+    "mul(mul(-1, ?x), -1) -> ?x       # double minus simplified",
+    "mul(mul(?x, -1), -1) -> ?x       # double minus simplified",
+    "div(0, ?x) -> 0 where nonzero(?x) # 0 / simplified",
+    "div(?x, 1) -> ?x                 #  / 1 simplified",
+    "pow(?x, 0) -> 1                  # ^0 simplified",
+    "pow(?x, 1) -> ?x                 # ^1 simplified",
+    "pow(1, ?x) -> 1                  # 1^ simplified"
+};
+
+// компилируется один раз; инициализация статической переменной потокобезопасна
+static const RewriteRuleSet* GetNeutralElementRules()
+{
+    static RewriteRuleSet rules = {};
+    static const bool is_compiled =
+        CompileRewriteRules(neutral_element_rules, sizeof(neutral_element_rules) / sizeof(neutral_element_rules[0]),
+                            &rules) == TREE_ERROR_NO;
 
-            if (can_fold)
-            {
-                Node* new_node = NUM(result);
-                if (new_node != NULL)
-                {
-                    ReplaceNode(node, new_node);
+    return is_compiled ? &rules : NULL;
+}
 
-                    double new_result = 0.0;
-                    if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
-                    {
-                        char description[kMaxTexDescriptionLength] = {0};
-                        snprintf(description, sizeof(description),
-                                "constant folding simplified part of expression to: %.2f", result);
-                        DumpOptimizationStepToFile(tex_file, description, tree, new_result);
-                    }
-                }
-            }
+static TreeErrorType ApplyNeutralElementsWithDump(Node** node, RewriteBuilder, FILE* tex_file,
+                                                  Tree* tree, VariableTable* var_table)
+{
+    if ((*node)->type != NODE_OP)
+        return TREE_ERROR_NO;
+
+    const RewriteRuleSet* rules = GetNeutralElementRules();
+    if (rules == NULL)
+        return TREE_ERROR_FORMAT;
+
+    const char* description = NULL;
+    Node* new_node = RewriteByRules(rules, *node, &description);
+
+    if (new_node != NULL)
+    {
+        ReplaceNode(tree, node, new_node);
+
+        double new_result = 0.0;
+        if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
+        {
+            DumpOptimizationStepToFile(tex_file, description, tree, new_result);
         }
     }
 
@@ -719,198 +902,353 @@ static TreeErrorType ConstantFoldingOptimizationWithDump(Node** node, FILE* tex_
 }
 
 static TreeErrorType NeutralElementsOptimizationWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table)
+{
+    return OptimizePostOrderWithDump(node, ApplyNeutralElementsWithDump, NULL, tex_file, tree, var_table);
+}
+
+// дерево целиком пересобирается в канонической форме; результат принимается,
+// только если в нем строго меньше узлов
+static TreeErrorType CanonicalFormOptimizationWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table)
 {
     if (node == NULL || *node == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    TreeErrorType error = TREE_ERROR_NO;
+    Node* canonical = BuildCanonicalForm(*node);
+    if (canonical == NULL)
+        return TREE_ERROR_ALLOCATION;
 
-    if ((*node)->left != NULL)
+    // перестановка операндов без сокращения не шаг оптимизации
+    if (CountTreeNodes(canonical) >= CountTreeNodes(*node))
     {
-        error = NeutralElementsOptimizationWithDump(&(*node)->left, tex_file, tree, var_table);
-        if (error != TREE_ERROR_NO)
-            return error;
+        FreeSubtree(canonical);
+        return TREE_ERROR_NO;
     }
 
-    if ((*node)->right != NULL)
+    ReplaceNode(tree, node, canonical);
+
+    double new_result = 0.0;
+    if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
     {
-        error = NeutralElementsOptimizationWithDump(&(*node)->right, tex_file, tree, var_table);
-        if (error != TREE_ERROR_NO)
-            return error;
+        DumpOptimizationStepToFile(tex_file, "like terms and equal factors collected", tree, new_result);
+    }
+
+    return TREE_ERROR_NO;
+}
+
+// насыщение равенств находит упрощения, недоступные проходам в фиксированном
+// порядке; результат принимается, только если он дешевле по модели стоимости
+static TreeErrorType SaturationOptimizationWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table)
+{
+    if (node == NULL || *node == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    Node* simplified = NULL;
+    SaturationStats stats = {};
+    TreeErrorType error = SimplifyBySaturation(*node, &simplified, &stats);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    if (EstimateTreeCost(simplified) >= EstimateTreeCost(*node))
+    {
+        FreeSubtree(simplified);
+        return TREE_ERROR_NO;
+    }
+
+    ReplaceNode(tree, node, simplified);
+
+    double new_result = 0.0;
+    if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
+    {
+        char description[kMaxTexDescriptionLength] = {};
+        snprintf(description, sizeof(description), "equality saturation (%zu e-nodes, %d iterations%s)",
+                 stats.n_enodes, stats.n_iterations, stats.is_saturated ? "" : ", stopped by limit");
+        DumpOptimizationStepToFile(tex_file, description, tree, new_result);
     }
 
-    if ((*node)->type == NODE_OP)
+    return TREE_ERROR_NO;
+}
+
+// многочлен от одной переменной по схеме Горнера: 5*x^2 + 3*x + 1 -> x*(x*5 + 3) + 1
+static Node* BuildHornerRewrite(Node* node, const char** description)
+{
+    switch (node->data.op_value)
     {
-        Node* new_node = NULL;
-        const char* description = NULL;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_POW:
+            break;
+
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_LN:     case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            return NULL;
+    }
+
+    Polynomial polynomial = {};
+    if (!ExtractPolynomial(node, &polynomial) || polynomial.variable == NULL ||
+        polynomial.degree < 2 || CountPolynomialTerms(&polynomial) < 2)
+        return NULL;
 
-        switch ((*node)->data.op_value)
+    Node* horner = BuildHornerForm(&polynomial);
+    if (horner != NULL && CompareCanonicalNodes(horner, node) == 0)
+    {
+        FreeSubtree(horner);
+        return NULL;
+    }
+
+    *description = "polynomial rewritten in Horner form";
+    return horner;
+}
+
+// понижение силы операций: дробные степени и деление на константу;
+// целые степени остаются в дереве, их возведением в квадрат считает INSTR_POWI
+static Node* BuildStrengthReducedForm(Node* node, const char** description)
+{
+    switch (node->data.op_value)
+    {
+        case OP_POW:
         {
-        // FIXME - dsl
-            case OP_ADD:
-                if (IsNodeType((*node)->right, NODE_NUM) &&
-                    is_zero((*node)->right->data.num_value))
-                {
-                    new_node = CopyNode((*node)->left);
-                    description = "adding zero simplified";
-                }
-                else if (IsNodeType((*node)->left, NODE_NUM) &&
-                         is_zero((*node)->left->data.num_value))
-                {
-                    new_node = CopyNode((*node)->right);
-                    description = "adding zero simplified";
-                }
+            if (!IsNodeType(node->right, NODE_NUM))
                 break;
 
-            case OP_SUB:
-                if (IsNodeType((*node)->right, NODE_NUM) &&
-                    is_zero((*node)->right->data.num_value))
-                {
-                    new_node = CopyNode((*node)->left);
-                    description = "- 0 simplified";
-                }
-                break;
+            double exponent = node->right->data.num_value;
 
-            case OP_MUL:
-                if ((IsNodeType((*node)->left, NODE_NUM) &&
-                     is_zero((*node)->left->data.num_value)) ||
-                    (IsNodeType((*node)->right, NODE_NUM) &&
-                     is_zero((*node)->right->data.num_value)))
-                {
-                    new_node = NUM(0.0);
-                    description = "mul zero simplified";
-                }
-                else if (IsNodeType((*node)->right, NODE_NUM) &&
-                         is_one((*node)->right->data.num_value))
-                {
-                    new_node = CopyNode((*node)->left);
-                    description = "mul one simplified";
-                }
-                else if (IsNodeType((*node)->left, NODE_NUM) &&
-                         is_one((*node)->left->data.num_value))
-                {
-                    new_node = CopyNode((*node)->right);
-                    description = "mul one simplified";
-                }
-                else if (IsNodeType((*node)->left, NODE_NUM) &&
-                         is_minus_one((*node)->left->data.num_value))
-                {
-                    if (IsNodeType((*node)->right, NODE_OP) &&
-                        (*node)->right->data.op_value == OP_MUL)
-                    {
-                        Node* right_node = (*node)->right;
-                        if (IsNodeType(right_node->left, NODE_NUM) &&
-                            is_minus_one(right_node->left->data.num_value))
-                        {
-                            new_node = CopyNode(right_node->right);
-                            description = "double minus simplified";
-                        }
-                        else if (IsNodeType(right_node->right, NODE_NUM) &&
-                                 is_minus_one(right_node->right->data.num_value))
-                        {
-                            new_node = CopyNode(right_node->left);
-                            description = "double minus simplified";
-                        }
-                    }
-                    else if (IsNodeType((*node)->right, NODE_NUM) &&
-                             is_minus_one((*node)->right->data.num_value))
-                    {
-                        new_node = NUM(1.0);
-                        description = "minus times minus simplified";
-                    }
-                }
-                else if ((*node)->right != NULL && (*node)->right->type == NODE_NUM &&
-                         is_minus_one((*node)->right->data.num_value))
-                {
-                    if (IsNodeType((*node)->left, NODE_OP) &&
-                        (*node)->left->data.op_value == OP_MUL)
-                    {
-                        Node* left_node = (*node)->left;
-                        if (IsNodeType(left_node, NODE_NUM) &&
-                            is_minus_one(left_node->left->data.num_value))
-                        {
-                            new_node = CopyNode(left_node->right);
-                            description = "double minus simplified";
-                        }
-                        else if (IsNodeType(left_node->right, NODE_NUM) &&
-                                 is_minus_one(left_node->right->data.num_value))
-                        {
-                            new_node = CopyNode(left_node->left);
-                            description = "double minus simplified";
-                        }
-                    }
-                }
-                break;
-            case OP_DIV:
-                if (IsNodeType((*node)->left, NODE_NUM)&&
-                    is_zero((*node)->left->data.num_value) &&
-                    (*node)->right != NULL &&
-                    !((*node)->right->type == NODE_NUM && is_zero((*node)->right->data.num_value)))
-                {
-                    new_node = NUM(0.0);
-                    description = "0 / simplified";
-                }
-                else if (IsNodeType((*node)->right, NODE_NUM) &&
-                         is_one((*node)->right->data.num_value))
-                {
-                    new_node = CopyNode((*node)->left);
-                    description = " / 1 simplified";
-                }
+            if (is_zero(exponent - 0.5))
+            {
+                *description = "x^0.5 replaced by sqrt(x)";
+                return SQRT(COPY(node->left));
+            }
+            if (is_zero(exponent + 0.5))
+            {
+                *description = "x^(-0.5) replaced by 1/sqrt(x)";
+                return DIV(NUM(1.0), SQRT(COPY(node->left)));
+            }
+            if (is_minus_one(exponent))
+            {
+                *description = "x^(-1) replaced by 1/x";
+                return DIV(NUM(1.0), COPY(node->left));
+            }
+            break;
+        }
+
+        case OP_DIV:
+        {
+            if (!IsNodeType(node->right, NODE_NUM) || is_zero(node->right->data.num_value))
                 break;
-            case OP_POW:
-                if (IsNodeType((*node)->right, NODE_NUM) &&
-                    is_zero((*node)->right->data.num_value))
-                {
-                    new_node = NUM(1.0);
-                    description = "^0 simplified";
-                }
-                else if (IsNodeType((*node)->right, NODE_NUM) &&
-                         is_one((*node)->right->data.num_value))
-                {
-                    new_node = CopyNode((*node)->left);
-                    description = "^1 simplified";
-                }
-                else if (IsNodeType((*node)->left, NODE_NUM) &&
-                         is_one((*node)->left->data.num_value))
-                {
-                    new_node = NUM(1.0);
-                    description = "1^ simplified";
-                }
+
+            // 1/c точно представимо только для степеней двойки, иначе x*(1/c) != x/c
+            int    binary_exponent = 0;
+            double mantissa        = frexp(node->right->data.num_value, &binary_exponent);
+            if (!is_zero(fabs(mantissa) - 0.5))
                 break;
-            default:
+
+            double reciprocal = 1.0 / node->right->data.num_value;
+            if (!isfinite(reciprocal))
                 break;
+
+            *description = "division by constant replaced by multiplication";
+            return MUL(COPY(node->left), NUM(reciprocal));
         }
 
-        if (new_node != NULL && description != NULL)
-        {
-            ReplaceNode(node, new_node);
+        case OP_ADD:    case OP_SUB:    case OP_MUL:
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_LN:     case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            break;
+    }
 
-            double new_result = 0.0;
-            if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
+    return NULL;
+}
+
+// более дешевая по таблице стоимостей запись узла
+static Node* BuildCheaperForm(Node* node, const char** description)
+{
+    switch (node->data.op_value)
+    {
+        case OP_DIV:
+            if (!IsNodeType(node->left, NODE_NUM) || !is_one(node->left->data.num_value) ||
+                !IsNodeType(node->right, NODE_OP))
+                break;
+
+            switch (node->right->data.op_value)
             {
-                DumpOptimizationStepToFile(tex_file, description, tree, new_result);
+                case OP_TAN:
+                    *description = "1/tan replaced by cot";
+                    return COT(COPY(node->right->right));
+                case OP_COT:
+                    *description = "1/cot replaced by tan";
+                    return TAN(COPY(node->right->right));
+                case OP_TANH:
+                    *description = "1/tanh replaced by coth";
+                    return COTH(COPY(node->right->right));
+                case OP_COTH:
+                    *description = "1/coth replaced by tanh";
+                    return TANH(COPY(node->right->right));
+
+                case OP_ADD:    case OP_SUB:    case OP_MUL:    case OP_DIV:    case OP_POW:
+                case OP_SIN:    case OP_COS:
+                case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+                case OP_SINH:   case OP_COSH:
+                case OP_LN:     case OP_EXP:    case OP_SQRT:
+                case OP_COUNT:
+                default:
+                    break;
             }
-        }
+            break;
+
+        case OP_LN:
+            if (IsNodeOp(node->right, OP_EXP))
+            {
+                *description = "ln(exp(x)) replaced by x";
+                return COPY(node->right->right);
+            }
+            break;
+
+        case OP_ADD:    case OP_SUB:    case OP_MUL:    case OP_POW:
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            break;
+    }
+
+    return NULL;
+}
+
+// переписывания, не уменьшающие число узлов, но удешевляющие вычисление;
+// замена принимается, только если оценка стоимости действительно падает
+static TreeErrorType ApplyCostLoweringWithDump(Node** node, RewriteBuilder build_rewrite, FILE* tex_file,
+                                               Tree* tree, VariableTable* var_table)
+{
+    if ((*node)->type != NODE_OP)
+        return TREE_ERROR_NO;
+
+    const char* description = NULL;
+    Node* new_node = build_rewrite(*node, &description);
+    if (new_node == NULL)
+        return TREE_ERROR_NO;
+
+    if (EstimateTreeCost(new_node) >= EstimateTreeCost(*node))
+    {
+        FreeSubtree(new_node);
+        return TREE_ERROR_NO;
+    }
+
+    ReplaceNode(tree, node, new_node);
+
+    double new_result = 0.0;
+    if (EvaluateTree(tree, var_table, &new_result) == TREE_ERROR_NO && tex_file != NULL)
+    {
+        DumpOptimizationStepToFile(tex_file, description, tree, new_result);
     }
 
     return TREE_ERROR_NO;
 }
 
+static TreeErrorType CostLoweringOptimizationWithDump(Node** node, RewriteBuilder build_rewrite, FILE* tex_file,
+                                                      Tree* tree, VariableTable* var_table)
+{
+    return OptimizePostOrderWithDump(node, ApplyCostLoweringWithDump, build_rewrite, tex_file, tree, var_table);
+}
+
+// схема Горнера применяется один раз к каждому наибольшему поддереву-сумме одночленов:
+// снизу вверх она свернула бы сначала часть суммы, и остаток уже не был бы многочленом
+static TreeErrorType HornerOptimizationWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table,
+                                                PolynomialShape* shape)
+{
+    if (node == NULL || *node == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    // форма узла передается родителю в index; нулевой результат - POLYNOMIAL_SHAPE_NONE
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, *node);
+
+    TraversalFrame* frame = NULL;
+    while (error == TREE_ERROR_NO && (frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        if (frame->event != TRAVERSAL_LEAVE)
+            continue;
+
+        Node* current = frame->node;
+        PolynomialShape left  = (PolynomialShape)frame->left_result.index;
+        PolynomialShape right = (PolynomialShape)frame->right_result.index;
+
+        PolynomialShape current_shape = PolynomialNodeShape(current, left, right);
+        TraversalResultSlot(&traversal)->index = (uint32_t)current_shape;
+
+        if (current_shape != POLYNOMIAL_SHAPE_NONE)
+            continue;
+
+        // дети уже пройдены, замена поддерева-ребенка не трогает стек обхода
+        if (left == POLYNOMIAL_SHAPE_SUM)
+            error = ApplyCostLoweringWithDump(&current->left, BuildHornerRewrite, tex_file, tree, var_table);
+
+        if (error == TREE_ERROR_NO && right == POLYNOMIAL_SHAPE_SUM)
+            error = ApplyCostLoweringWithDump(&current->right, BuildHornerRewrite, tex_file, tree, var_table);
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    *shape = (PolynomialShape)traversal.result.index;
+
+    EndTreeTraversal(&traversal);
+    return error;
+}
+
 size_t CountTreeNodes(Node* node)
 {
-    if (node == NULL)
+    TreeTraversal traversal = {};
+    if (node == NULL || BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
         return 0;
 
-    return 1 + CountTreeNodes(node->left) + CountTreeNodes(node->right);
+    size_t count = 0;
+    while (NextPreOrderNode(&traversal) != NULL)
+        count++;
+
+    EndTreeTraversal(&traversal);
+    return count;
+}
+
+// число узлов на самом длинном пути от node до листа
+size_t MeasureTreeDepth(Node* node)
+{
+    TreeTraversal traversal = {};
+    if (node == NULL || BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
+        return 0;
+
+    size_t depth = 0;
+    while (NextPreOrderNode(&traversal) != NULL)
+    {
+        if (traversal.depth > depth)
+            depth = traversal.depth;
+    }
+
+    EndTreeTraversal(&traversal);
+    return depth;
 }
 
-static TreeErrorType OptimizeSubtreeWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table)
+// is_deep: каноническая форма, выделение многочлена и e-граф рекурсивны и на таком
+// дереве переполнили бы стек вызовов, остальные проходы идут с явным стеком
+static TreeErrorType OptimizeSubtreeWithDump(Node** node, FILE* tex_file, Tree* tree, VariableTable* var_table,
+                                             OptimizationLevel level, bool is_deep)
 {
     if (node == NULL || *node == NULL)
         return TREE_ERROR_NULL_PTR;
 
+    // node - корень tree, а каждую замену делает ReplaceNode, поэтому размер известен
     size_t old_size = 0;
-    size_t new_size = CountTreeNodes(*node);
+    size_t new_size = tree->size;
     TreeErrorType error = TREE_ERROR_NO;
 
     do
@@ -923,13 +1261,43 @@ static TreeErrorType OptimizeSubtreeWithDump(Node** node, FILE* tex_file, Tree*
         error = NeutralElementsOptimizationWithDump(node, tex_file, tree, var_table);
         if (error != TREE_ERROR_NO) return error;
 
-        new_size = CountTreeNodes(*node);
+        if (!is_deep)
+        {
+            error = CanonicalFormOptimizationWithDump(node, tex_file, tree, var_table);
+            if (error != TREE_ERROR_NO) return error;
+        }
+
+        new_size = tree->size;
     } while (new_size != old_size);
 
-    return TREE_ERROR_NO;
+    if (level >= OPTIMIZATION_LEVEL_SATURATION && !is_deep)
+    {
+        error = SaturationOptimizationWithDump(node, tex_file, tree, var_table);
+        if (error != TREE_ERROR_NO) return error;
+    }
+
+    // после канонической формы подобные слагаемые уже собраны в коэффициенты многочлена
+    PolynomialShape shape = POLYNOMIAL_SHAPE_NONE;
+    if (!is_deep)
+    {
+        error = HornerOptimizationWithDump(node, tex_file, tree, var_table, &shape);
+        if (error != TREE_ERROR_NO) return error;
+    }
+
+    if (shape == POLYNOMIAL_SHAPE_SUM)
+    {
+        error = ApplyCostLoweringWithDump(node, BuildHornerRewrite, tex_file, tree, var_table);
+        if (error != TREE_ERROR_NO) return error;
+    }
+
+    error = CostLoweringOptimizationWithDump(node, BuildStrengthReducedForm, tex_file, tree, var_table);
+    if (error != TREE_ERROR_NO) return error;
+
+    return CostLoweringOptimizationWithDump(node, BuildCheaperForm, tex_file, tree, var_table);
 }
 
-TreeErrorType OptimizeTreeWithDump(Tree* tree, FILE* tex_file, VariableTable* var_table)
+TreeErrorType OptimizeTreeWithDump(Tree* tree, FILE* tex_file, VariableTable* var_table, OptimizationLevel level,
+                                   bool verify)
 {
     if (tree == NULL)
         return TREE_ERROR_NULL_PTR;
@@ -937,45 +1305,235 @@ TreeErrorType OptimizeTreeWithDump(Tree* tree, FILE* tex_file, VariableTable* va
     if (tree->root == NULL)
         return TREE_ERROR_NULL_PTR;
 
+    if (level == OPTIMIZATION_LEVEL_NONE)
+        return TREE_ERROR_NO;
+
+    bool is_deep = MeasureTreeDepth(tree->root) > kMaxRecursiveTreeDepth;
+    if (is_deep)
+    {
+        fprintf(stderr, "Warning: expression is deeper than %zu levels, canonical form, Horner scheme "
+                        "and saturation skipped\n", kMaxRecursiveTreeDepth);
+        if (tex_file != NULL)
+            fprintf(tex_file, "Canonical form, Horner scheme and saturation skipped: the expression is too deep.\n\n");
+    }
+
     double result_before = 0.0;
     EvaluateTree(tree, var_table, &result_before);
+    double cost_before = EstimateTreeCost(tree->root);
+
+    // отпечаток без точек определения ни с чем не совпадает и ничего не проверяет
+    TreeFingerprint fingerprint_before = {};
+    bool is_checkable = verify && ComputeTreeFingerprint(tree, var_table, &fingerprint_before) == TREE_ERROR_NO &&
+                        fingerprint_before.defined_count > 0;
+
+    StringBuilder expression = {};
+    InitStringBuilder(&expression);
 
     if (tex_file != NULL)
     {
         fprintf(tex_file, "\\section*{Optimization}\n");
         fprintf(tex_file, "Before optimization: ");
 
-        char expression[kMaxLengthOfTexExpression] = {0};
-        int pos = 0;
-        TreeToStringSimple(tree->root, expression, &pos, sizeof(expression));
-        fprintf(tex_file, "\\begin{dmath} %s \\end{dmath}\n\n", expression);
+        TreeToStringSimple(tree->root, &expression);
+        fprintf(tex_file, "\\begin{dmath} %s \\end{dmath}\n\n", GetStringBuilderData(&expression));
     }
 
-    TreeErrorType error = OptimizeSubtreeWithDump(&tree->root, tex_file, tree, var_table);
+    TreeErrorType error = OptimizeSubtreeWithDump(&tree->root, tex_file, tree, var_table, level, is_deep);
     if (error != TREE_ERROR_NO)
+    {
+        DestroyStringBuilder(&expression);
         return error;
-
-    tree->size = CountTreeNodes(tree->root);
+    }
 
     double result_after = 0.0;
     EvaluateTree(tree, var_table, &result_after);
 
+    TreeFingerprint fingerprint_after = {};
+    if (is_checkable && ComputeTreeFingerprint(tree, var_table, &fingerprint_after) == TREE_ERROR_NO &&
+        !FingerprintsProbablyEqual(&fingerprint_before, &fingerprint_after))
+    {
+        fprintf(stderr, "Warning: optimized expression differs from the original at random test points\n");
+        if (tex_file != NULL)
+            fprintf(tex_file, "Warning: the optimized expression differs from the original at random test points.\n\n");
+    }
+
     if (tex_file != NULL)
     {
         fprintf(tex_file, "\\subsection*{Result optimization}\n");
 
-        char expression[kMaxLengthOfTexExpression] = {0};
-        int pos = 0;
-
-        TreeToStringSimple(tree->root, expression, &pos, sizeof(expression));
-        fprintf(tex_file, "Final expression: \\begin{dmath} %s \\end{dmath}\n\n", expression);
+        ClearStringBuilder(&expression);
+        TreeToStringSimple(tree->root, &expression);
+        fprintf(tex_file, "Final expression: \\begin{dmath} %s \\end{dmath}\n\n", GetStringBuilderData(&expression));
         fprintf(tex_file, "Final result: \\begin{dmath} %.6f \\end{dmath}\n\n", result_after);
+        fprintf(tex_file, "Estimated evaluation cost: %.1f $\\to$ %.1f\n\n", cost_before,
+                EstimateTreeCost(tree->root));
         DumpVariableTableToFile(tex_file, var_table);
     }
 
+    DestroyStringBuilder(&expression);
+
     return TREE_ERROR_NO;
 }
 
+// ==================== ЧАСТИЧНОЕ ВЫЧИСЛЕНИЕ ====================
+
+static const VariableBinding* FindBinding(const VariableBinding* bindings, int n_bindings, const char* name)
+{
+    if (name == NULL)
+        return NULL;
+
+    for (int i = 0; i < n_bindings; i++)
+    {
+        if (bindings[i].name != NULL && strcmp(bindings[i].name, name) == 0)
+            return &bindings[i];
+    }
+
+    return NULL;
+}
+
+// копия одного узла над уже специализированными детьми; left и right забираются
+static Node* SpecializeSingleNode(Node* node, Node* left, Node* right, const VariableBinding* bindings,
+                                  int n_bindings)
+{
+    switch (node->type)
+    {
+        case NODE_NUM:
+            return NUM(node->data.num_value);
+
+        case NODE_VAR:
+        {
+            const VariableBinding* binding = FindBinding(bindings, n_bindings, node->data.var_definition.name);
+            if (binding != NULL)
+                return NUM(binding->value);
+
+            return CreateVariableNode(node->data.var_definition.name ? node->data.var_definition.name : "?");
+        }
+
+        case NODE_OP:
+        {
+            if (!is_binary(node->data.op_value))
+            {
+                FreeSubtree(left);
+                left = NULL;
+            }
+
+            if ((left == NULL && is_binary(node->data.op_value)) || right == NULL)
+            {
+                FreeSubtree(left);
+                FreeSubtree(right);
+                return NULL;
+            }
+
+            ValueOfTreeElement data = {};
+            data.op_value = node->data.op_value;
+            Node* new_node = CreateNode(NODE_OP, data, left, right);
+            if (new_node == NULL)
+            {
+                FreeSubtree(left);
+                FreeSubtree(right);
+                return NULL;
+            }
+
+            double result = 0.0;
+            if (TryFoldConstantNode(new_node, &result))
+            {
+                Node* folded = NUM(result);
+                if (folded != NULL)
+                {
+                    FreeSubtree(new_node);
+                    return folded;
+                }
+            }
+
+            return new_node;
+        }
+
+        default:
+            FreeSubtree(left);
+            FreeSubtree(right);
+            return NULL;
+    }
+}
+
+// копия поддерева, в которой связанные переменные заменены числами, а
+// получившиеся константные узлы сразу свернуты: один проход снизу вверх
+static Node* SpecializeNode(Node* node, const VariableBinding* bindings, int n_bindings)
+{
+    if (node == NULL)
+        return NULL;
+
+    TreeTraversal traversal = {};
+    if (BeginTreeTraversal(&traversal, node) != TREE_ERROR_NO)
+        return NULL;
+
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        if (frame->event != TRAVERSAL_LEAVE)
+            continue;
+
+        Node* specialized = SpecializeSingleNode(frame->node, frame->left_result.node, frame->right_result.node,
+                                                 bindings, n_bindings);
+        frame->left_result.node  = NULL;
+        frame->right_result.node = NULL;
+
+        if (specialized == NULL)
+        {
+            traversal.error = TREE_ERROR_ALLOCATION;
+            break;
+        }
+
+        TraversalResultSlot(&traversal)->node = specialized;
+    }
+
+    if (traversal.error != TREE_ERROR_NO)
+        FreeTraversalResults(&traversal);
+
+    Node* result = traversal.result.node;
+    EndTreeTraversal(&traversal);
+    return result;
+}
+
+TreeErrorType SpecializeTree(Tree* tree, const VariableBinding* bindings, int n_bindings, Tree* result)
+{
+    if (tree == NULL || result == NULL || (bindings == NULL && n_bindings > 0))
+        return TREE_ERROR_NULL_PTR;
+
+    if (tree->root == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    Node* root = SpecializeNode(tree->root, bindings, n_bindings);
+    if (root == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    SetTreeRoot(result, root);
+
+    return TREE_ERROR_NO;
+}
+
+int CollectVariableBindings(VariableTable* var_table, const char* free_variable, VariableBinding* bindings)
+{
+    if (var_table == NULL || bindings == NULL)
+        return 0;
+
+    int n_bindings = 0;
+    for (int i = 0; i < var_table->number_of_variables; i++)
+    {
+        Variable* variable = &var_table->variables[i];
+        if (!variable->is_defined)
+            continue;
+
+        if (free_variable != NULL && strcmp(variable->name, free_variable) == 0)
+            continue;
+
+        bindings[n_bindings].name  = variable->name;
+        bindings[n_bindings].value = variable->value;
+        n_bindings++;
+    }
+
+    return n_bindings;
+}
+
 // ==================== РАЗЛОЖЕНИЕ В РЯД ТЕЙЛОРА ====================
 
 
@@ -0,0 +1,327 @@
+#include "plot_sampling.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "tree_common.h"
+#include "interval_eval.h"
+
+typedef struct {
+    size_t left;        // индексы концов в массивах точек
+    size_t right;
+    double middle_x;
+    double middle_y;
+    double error;
+} SampleInterval;
+
+typedef struct {
+    const CompiledTree* function;
+    const CompiledTree* second_derivative;
+    double              values[kMaxNOfVariables];
+    Interval            boxes[kMaxNOfVariables];
+    int                 slot;
+    double              tolerance;      // ошибка, которую уже не видно на графике
+    double              unbounded_error; // приоритет интервалов с неопределенными точками
+    double              min_width;
+
+    double*             x;
+    double*             y;
+    size_t              count;
+
+    SampleInterval*     heap;           // max-куча по error
+    size_t              heap_size;
+} AdaptiveSampler;
+
+// ==================== ВЫЧИСЛЕНИЕ ====================
+
+static double EvaluateAt(AdaptiveSampler* sampler, const CompiledTree* program, double x)
+{
+    if (sampler->slot >= 0)
+        sampler->values[sampler->slot] = x;
+
+    double result = 0.0;
+    if (ExecuteCompiledTree(program, sampler->values, &result) != TREE_ERROR_NO || !isfinite(result))
+        return NAN;
+
+    return result;
+}
+
+static SampleInterval MakeInterval(AdaptiveSampler* sampler, size_t left, size_t right)
+{
+    SampleInterval interval = {};
+    interval.left  = left;
+    interval.right = right;
+
+    double x_left  = sampler->x[left],  y_left  = sampler->y[left];
+    double x_right = sampler->x[right], y_right = sampler->y[right];
+    double width   = x_right - x_left;
+
+    interval.middle_x = x_left + width / 2;
+    interval.middle_y = EvaluateAt(sampler, sampler->function, interval.middle_x);
+
+    if (width < sampler->min_width)
+    {
+        interval.error = 0.0;
+        return interval;
+    }
+
+    IntervalResult function_bound = {};
+    IntervalResult curvature_bound = {};
+    bool has_function_bound = false;
+    bool has_curvature_bound = false;
+
+    if (sampler->slot >= 0)
+    {
+        sampler->boxes[sampler->slot] = {x_left, x_right};
+
+        has_function_bound = EvaluateCompiledOnBox(sampler->function, sampler->boxes,
+                                                   &function_bound) == TREE_ERROR_NO;
+
+        has_curvature_bound = sampler->second_derivative != NULL &&
+                              EvaluateCompiledOnBox(sampler->second_derivative, sampler->boxes,
+                                                    &curvature_bound) == TREE_ERROR_NO &&
+                              curvature_bound.domain == DOMAIN_INSIDE;
+    }
+
+    // на интервале функция нигде не определена - делить его бесполезно
+    if (has_function_bound && function_bound.domain == DOMAIN_OUTSIDE)
+    {
+        interval.error = 0.0;
+        return interval;
+    }
+
+    bool left_defined   = !isnan(y_left);
+    bool right_defined  = !isnan(y_right);
+    bool middle_defined = !isnan(interval.middle_y);
+
+    if (!left_defined && !right_defined && !middle_defined)
+    {
+        interval.error = 0.0;
+    }
+    else if (!left_defined || !right_defined || !middle_defined)
+    {
+        // граница области определения или особая точка: уточняем, начиная с широких интервалов
+        interval.error = sampler->unbounded_error * width;
+    }
+    else
+    {
+        double chord_error = fabs(interval.middle_y - (y_left + y_right) / 2);
+
+        if (sampler->second_derivative != NULL)
+        {
+            double curvature = EvaluateAt(sampler, sampler->second_derivative, interval.middle_x);
+            if (!isnan(curvature))
+            {
+                double curvature_error = width * width / 8 * fabs(curvature);
+                if (curvature_error > chord_error)
+                    chord_error = curvature_error;
+            }
+        }
+
+        interval.error = chord_error;
+
+        // h^2/8 * max|f''| по интервальной оценке - гарантированная граница ошибки интерполяции
+        if (has_curvature_bound)
+        {
+            double max_curvature = fmax(fabs(curvature_bound.range.lower), fabs(curvature_bound.range.upper));
+            double guaranteed_error = width * width / 8 * max_curvature;
+            if (guaranteed_error < interval.error)
+                interval.error = guaranteed_error;
+        }
+    }
+
+    return interval;
+}
+
+// ==================== КУЧА ИНТЕРВАЛОВ ====================
+
+static void SwapIntervals(SampleInterval* first, SampleInterval* second)
+{
+    SampleInterval temp = *first;
+    *first = *second;
+    *second = temp;
+}
+
+static void PushInterval(AdaptiveSampler* sampler, SampleInterval interval)
+{
+    size_t index = sampler->heap_size++;
+    sampler->heap[index] = interval;
+
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (sampler->heap[parent].error >= sampler->heap[index].error)
+            break;
+
+        SwapIntervals(&sampler->heap[parent], &sampler->heap[index]);
+        index = parent;
+    }
+}
+
+static SampleInterval PopInterval(AdaptiveSampler* sampler)
+{
+    SampleInterval top = sampler->heap[0];
+    sampler->heap[0] = sampler->heap[--sampler->heap_size];
+
+    size_t index = 0;
+    while (true)
+    {
+        size_t largest = index;
+        size_t left  = 2 * index + 1;
+        size_t right = 2 * index + 2;
+
+        if (left < sampler->heap_size && sampler->heap[left].error > sampler->heap[largest].error)
+            largest = left;
+        if (right < sampler->heap_size && sampler->heap[right].error > sampler->heap[largest].error)
+            largest = right;
+
+        if (largest == index)
+            break;
+
+        SwapIntervals(&sampler->heap[index], &sampler->heap[largest]);
+        index = largest;
+    }
+
+    return top;
+}
+
+// ==================== АДАПТИВНАЯ СЕТКА ====================
+
+static void ComputeTolerance(AdaptiveSampler* sampler, double x_range)
+{
+    double y_min = INFINITY, y_max = -INFINITY;
+
+    for (size_t i = 0; i < sampler->count; i++)
+    {
+        if (isnan(sampler->y[i]))
+            continue;
+
+        if (sampler->y[i] < y_min) y_min = sampler->y[i];
+        if (sampler->y[i] > y_max) y_max = sampler->y[i];
+    }
+
+    double y_range = (y_max > y_min) ? y_max - y_min : 1.0;
+
+    sampler->tolerance       = y_range * kAdaptivePlotTolerance;
+    sampler->unbounded_error = y_range / x_range;
+    sampler->min_width       = x_range * kAdaptivePlotMinWidth;
+}
+
+static int CompareSamplesByX(const void* first, const void* second)
+{
+    double first_x  = ((const double*)first)[0];
+    double second_x = ((const double*)second)[0];
+
+    return (first_x > second_x) - (first_x < second_x);
+}
+
+static TreeErrorType SortSamples(AdaptiveSampler* sampler, PlotSamples* samples)
+{
+    double* pairs = (double*)calloc(sampler->count * 2, sizeof(double));
+    if (!pairs)
+        return TREE_ERROR_ALLOCATION;
+
+    for (size_t i = 0; i < sampler->count; i++)
+    {
+        pairs[2 * i]     = sampler->x[i];
+        pairs[2 * i + 1] = sampler->y[i];
+    }
+
+    qsort(pairs, sampler->count, 2 * sizeof(double), CompareSamplesByX);
+
+    for (size_t i = 0; i < sampler->count; i++)
+    {
+        sampler->x[i] = pairs[2 * i];
+        sampler->y[i] = pairs[2 * i + 1];
+    }
+
+    free(pairs);
+
+    samples->x = sampler->x;
+    samples->y = sampler->y;
+    samples->count = sampler->count;
+    return TREE_ERROR_NO;
+}
+
+TreeErrorType SampleAdaptively(const CompiledTree* function, const CompiledTree* second_derivative,
+                               const double* values, int slot, double x_min, double x_max,
+                               size_t max_points, PlotSamples* samples)
+{
+    if (function == NULL || values == NULL || samples == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(samples, 0, sizeof(*samples));
+
+    if (max_points < kAdaptivePlotInitialPoints)
+        max_points = kAdaptivePlotInitialPoints;
+    if (!(x_max > x_min))
+        return TREE_ERROR_INVALID_INPUT;
+
+    AdaptiveSampler sampler = {};
+    sampler.function = function;
+    sampler.second_derivative = second_derivative;
+    sampler.slot = slot;
+    memcpy(sampler.values, values, sizeof(sampler.values));
+    FillPointBoxes(sampler.values, kMaxNOfVariables, sampler.boxes);
+
+    // каждое деление добавляет одну точку и один интервал в кучу
+    sampler.x    = (double*)calloc(max_points, sizeof(double));
+    sampler.y    = (double*)calloc(max_points, sizeof(double));
+    sampler.heap = (SampleInterval*)calloc(max_points, sizeof(SampleInterval));
+    if (!sampler.x || !sampler.y || !sampler.heap)
+    {
+        free(sampler.x);
+        free(sampler.y);
+        free(sampler.heap);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    double step = (x_max - x_min) / (double)(kAdaptivePlotInitialPoints - 1);
+    for (size_t i = 0; i < kAdaptivePlotInitialPoints; i++)
+    {
+        sampler.x[i] = (i + 1 == kAdaptivePlotInitialPoints) ? x_max : x_min + step * (double)i;
+        sampler.y[i] = EvaluateAt(&sampler, function, sampler.x[i]);
+    }
+    sampler.count = kAdaptivePlotInitialPoints;
+
+    ComputeTolerance(&sampler, x_max - x_min);
+
+    for (size_t i = 0; i + 1 < kAdaptivePlotInitialPoints; i++)
+        PushInterval(&sampler, MakeInterval(&sampler, i, i + 1));
+
+    while (sampler.count < max_points && sampler.heap_size > 0)
+    {
+        SampleInterval interval = PopInterval(&sampler);
+        if (interval.error <= sampler.tolerance)
+            break;
+
+        size_t middle = sampler.count++;
+        sampler.x[middle] = interval.middle_x;
+        sampler.y[middle] = interval.middle_y;
+
+        PushInterval(&sampler, MakeInterval(&sampler, interval.left, middle));
+        PushInterval(&sampler, MakeInterval(&sampler, middle, interval.right));
+    }
+
+    free(sampler.heap);
+
+    TreeErrorType error = SortSamples(&sampler, samples);
+    if (error != TREE_ERROR_NO)
+    {
+        free(sampler.x);
+        free(sampler.y);
+    }
+
+    return error;
+}
+
+void DestroyPlotSamples(PlotSamples* samples)
+{
+    if (samples == NULL)
+        return;
+
+    free(samples->x);
+    free(samples->y);
+    memset(samples, 0, sizeof(*samples));
+}
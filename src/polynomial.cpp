@@ -0,0 +1,338 @@
+#include "polynomial.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "operations.h"
+#include "logic_functions.h"
+#include "DSL.h"
+
+// ==================== РАСПОЗНАВАНИЕ МНОГОЧЛЕНОВ ====================
+
+static void MakeConstantPolynomial(Polynomial* polynomial, double value)
+{
+    memset(polynomial->coefficients, 0, sizeof(polynomial->coefficients));
+    polynomial->coefficients[0] = value;
+    polynomial->degree = 0;
+}
+
+// старшие нулевые коэффициенты не считаются в степени: (x^2 + 1) - x^2 имеет степень 0
+static void TrimPolynomial(Polynomial* polynomial)
+{
+    while (polynomial->degree > 0 && fpclassify(polynomial->coefficients[polynomial->degree]) == FP_ZERO)
+        polynomial->degree--;
+}
+
+static void AddPolynomials(Polynomial* result, const Polynomial* other, double sign)
+{
+    for (int i = 0; i <= other->degree; i++)
+        result->coefficients[i] += sign * other->coefficients[i];
+
+    if (other->degree > result->degree)
+        result->degree = other->degree;
+
+    TrimPolynomial(result);
+}
+
+static bool MultiplyPolynomials(Polynomial* result, const Polynomial* other)
+{
+    if (result->degree + other->degree > kMaxPolynomialDegree)
+        return false;
+
+    double product[kMaxPolynomialDegree + 1] = {};
+    for (int i = 0; i <= result->degree; i++)
+        for (int j = 0; j <= other->degree; j++)
+            product[i + j] += result->coefficients[i] * other->coefficients[j];
+
+    memcpy(result->coefficients, product, sizeof(product));
+    result->degree += other->degree;
+    TrimPolynomial(result);
+    return true;
+}
+
+PolynomialShape PolynomialNodeShape(Node* node, PolynomialShape left, PolynomialShape right)
+{
+    assert(node);
+
+    if (node->type == NODE_NUM || node->type == NODE_VAR)
+        return POLYNOMIAL_SHAPE_MONOMIAL;
+
+    if (node->type != NODE_OP)
+        return POLYNOMIAL_SHAPE_NONE;
+
+    switch (node->data.op_value)
+    {
+        case OP_ADD:
+        case OP_SUB:
+            return (left != POLYNOMIAL_SHAPE_NONE && right != POLYNOMIAL_SHAPE_NONE) ?
+                   POLYNOMIAL_SHAPE_SUM : POLYNOMIAL_SHAPE_NONE;
+
+        case OP_MUL:
+            return (left == POLYNOMIAL_SHAPE_MONOMIAL && right == POLYNOMIAL_SHAPE_MONOMIAL) ?
+                   POLYNOMIAL_SHAPE_MONOMIAL : POLYNOMIAL_SHAPE_NONE;
+
+        case OP_DIV:
+            return (left == POLYNOMIAL_SHAPE_MONOMIAL && IsNodeType(node->right, NODE_NUM)) ?
+                   POLYNOMIAL_SHAPE_MONOMIAL : POLYNOMIAL_SHAPE_NONE;
+
+        case OP_POW:
+        {
+            if (left != POLYNOMIAL_SHAPE_MONOMIAL || !IsNodeType(node->right, NODE_NUM))
+                return POLYNOMIAL_SHAPE_NONE;
+
+            double exponent = node->right->data.num_value;
+            return (exponent >= 0 && exponent <= kMaxPolynomialDegree &&
+                    fpclassify(exponent - trunc(exponent)) == FP_ZERO) ?
+                   POLYNOMIAL_SHAPE_MONOMIAL : POLYNOMIAL_SHAPE_NONE;
+        }
+
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_LN:     case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            return POLYNOMIAL_SHAPE_NONE;
+    }
+}
+
+static bool ExtractPolynomialRecursive(Node* node, const char** variable, Polynomial* result,
+                                       PolynomialShape* shape)
+{
+    if (node == NULL)
+        return false;
+
+    switch (node->type)
+    {
+        case NODE_NUM:
+            *shape = POLYNOMIAL_SHAPE_MONOMIAL;
+            MakeConstantPolynomial(result, node->data.num_value);
+            return true;
+
+        case NODE_VAR:
+        {
+            const char* name = node->data.var_definition.name;
+            if (name == NULL)
+                return false;
+
+            if (*variable == NULL)
+                *variable = name;
+            else if (strcmp(*variable, name) != 0)
+                return false;
+
+            *shape = POLYNOMIAL_SHAPE_MONOMIAL;
+            MakeConstantPolynomial(result, 0.0);
+            result->coefficients[1] = 1.0;
+            result->degree = 1;
+            return true;
+        }
+
+        case NODE_OP:
+            break;
+
+        default:
+            return false;
+    }
+
+    // у остальных операций дети не просматриваются
+    switch (node->data.op_value)
+    {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_POW:
+            break;
+
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_LN:     case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            return false;
+    }
+
+    Polynomial right = {};
+    PolynomialShape left_shape  = POLYNOMIAL_SHAPE_NONE;
+    PolynomialShape right_shape = POLYNOMIAL_SHAPE_NONE;
+
+    if (!ExtractPolynomialRecursive(node->left, variable, result, &left_shape) ||
+        !ExtractPolynomialRecursive(node->right, variable, &right, &right_shape))
+        return false;
+
+    *shape = PolynomialNodeShape(node, left_shape, right_shape);
+    if (*shape == POLYNOMIAL_SHAPE_NONE)
+        return false;
+
+    switch (node->data.op_value)
+    {
+        case OP_ADD:
+        case OP_SUB:
+            AddPolynomials(result, &right, IsNodeOp(node, OP_SUB) ? -1.0 : 1.0);
+            return true;
+
+        // одночлен на одночлен: коэффициенты не смешиваются
+        case OP_MUL:
+            return MultiplyPolynomials(result, &right);
+
+        case OP_DIV:
+            if (is_zero(right.coefficients[0]))
+                return false;
+
+            for (int i = 0; i <= result->degree; i++)
+                result->coefficients[i] /= right.coefficients[0];
+            return true;
+
+        case OP_POW:
+        {
+            Polynomial base = *result;
+            MakeConstantPolynomial(result, 1.0);
+            for (int i = 0; i < (int)right.coefficients[0]; i++)
+            {
+                if (!MultiplyPolynomials(result, &base))
+                    return false;
+            }
+            return true;
+        }
+
+        case OP_SIN:    case OP_COS:    case OP_TAN:    case OP_COT:
+        case OP_ARCSIN: case OP_ARCCOS: case OP_ARCTAN: case OP_ARCCOT:
+        case OP_SINH:   case OP_COSH:   case OP_TANH:   case OP_COTH:
+        case OP_LN:     case OP_EXP:    case OP_SQRT:
+        case OP_COUNT:
+        default:
+            return false;
+    }
+}
+
+bool ExtractPolynomial(Node* node, Polynomial* polynomial)
+{
+    assert(polynomial);
+
+    const char* variable = NULL;
+    PolynomialShape shape = POLYNOMIAL_SHAPE_NONE;
+    if (!ExtractPolynomialRecursive(node, &variable, polynomial, &shape))
+        return false;
+
+    polynomial->variable = variable;
+    return true;
+}
+
+int CountPolynomialTerms(const Polynomial* polynomial)
+{
+    assert(polynomial);
+
+    int n_terms = 0;
+    for (int i = 0; i <= polynomial->degree; i++)
+        if (fpclassify(polynomial->coefficients[i]) != FP_ZERO)
+            n_terms++;
+
+    return n_terms;
+}
+
+// ==================== СХЕМА ГОРНЕРА В ДЕРЕВЕ ====================
+
+Node* BuildHornerForm(const Polynomial* polynomial)
+{
+    assert(polynomial);
+
+    if (polynomial->variable == NULL || polynomial->degree == 0)
+        return NUM(polynomial->coefficients[0]);
+
+    const char* variable = polynomial->variable;
+    Node* horner = NULL;
+
+    for (int i = polynomial->degree; i >= 0; i--)
+    {
+        double coefficient = polynomial->coefficients[i];
+
+        if (horner == NULL)
+        {
+            horner = is_one(coefficient) ? NULL : NUM(coefficient);
+        }
+        else if (fpclassify(coefficient) != FP_ZERO)
+        {
+            horner = (coefficient < 0) ? SUB(horner, NUM(-coefficient)) : ADD(horner, NUM(coefficient));
+        }
+
+        if (i > 0)
+            horner = (horner == NULL) ? VAR(variable) : MUL(VAR(variable), horner);
+    }
+
+    return horner;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ ====================
+
+double EvaluatePolynomialHorner(const double* coefficients, int degree, double x)
+{
+    assert(coefficients);
+
+    double result = coefficients[degree];
+    for (int i = degree - 1; i >= 0; i--)
+        result = fma(result, x, coefficients[i]);
+
+    return result;
+}
+
+void EvaluatePolynomialEstrin(const double* coefficients, int degree, const double* x,
+                              size_t n_points, double* results)
+{
+    assert(coefficients);
+    assert(x);
+    assert(results);
+
+    double partial[kMaxPolynomialDegree / 2 + 1][kFastEvalBlockSize];
+    double power[kFastEvalBlockSize];
+
+    for (size_t first = 0; first < n_points; first += kFastEvalBlockSize)
+    {
+        size_t block_size = n_points - first;
+        if (block_size > kFastEvalBlockSize)
+            block_size = kFastEvalBlockSize;
+
+        const double* block_x = x + first;
+
+        // пары c[2i] + c[2i+1]*x
+        int count = degree + 1;
+        for (int i = 0; 2 * i < count; i++)
+        {
+            if (2 * i + 1 < count)
+                for (size_t j = 0; j < block_size; j++)
+                    partial[i][j] = fma(coefficients[2 * i + 1], block_x[j], coefficients[2 * i]);
+            else
+                for (size_t j = 0; j < block_size; j++)
+                    partial[i][j] = coefficients[2 * i];
+        }
+
+        for (size_t j = 0; j < block_size; j++)
+            power[j] = block_x[j] * block_x[j];
+
+        count = (count + 1) / 2;
+
+        // на каждом уровне пары склеиваются через x^2, x^4, ...
+        while (count > 1)
+        {
+            for (int i = 0; 2 * i < count; i++)
+            {
+                if (2 * i + 1 < count)
+                    for (size_t j = 0; j < block_size; j++)
+                        partial[i][j] = fma(partial[2 * i + 1][j], power[j], partial[2 * i][j]);
+                else
+                    for (size_t j = 0; j < block_size; j++)
+                        partial[i][j] = partial[2 * i][j];
+            }
+
+            count = (count + 1) / 2;
+            if (count > 1)
+                for (size_t j = 0; j < block_size; j++)
+                    power[j] *= power[j];
+        }
+
+        memcpy(results + first, partial[0], block_size * sizeof(double));
+    }
+}
+
+#include "DSL_undef.h"
@@ -6,10 +6,15 @@
 #include "latex_dump.h"
 #include "user_interface.h"
 #include "new_great_input.h"
+#include "tree_serialize.h"
+#include "derivative_cache.h"
+#include "cost_model.h"
+#include "eval_session.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 // ==================== CONTEXT MANAGEMENT FUNCTIONS ====================
 
@@ -62,15 +67,13 @@ TreeErrorType ParseExpressionTree(DifferentiatorStruct* diff_struct)
 {
     if (!diff_struct || !diff_struct->expression) return TREE_ERROR_NULL_PTR;
 
-    const char* ptr = diff_struct->expression;
-    diff_struct->tree.root = GetGovnoNaBosuNogu(&ptr, &diff_struct->var_table);
-
-    if (!diff_struct->tree.root)
+    TreeErrorType error = ParseExpressionIntoTree(&diff_struct->tree, diff_struct->expression,
+                                                  &diff_struct->var_table);
+    if (error != TREE_ERROR_NO)
     {
-        return TREE_ERROR_FORMAT;
+        return error;
     }
 
-    diff_struct->tree.size = CountTreeNodes(diff_struct->tree.root);
     printf("Successfully parsed expression. Tree size: %zu\n", diff_struct->tree.size);
 
     return TREE_ERROR_NO;
@@ -131,18 +134,23 @@ TreeErrorType OptimizeExpressionTree(DifferentiatorStruct* diff_struct)
 {
     if (!diff_struct) return TREE_ERROR_NULL_PTR;
 
-    size_t size_before = CountTreeNodes(diff_struct->tree.root);
+    size_t size_before = diff_struct->tree.size;
+    double cost_before = EstimateTreeCost(diff_struct->tree.root);
 
-    TreeErrorType error = OptimizeTreeWithDump(&diff_struct->tree, diff_struct->tex_file, &diff_struct->var_table);
+    TreeErrorType error = OptimizeTreeWithDump(&diff_struct->tree, diff_struct->tex_file, &diff_struct->var_table,
+                                               diff_struct->options.optimization_level,
+                                               diff_struct->options.verify_optimization);
     if (error != TREE_ERROR_NO)
     {
         return error;
     }
 
-    size_t size_after = CountTreeNodes(diff_struct->tree.root);
-    printf("Optimization: %zu -> %zu nodes\n", size_before, size_after);
+    size_t size_after = diff_struct->tree.size;
+    double cost_after = EstimateTreeCost(diff_struct->tree.root);
+    printf("Optimization: %zu -> %zu nodes, estimated cost %.1f -> %.1f\n",
+           size_before, size_after, cost_before, cost_after);
 
-    if (size_before != size_after)
+    if (size_before != size_after || cost_before > cost_after)
     {
         error = EvaluateTree(&diff_struct->tree, &diff_struct->var_table, &diff_struct->result);
         if (error == TREE_ERROR_NO)
@@ -155,14 +163,149 @@ TreeErrorType OptimizeExpressionTree(DifferentiatorStruct* diff_struct)
     return TREE_ERROR_NO;
 }
 
+// ==================== PRECOMPUTED DERIVATIVES ====================
+
+// файл хранит исходное дерево и его производные, метка - переменная дифференцирования;
+// производные берутся из файла, только если исходное дерево и переменная совпадают
+static int LoadPrecomputedDerivatives(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                                      Tree* derivative_trees)
+{
+    const char* filename = diff_struct->options.derivatives_filename;
+    if (filename == NULL || access(filename, R_OK) != 0)
+        return 0;
+
+    Tree stored[kMaxNumberOfDerivative + 1] = {};
+    char label[kMaxVariableLength] = {0};
+    int  n_stored = 0;
+
+    TreeErrorType error = LoadTreesFromFile(filename, label, sizeof(label), stored,
+                                            kMaxNumberOfDerivative + 1, &n_stored);
+    if (error != TREE_ERROR_NO)
+    {
+        printf("Precomputed derivatives in %s are unreadable: %s\n", filename, GetTreeErrorString(error));
+        return 0;
+    }
+
+    int n_loaded = 0;
+    if (n_stored > 1 && strcmp(label, diff_variable) == 0 && TreesHaveSameStructure(&stored[0], &diff_struct->tree))
+    {
+        n_loaded = n_stored - 1;
+        for (int i = 0; i < n_loaded; i++)
+            derivative_trees[i] = stored[i + 1];
+
+        printf("Loaded %d precomputed derivatives from %s\n", n_loaded, filename);
+    }
+    else
+    {
+        for (int i = 1; i < n_stored; i++)
+            TreeDtor(&stored[i]);
+
+        printf("Precomputed derivatives in %s belong to another expression, recomputing\n", filename);
+    }
+
+    TreeDtor(&stored[0]);
+    return n_loaded;
+}
+
+static void SavePrecomputedDerivatives(DifferentiatorStruct* diff_struct, const char* diff_variable,
+                                       Tree* derivative_trees, int n_derivatives)
+{
+    Tree bundle[kMaxNumberOfDerivative + 1] = {};
+    bundle[0] = diff_struct->tree;
+    for (int i = 0; i < n_derivatives; i++)
+        bundle[i + 1] = derivative_trees[i];
+
+    TreeErrorType error = SaveTreesToFile(diff_struct->options.derivatives_filename, diff_variable,
+                                          bundle, n_derivatives + 1);
+    if (error != TREE_ERROR_NO)
+        printf("Could not save derivatives: %s\n", GetTreeErrorString(error));
+    else
+        printf("Derivatives saved to %s\n", diff_struct->options.derivatives_filename);
+}
+
+// ==================== VALUE SWEEP ====================
+
+static void PrintSweepValues(EvaluationSession* sessions, int n_sessions)
+{
+    size_t n_recomputed = 0;
+    size_t n_nodes = 0;
+
+    for (int i = 0; i < n_sessions; i++)
+    {
+        double value = 0.0;
+        TreeErrorType error = EvaluateSession(&sessions[i], &value);
+
+        if (i == 0)
+            printf(" f");
+        else
+            printf(" f^(%d)", i);
+
+        if (error == TREE_ERROR_NO)
+            printf(" = %.6f", value);
+        else
+            printf(" undefined");
+
+        n_recomputed += sessions[i].n_recomputed;
+        n_nodes      += sessions[i].n_nodes;
+    }
+
+    printf(" (recomputed %zu of %zu nodes)\n", n_recomputed, n_nodes);
+}
+
+// строки "переменная значение" до конца ввода: после SetVariableValue сессии
+// пересчитывают только узлы f и производных, зависящие от этой переменной
+static TreeErrorType RunValueSweep(DifferentiatorStruct* diff_struct, Tree* derivative_trees, int n_derivatives)
+{
+    EvaluationSession sessions[kMaxNumberOfDerivative + 1] = {};
+    int n_sessions = 0;
+
+    TreeErrorType error = InitEvaluationSession(&sessions[0], &diff_struct->tree, &diff_struct->var_table);
+    if (error == TREE_ERROR_NO)
+        n_sessions++;
+
+    for (int i = 0; i < n_derivatives && error == TREE_ERROR_NO; i++)
+    {
+        error = InitEvaluationSession(&sessions[i + 1], &derivative_trees[i], &diff_struct->var_table);
+        if (error == TREE_ERROR_NO)
+            n_sessions++;
+    }
+
+    if (error == TREE_ERROR_NO)
+    {
+        printf("\n=== Value Sweep ===\n");
+        printf("Enter \"variable value\" per line, end of input finishes the sweep\n");
+        printf("initial:");
+        PrintSweepValues(sessions, n_sessions);
+
+        char   name[kMaxVariableLength] = {0};
+        double value = 0.0;
+        while (scanf("%31s %lf", name, &value) == 2)
+        {
+            if (SetVariableValue(&diff_struct->var_table, name, value) != TREE_ERROR_NO)
+            {
+                printf("Unknown variable '%s'\n", name);
+                continue;
+            }
+
+            printf("%s = %g:", name, value);
+            PrintSweepValues(sessions, n_sessions);
+        }
+    }
+
+    for (int i = 0; i < n_sessions; i++)
+        DestroyEvaluationSession(&sessions[i]);
+
+    return error;
+}
+
 TreeErrorType PerformDifferentiationProcess(DifferentiatorStruct* diff_struct)
 {
     if (!diff_struct || !diff_struct->tex_file)
         return TREE_ERROR_NULL_PTR;
 
-    char original_expr[kMaxLengthOfTexExpression] = {0};
-    int pos = 0;
-    TreeToStringSimple(diff_struct->tree.root, original_expr, &pos, sizeof(original_expr));
+    StringBuilder original_expr = {};
+    InitStringBuilder(&original_expr);
+    TreeToStringSimple(diff_struct->tree.root, &original_expr);
 
     fprintf(diff_struct->tex_file, "\\section*{Differentiation}\n");
 
@@ -170,45 +313,89 @@ TreeErrorType PerformDifferentiationProcess(DifferentiatorStruct* diff_struct)
     if (!diff_variable)
     {
         fprintf(diff_struct->tex_file, "Failed to select variable for differentiation.\\newline\n\n");
+        DestroyStringBuilder(&original_expr);
         return TREE_ERROR_NO_VARIABLES;
     }
 
     fprintf(diff_struct->tex_file, "Differentiation variable: \\[ %s \\]\\newline\n\n", diff_variable);
 
-    TreeErrorType plot_error = AddFunctionPlot(diff_struct, diff_variable);
-    if (plot_error != TREE_ERROR_NO)
-    {
-        fprintf(diff_struct->tex_file, "\\textbf{Note:} Could not create function plot.\\newline\n");
-    }
-
     Tree derivative_trees[kMaxNumberOfDerivative] = {};
     double derivative_results[kMaxNumberOfDerivative] = {};
-    int actual_derivative_count = 0;
+
+    int n_loaded = LoadPrecomputedDerivatives(diff_struct, diff_variable, derivative_trees);
+    int n_derivatives = 0;
+
+    DerivativeCache cache = {};
+    bool use_cache = false;
+    if (diff_struct->options.cache_directory != NULL)
+    {
+        TreeErrorType cache_error = InitDerivativeCache(&cache, diff_struct->options.cache_directory,
+                                                        diff_struct->options.cache_max_bytes,
+                                                        diff_struct->options.optimization_level);
+        if (cache_error == TREE_ERROR_NO)
+            use_cache = true;
+        else
+            printf("Derivative cache disabled: %s\n", GetTreeErrorString(cache_error));
+    }
 
     Tree* current_tree = &diff_struct->tree;
 
     for (int i = 0; i < kMaxNumberOfDerivative; i++)
     {
-        TreeCtor(&derivative_trees[i]);
+        TreeErrorType error = TREE_ERROR_NO;
 
-        TreeErrorType error = DifferentiateTree(current_tree, diff_variable, &derivative_trees[i]);
-        if (error != TREE_ERROR_NO)
+        if (i < n_loaded)
+        {
+            fprintf(diff_struct->tex_file, "\\subsection*{Derivative %d}\n", i + 1);
+            fprintf(diff_struct->tex_file, "Loaded from precomputed file.\n\n");
+        }
+        else
         {
-            TreeDtor(&derivative_trees[i]);
-            break;
+            TreeCtor(&derivative_trees[i]);
+
+            bool cached = false;
+            if (use_cache)
+                LookupCachedDerivative(&cache, &diff_struct->tree, diff_variable, i + 1, &derivative_trees[i], &cached);
+
+            if (cached)
+            {
+                fprintf(diff_struct->tex_file, "\\subsection*{Derivative %d}\n", i + 1);
+                fprintf(diff_struct->tex_file, "Loaded from derivative cache.\n\n");
+            }
+            else
+            {
+                error = DifferentiateTree(current_tree, diff_variable, &derivative_trees[i]);
+                if (error != TREE_ERROR_NO)
+                {
+                    TreeDtor(&derivative_trees[i]);
+                    break;
+                }
+
+                fprintf(diff_struct->tex_file, "\\subsection*{Derivative %d Optimization}\n", i + 1);
+                error = OptimizeTreeWithDump(&derivative_trees[i], diff_struct->tex_file, &diff_struct->var_table,
+                                             diff_struct->options.optimization_level,
+                                             diff_struct->options.verify_optimization);
+
+                if (use_cache && error == TREE_ERROR_NO)
+                {
+                    TreeErrorType cache_error = StoreCachedDerivative(&cache, &diff_struct->tree, diff_variable,
+                                                                      i + 1, &derivative_trees[i]);
+                    if (cache_error != TREE_ERROR_NO)
+                        printf("Could not store derivative %d in cache: %s\n", i + 1, GetTreeErrorString(cache_error));
+                }
+            }
         }
 
-        fprintf(diff_struct->tex_file, "\\subsection*{Derivative %d Optimization}\n", i + 1);
-        error = OptimizeTreeWithDump(&derivative_trees[i], diff_struct->tex_file, &diff_struct->var_table);
+        n_derivatives = i + 1;
 
         error = EvaluateTree(&derivative_trees[i], &diff_struct->var_table, &derivative_results[i]);
         if (error == TREE_ERROR_NO)
         {
             printf("Derivative %d: %.6f\n", i + 1, derivative_results[i]);
-            actual_derivative_count++;
 
             fprintf(diff_struct->tex_file, "Original expression:\n");
-            fprintf(diff_struct->tex_file, "\\begin{dmath} f(x) = %s \\end{dmath}\n\n", original_expr);
+            fprintf(diff_struct->tex_file, "\\begin{dmath} f(x) = %s \\end{dmath}\n\n",
+                    GetStringBuilderData(&original_expr));
 
             fprintf(diff_struct->tex_file, "Optimized derivative:\n");
 
@@ -218,9 +405,27 @@ TreeErrorType PerformDifferentiationProcess(DifferentiatorStruct* diff_struct)
         current_tree = &derivative_trees[i];
     }
 
+    // график строится после производных, чтобы в табличных режимах нарисовать и их
+    TreeErrorType plot_error = AddFunctionPlot(diff_struct, diff_variable, derivative_trees, n_derivatives);
+    if (plot_error != TREE_ERROR_NO)
+    {
+        fprintf(diff_struct->tex_file, "\\textbf{Note:} Could not create function plot.\\newline\n");
+    }
+
+    if (diff_struct->options.derivatives_filename != NULL && n_loaded == 0 && n_derivatives > 0)
+        SavePrecomputedDerivatives(diff_struct, diff_variable, derivative_trees, n_derivatives);
+
+    if (diff_struct->options.value_sweep)
+    {
+        TreeErrorType sweep_error = RunValueSweep(diff_struct, derivative_trees, n_derivatives);
+        if (sweep_error != TREE_ERROR_NO)
+            printf("Value sweep failed: %s\n", GetTreeErrorString(sweep_error));
+    }
+
     free(diff_variable);
+    DestroyStringBuilder(&original_expr);
 
-    for (int i = 0; i < actual_derivative_count; i++)
+    for (int i = 0; i < n_derivatives; i++)
     {
         TreeDtor(&derivative_trees[i]);
     }
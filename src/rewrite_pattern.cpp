@@ -0,0 +1,249 @@
+#include "rewrite_pattern.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logic_functions.h"
+
+static const char* const pattern_operation_names[OP_COUNT] = {
+    /* OP_ADD */    "add",
+    /* OP_SUB */    "sub",
+    /* OP_MUL */    "mul",
+    /* OP_DIV */    "div",
+    /* OP_POW */    "pow",
+    /* OP_SIN */    "sin",
+    /* OP_COS */    "cos",
+    /* OP_TAN */    "tan",
+    /* OP_COT */    "cot",
+    /* OP_ARCSIN */ "arcsin",
+    /* OP_ARCCOS */ "arccos",
+    /* OP_ARCTAN */ "arctan",
+    /* OP_ARCCOT */ "arccot",
+    /* OP_SINH */   "sinh",
+    /* OP_COSH */   "cosh",
+    /* OP_TANH */   "tanh",
+    /* OP_COTH */   "coth",
+    /* OP_LN */     "ln",
+    /* OP_EXP */    "exp",
+    /* OP_SQRT */   "sqrt"
+};
+
+const char* GetPatternOperationName(OperationType op)
+{
+    if (op < 0 || op >= OP_COUNT)
+        return "?";
+
+    return pattern_operation_names[op];
+}
+
+// ==================== РАЗБОР ====================
+
+static void SkipPatternSpaces(const char** s)
+{
+    while (isspace((unsigned char)**s))
+        (*s)++;
+}
+
+static bool IsPatternNameChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// имя копируется в buffer, false - пустое или слишком длинное
+static bool ReadPatternName(const char** s, char* buffer)
+{
+    size_t length = 0;
+    while (IsPatternNameChar((*s)[length]))
+        length++;
+
+    if (length == 0 || length >= (size_t)kMaxVariableLength)
+        return false;
+
+    memcpy(buffer, *s, length);
+    buffer[length] = '\0';
+    *s += length;
+    return true;
+}
+
+static int AppendPatternNode(RewriteRule* rule, PatternNode node)
+{
+    if (rule->n_nodes >= kMaxPatternNodes)
+        return -1;
+
+    rule->nodes[rule->n_nodes] = node;
+    return rule->n_nodes++;
+}
+
+static int FindWildcard(const RewriteRule* rule, const char* name)
+{
+    for (int i = 0; i < rule->n_wildcards; i++)
+        if (strcmp(rule->wildcard_names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+static bool ExpectPatternChar(const char** s, char expected)
+{
+    SkipPatternSpaces(s);
+    if (**s != expected)
+        return false;
+
+    (*s)++;
+    return true;
+}
+
+// индекс разобранного узла, -1 - синтаксическая ошибка
+static int ParsePatternTerm(const char** s, RewriteRule* rule, bool is_rhs)
+{
+    SkipPatternSpaces(s);
+
+    PatternNode node = {};
+    node.left  = -1;
+    node.right = -1;
+
+    char name[kMaxVariableLength] = {};
+
+    if (**s == '?')
+    {
+        (*s)++;
+        if (!ReadPatternName(s, name))
+            return -1;
+
+        node.kind = PATTERN_WILDCARD;
+        node.wildcard = FindWildcard(rule, name);
+        if (node.wildcard < 0)
+        {
+            if (is_rhs || rule->n_wildcards >= kMaxPatternWildcards)
+                return -1;
+
+            node.wildcard = rule->n_wildcards;
+            strcpy(rule->wildcard_names[rule->n_wildcards++], name);
+        }
+
+        return AppendPatternNode(rule, node);
+    }
+
+    if (isdigit((unsigned char)**s) || **s == '-' || **s == '.')
+    {
+        char* end = NULL;
+        node.kind  = PATTERN_NUM;
+        node.value = strtod(*s, &end);
+        if (end == *s)
+            return -1;
+
+        *s = end;
+        return AppendPatternNode(rule, node);
+    }
+
+    if (!ReadPatternName(s, name))
+        return -1;
+
+    int op = 0;
+    while (op < OP_COUNT && strcmp(pattern_operation_names[op], name) != 0)
+        op++;
+
+    if (op == OP_COUNT || !ExpectPatternChar(s, '('))
+        return -1;
+
+    node.kind = PATTERN_OP;
+    node.op   = (OperationType)op;
+
+    if (is_binary(node.op))
+    {
+        node.left = ParsePatternTerm(s, rule, is_rhs);
+        if (node.left < 0 || !ExpectPatternChar(s, ','))
+            return -1;
+    }
+
+    node.right = ParsePatternTerm(s, rule, is_rhs);
+    if (node.right < 0 || !ExpectPatternChar(s, ')'))
+        return -1;
+
+    return AppendPatternNode(rule, node);
+}
+
+// условия после where: nonzero(?x), nonzero(?y), ...
+static bool ParseRuleGuards(const char** s, RewriteRule* rule)
+{
+    while (true)
+    {
+        char name[kMaxVariableLength] = {};
+        SkipPatternSpaces(s);
+        if (!ReadPatternName(s, name) || strcmp(name, "nonzero") != 0 || !ExpectPatternChar(s, '('))
+            return false;
+
+        SkipPatternSpaces(s);
+        if (**s != '?')
+            return false;
+        (*s)++;
+
+        int wildcard = ReadPatternName(s, name) ? FindWildcard(rule, name) : -1;
+        if (wildcard < 0 || !ExpectPatternChar(s, ')'))
+            return false;
+
+        rule->is_nonzero[wildcard] = true;
+
+        SkipPatternSpaces(s);
+        if (**s != ',')
+            return true;
+        (*s)++;
+    }
+}
+
+// после '#' пропускается один пробел-разделитель, остальное копируется как есть
+// без хвостовых пробелов: описания шагов в дампе должны совпадать дословно
+static void CopyRuleDescription(const char* text, RewriteRule* rule)
+{
+    if (*text == ' ')
+        text++;
+
+    size_t length = strlen(text);
+    while (length > 0 && isspace((unsigned char)text[length - 1]))
+        length--;
+
+    if (length >= sizeof(rule->description))
+        length = sizeof(rule->description) - 1;
+
+    memcpy(rule->description, text, length);
+    rule->description[length] = '\0';
+}
+
+TreeErrorType ParseRewriteRule(const char* text, RewriteRule* rule)
+{
+    if (text == NULL || rule == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(rule, 0, sizeof(*rule));
+
+    const char* s = text;
+    rule->lhs = ParsePatternTerm(&s, rule, false);
+    if (rule->lhs < 0)
+        return TREE_ERROR_FORMAT;
+
+    SkipPatternSpaces(&s);
+    if (strncmp(s, "->", 2) != 0)
+        return TREE_ERROR_FORMAT;
+    s += 2;
+
+    rule->rhs = ParsePatternTerm(&s, rule, true);
+    if (rule->rhs < 0)
+        return TREE_ERROR_FORMAT;
+
+    SkipPatternSpaces(&s);
+    if (strncmp(s, "where", 5) == 0 && !IsPatternNameChar(s[5]))
+    {
+        s += 5;
+        if (!ParseRuleGuards(&s, rule))
+            return TREE_ERROR_FORMAT;
+    }
+
+    if (*s == '#')
+        CopyRuleDescription(s + 1, rule);
+    else if (*s != '\0')
+        return TREE_ERROR_FORMAT;
+
+    return TREE_ERROR_NO;
+}
@@ -0,0 +1,315 @@
+#include "rule_matcher.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "operations.h"
+#include "logic_functions.h"
+#include "canonical_form.h"
+#include "DSL.h"
+
+// ==================== КОМПИЛЯЦИЯ ====================
+
+static int AppendDiscriminationNode(RewriteRuleSet* set, const PatternNode* symbol)
+{
+    if (set->n_nodes == set->capacity)
+    {
+        int new_capacity = (set->capacity == 0) ? 64 : set->capacity * 2;
+        DiscriminationNode* new_nodes = (DiscriminationNode*)realloc(set->nodes,
+                                                                     (size_t)new_capacity * sizeof(DiscriminationNode));
+        if (!new_nodes)
+            return -1;
+
+        set->nodes = new_nodes;
+        set->capacity = new_capacity;
+    }
+
+    DiscriminationNode* node = &set->nodes[set->n_nodes];
+    memset(node, 0, sizeof(*node));
+    node->kind         = symbol ? symbol->kind  : PATTERN_WILDCARD;
+    node->op           = symbol ? symbol->op    : OP_ADD;
+    node->value        = symbol ? symbol->value : 0.0;
+    node->first_child  = -1;
+    node->next_sibling = -1;
+    node->first_rule   = -1;
+
+    return set->n_nodes++;
+}
+
+static bool SameSymbol(const DiscriminationNode* node, const PatternNode* symbol)
+{
+    if (node->kind != symbol->kind)
+        return false;
+
+    switch (symbol->kind)
+    {
+        case PATTERN_OP:       return node->op == symbol->op;
+        case PATTERN_NUM:      return is_zero(node->value - symbol->value);
+        case PATTERN_WILDCARD: return true;
+        default:               return false;
+    }
+}
+
+// ребенок с тем же символом или новый, -1 - не хватило памяти
+static int FindOrAddChild(RewriteRuleSet* set, int parent, const PatternNode* symbol)
+{
+    for (int child = set->nodes[parent].first_child; child >= 0; child = set->nodes[child].next_sibling)
+        if (SameSymbol(&set->nodes[child], symbol))
+            return child;
+
+    int child = AppendDiscriminationNode(set, symbol);
+    if (child < 0)
+        return -1;
+
+    set->nodes[child].next_sibling = set->nodes[parent].first_child;
+    set->nodes[parent].first_child = child;
+    return child;
+}
+
+// путь левой части в префиксном порядке; шаблонные переменные записываются в
+// порядке появления, чтобы при сопоставлении сверить повторы
+static int InsertPattern(RewriteRuleSet* set, int rule_index, int pattern, int trie_node, int* n_wildcards)
+{
+    const RewriteRule* rule = &set->rules[rule_index];
+    const PatternNode* symbol = &rule->nodes[pattern];
+
+    trie_node = FindOrAddChild(set, trie_node, symbol);
+    if (trie_node < 0)
+        return -1;
+
+    if (symbol->kind == PATTERN_WILDCARD)
+        set->wildcard_order[rule_index * kMaxPatternNodes + (*n_wildcards)++] = symbol->wildcard;
+
+    if (symbol->kind != PATTERN_OP)
+        return trie_node;
+
+    if (symbol->left >= 0)
+    {
+        trie_node = InsertPattern(set, rule_index, symbol->left, trie_node, n_wildcards);
+        if (trie_node < 0)
+            return -1;
+    }
+
+    return InsertPattern(set, rule_index, symbol->right, trie_node, n_wildcards);
+}
+
+TreeErrorType CompileRewriteRules(const char* const* texts, size_t n_texts, RewriteRuleSet* set)
+{
+    if (texts == NULL || set == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(set, 0, sizeof(*set));
+
+    set->rules          = (RewriteRule*)calloc(n_texts, sizeof(RewriteRule));
+    set->next_rule      = (int*)calloc(n_texts, sizeof(int));
+    set->wildcard_order = (int*)calloc(n_texts * kMaxPatternNodes, sizeof(int));
+    if (!set->rules || !set->next_rule || !set->wildcard_order || AppendDiscriminationNode(set, NULL) < 0)
+    {
+        DestroyRewriteRuleSet(set);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    for (size_t i = 0; i < n_texts; i++)
+    {
+        TreeErrorType error = ParseRewriteRule(texts[i], &set->rules[i]);
+        if (error != TREE_ERROR_NO)
+        {
+            DestroyRewriteRuleSet(set);
+            return error;
+        }
+
+        int n_wildcards = 0;
+        int leaf = InsertPattern(set, (int)i, set->rules[i].lhs, 0, &n_wildcards);
+        if (leaf < 0)
+        {
+            DestroyRewriteRuleSet(set);
+            return TREE_ERROR_ALLOCATION;
+        }
+
+        // правила в листе упорядочены по номеру: первое подошедшее - самое раннее
+        int* link = &set->nodes[leaf].first_rule;
+        while (*link >= 0)
+            link = &set->next_rule[*link];
+
+        set->next_rule[i] = -1;
+        *link = (int)i;
+        set->n_rules++;
+    }
+
+    return TREE_ERROR_NO;
+}
+
+void DestroyRewriteRuleSet(RewriteRuleSet* set)
+{
+    if (set == NULL)
+        return;
+
+    free(set->rules);
+    free(set->next_rule);
+    free(set->wildcard_order);
+    free(set->nodes);
+    memset(set, 0, sizeof(*set));
+}
+
+// ==================== СОПОСТАВЛЕНИЕ ====================
+
+typedef struct {
+    const RewriteRuleSet* set;
+    Node* positional[kMaxPatternNodes];        // поддеревья, совпавшие с ? в префиксном порядке
+    int   best_rule;
+    Node* bindings[kMaxPatternWildcards];
+} RuleMatch;
+
+static bool CheckRuleBindings(const RewriteRuleSet* set, int rule_index, Node* const* positional, int n_positional,
+                              Node** bindings)
+{
+    const RewriteRule* rule = &set->rules[rule_index];
+    for (int w = 0; w < kMaxPatternWildcards; w++)
+        bindings[w] = NULL;
+
+    for (int k = 0; k < n_positional; k++)
+    {
+        int wildcard = set->wildcard_order[rule_index * kMaxPatternNodes + k];
+        if (bindings[wildcard] == NULL)
+            bindings[wildcard] = positional[k];
+        else if (CompareCanonicalNodes(bindings[wildcard], positional[k]) != 0)
+            return false;
+    }
+
+    for (int w = 0; w < rule->n_wildcards; w++)
+    {
+        if (rule->is_nonzero[w] && IsNodeType(bindings[w], NODE_NUM) && is_zero(bindings[w]->data.num_value))
+            return false;
+    }
+
+    return true;
+}
+
+// pending - стек еще не сопоставленных поддеревьев, вершина - следующее в префиксном порядке
+static void MatchDiscriminationNode(RuleMatch* match, int trie_node, Node* const* pending, int n_pending,
+                                    int n_positional)
+{
+    const RewriteRuleSet* set = match->set;
+
+    if (n_pending == 0)
+    {
+        for (int r = set->nodes[trie_node].first_rule; r >= 0 && r < match->best_rule; r = set->next_rule[r])
+        {
+            Node* bindings[kMaxPatternWildcards] = {};
+            if (CheckRuleBindings(set, r, match->positional, n_positional, bindings))
+            {
+                match->best_rule = r;
+                memcpy(match->bindings, bindings, sizeof(bindings));
+                break;
+            }
+        }
+        return;
+    }
+
+    Node* current = pending[n_pending - 1];
+
+    for (int child = set->nodes[trie_node].first_child; child >= 0; child = set->nodes[child].next_sibling)
+    {
+        const DiscriminationNode* symbol = &set->nodes[child];
+
+        switch (symbol->kind)
+        {
+            case PATTERN_WILDCARD:
+                if (n_positional >= kMaxPatternNodes)
+                    break;
+                match->positional[n_positional] = current;
+                MatchDiscriminationNode(match, child, pending, n_pending - 1, n_positional + 1);
+                break;
+
+            case PATTERN_NUM:
+                if (IsNodeType(current, NODE_NUM) && is_zero(current->data.num_value - symbol->value))
+                    MatchDiscriminationNode(match, child, pending, n_pending - 1, n_positional);
+                break;
+
+            case PATTERN_OP:
+            {
+                if (!IsNodeOp(current, symbol->op) || n_pending + 1 >= kMaxPatternNodes)
+                    break;
+
+                // левый аргумент идет раньше правого, поэтому кладется на стек последним
+                Node* next[kMaxPatternNodes] = {};
+                memcpy(next, pending, (size_t)(n_pending - 1) * sizeof(Node*));
+
+                int n_next = n_pending - 1;
+                next[n_next++] = current->right;
+                if (is_binary(symbol->op))
+                    next[n_next++] = current->left;
+
+                MatchDiscriminationNode(match, child, next, n_next, n_positional);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+static Node* InstantiateRule(const RewriteRule* rule, int pattern, Node* const* bindings)
+{
+    const PatternNode* pattern_node = &rule->nodes[pattern];
+
+    switch (pattern_node->kind)
+    {
+        case PATTERN_WILDCARD:
+            return COPY(bindings[pattern_node->wildcard]);
+
+        case PATTERN_NUM:
+            return NUM(pattern_node->value);
+
+        case PATTERN_OP:
+        {
+            Node* left = NULL;
+            if (pattern_node->left >= 0)
+            {
+                left = InstantiateRule(rule, pattern_node->left, bindings);
+                if (left == NULL)
+                    return NULL;
+            }
+
+            Node* right = InstantiateRule(rule, pattern_node->right, bindings);
+            if (right == NULL)
+            {
+                FreeSubtree(left);
+                return NULL;
+            }
+
+            ValueOfTreeElement data = {};
+            data.op_value = pattern_node->op;
+            return CreateNode(NODE_OP, data, left, right);
+        }
+
+        default:
+            return NULL;
+    }
+}
+
+Node* RewriteByRules(const RewriteRuleSet* set, Node* node, const char** description)
+{
+    if (set == NULL || node == NULL || set->n_nodes == 0)
+        return NULL;
+
+    RuleMatch match = {};
+    match.set = set;
+    match.best_rule = set->n_rules;
+
+    Node* pending[1] = {node};
+    MatchDiscriminationNode(&match, 0, pending, 1, 0);
+
+    if (match.best_rule == set->n_rules)
+        return NULL;
+
+    const RewriteRule* rule = &set->rules[match.best_rule];
+    if (description != NULL)
+        *description = rule->description;
+
+    return InstantiateRule(rule, rule->rhs, match.bindings);
+}
+
+#include "DSL_undef.h"
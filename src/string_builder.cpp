@@ -0,0 +1,113 @@
+#include "string_builder.h"
+
+#include <assert.h>
+#include <string.h>
+#include <charconv>
+
+#include "tree_common.h"
+
+void InitStringBuilder(StringBuilder* builder)
+{
+    assert(builder);
+
+    builder->data     = NULL;
+    builder->length   = 0;
+    builder->capacity = 0;
+    builder->failed   = false;
+}
+
+void DestroyStringBuilder(StringBuilder* builder)
+{
+    if (builder == NULL)
+        return;
+
+    free(builder->data);
+    InitStringBuilder(builder);
+}
+
+// память остается за строкой, чтобы переиспользовать ее без новых выделений
+void ClearStringBuilder(StringBuilder* builder)
+{
+    assert(builder);
+
+    builder->length = 0;
+    builder->failed = false;
+    if (builder->data)
+        builder->data[0] = '\0';
+}
+
+TreeErrorType ReserveStringBuilder(StringBuilder* builder, size_t extra_length)
+{
+    assert(builder);
+
+    if (builder->failed)
+        return TREE_ERROR_ALLOCATION;
+
+    size_t required = builder->length + extra_length + 1;
+    if (required <= builder->capacity)
+        return TREE_ERROR_NO;
+
+    size_t new_capacity = (builder->capacity == 0) ? kStringBuilderInitialCapacity : builder->capacity;
+    while (new_capacity < required)
+        new_capacity *= 2;
+
+    char* new_data = (char*)realloc(builder->data, new_capacity);
+    if (!new_data)
+    {
+        builder->failed = true;
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    builder->data     = new_data;
+    builder->capacity = new_capacity;
+    return TREE_ERROR_NO;
+}
+
+void AppendChars(StringBuilder* builder, const char* chars, size_t length)
+{
+    assert(builder);
+    assert(chars);
+
+    if (ReserveStringBuilder(builder, length) != TREE_ERROR_NO)
+        return;
+
+    memcpy(builder->data + builder->length, chars, length);
+    builder->length += length;
+    builder->data[builder->length] = '\0';
+}
+
+void AppendString(StringBuilder* builder, const char* string)
+{
+    assert(string);
+
+    AppendChars(builder, string, strlen(string));
+}
+
+void AppendChar(StringBuilder* builder, char symbol)
+{
+    AppendChars(builder, &symbol, 1);
+}
+
+// кратчайшее представление, которое читается обратно в то же самое число
+void AppendDouble(StringBuilder* builder, double value)
+{
+    assert(builder);
+
+    if (ReserveStringBuilder(builder, kMaxDoubleTextLength) != TREE_ERROR_NO)
+        return;
+
+    char* begin = builder->data + builder->length;
+    std::to_chars_result written = std::to_chars(begin, begin + kMaxDoubleTextLength, value);
+    if (written.ec != std::errc())
+        return;
+
+    builder->length = (size_t)(written.ptr - builder->data);
+    builder->data[builder->length] = '\0';
+}
+
+const char* GetStringBuilderData(const StringBuilder* builder)
+{
+    assert(builder);
+
+    return (builder->data != NULL) ? builder->data : "";
+}
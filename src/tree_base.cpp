@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include "operations.h"
+#include "tree_traversal.h"
 
 TreeErrorType TreeCtor(Tree* tree)
 {
@@ -11,25 +13,219 @@ TreeErrorType TreeCtor(Tree* tree)
     tree->root = NULL;
     tree->size = 0;
     tree->file_buffer = NULL;
+    tree->post_order = NULL;
 
     return TREE_ERROR_NO;
 }
 
+// освобождение не должно зависеть от выделения памяти под стек, поэтому вместо обхода
+// левый ребенок поворотом поднимается на место узла; узел без левого ребенка удаляется
 void FreeNode(Node* node)
 {
-    if (node == NULL)
+    while (node != NULL)
+    {
+        if (node->left != NULL)
+        {
+            Node* left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+            continue;
+        }
+
+        Node* right = node->right;
+
+        if (node->type == NODE_VAR && node->data.var_definition.name != NULL)
+        {
+            if (!node->data.var_definition.is_view)
+                free(node->data.var_definition.name);
+            node->data.var_definition.name = NULL;
+        }
+
+        ClearTexCache(node);
+        if (node->block != NULL)
+            ReleaseNodeBlock(node->block);
+        else
+            free(node);
+
+        node = right;
+    }
+}
+
+// ==================== ЛИНЕАРИЗАЦИЯ ====================
+
+void SetTreeRoot(Tree* tree, Node* root)
+{
+    if (tree == NULL)
         return;
 
-    FreeNode(node->left);
-    FreeNode(node->right);
+    InvalidateTreePostOrder(tree);
+    tree->root = root;
+    tree->size = CountTreeNodes(root);
+}
+
+void InvalidateTreePostOrder(Tree* tree)
+{
+    if (tree == NULL)
+        return;
+
+    free(tree->post_order);
+    tree->post_order = NULL;
+}
+
+static TreeErrorType BuildTreePostOrder(Tree* tree)
+{
+    size_t capacity = (tree->size > 0) ? tree->size : kTraversalInitialDepth;
+    Node** nodes = (Node**)malloc(capacity * sizeof(Node*));
+
+    TreeTraversal traversal = {};
+    TreeErrorType error = nodes ? BeginTreeTraversal(&traversal, tree->root) : TREE_ERROR_ALLOCATION;
 
-    if (node -> type == NODE_VAR && node->data.var_definition.name != NULL)
+    size_t count = 0;
+    Node*  node  = NULL;
+    while (error == TREE_ERROR_NO && (node = NextPostOrderNode(&traversal)) != NULL)
     {
-        free(node->data.var_definition.name);
-        node->data.var_definition.name = NULL;
+        if (count == capacity)
+        {
+            Node** new_nodes = (Node**)realloc(nodes, capacity * 2 * sizeof(Node*));
+            if (!new_nodes)
+            {
+                error = TREE_ERROR_ALLOCATION;
+                break;
+            }
+
+            nodes = new_nodes;
+            capacity *= 2;
+        }
+
+        nodes[count++] = node;
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+
+    if (error != TREE_ERROR_NO)
+    {
+        free(nodes);
+        return error;
     }
 
-    free(node);
+    tree->post_order = nodes;
+    tree->size = count;
+    return TREE_ERROR_NO;
+}
+
+Node* const* GetTreePostOrder(Tree* tree)
+{
+    if (tree == NULL || tree->root == NULL)
+        return NULL;
+
+    // замена корня без InvalidateTreePostOrder видна по последнему элементу
+    if (tree->post_order != NULL && (tree->size == 0 || tree->post_order[tree->size - 1] != tree->root))
+        InvalidateTreePostOrder(tree);
+
+    if (tree->post_order == NULL && BuildTreePostOrder(tree) != TREE_ERROR_NO)
+        return NULL;
+
+    return tree->post_order;
+}
+
+// ==================== БЛОКИ УЗЛОВ ====================
+
+// узлы лежат сразу за заголовком; блок живет, пока есть ссылки
+struct NodeBlock {
+    size_t n_references;    // взятые и еще не освобожденные узлы и ссылка создателя
+    size_t n_taken;
+    size_t capacity;
+};
+
+static Node* GetBlockNodes(NodeBlock* block)
+{
+    return (Node*)(block + 1);
+}
+
+NodeBlock* CreateNodeBlock(size_t n_nodes)
+{
+    if (n_nodes == 0 || n_nodes > (SIZE_MAX - sizeof(NodeBlock)) / sizeof(Node))
+        return NULL;
+
+    NodeBlock* block = (NodeBlock*)malloc(sizeof(NodeBlock) + n_nodes * sizeof(Node));
+    if (!block)
+        return NULL;
+
+    block->n_references = 1;
+    block->n_taken      = 0;
+    block->capacity     = n_nodes;
+    return block;
+}
+
+Node* TakeBlockNode(NodeBlock* block)
+{
+    if (block == NULL || block->n_taken == block->capacity)
+        return NULL;
+
+    Node* node = &GetBlockNodes(block)[block->n_taken++];
+    memset(node, 0, sizeof(*node));
+    node->block = block;
+
+    __atomic_add_fetch(&block->n_references, 1, __ATOMIC_RELAXED);
+    return node;
+}
+
+// узлы одной копии могут освобождаться и потоками пакетного режима
+void ReleaseNodeBlock(NodeBlock* block)
+{
+    if (block != NULL && __atomic_sub_fetch(&block->n_references, 1, __ATOMIC_ACQ_REL) == 0)
+        free(block);
+}
+
+// ==================== КЕШ LATEX ====================
+
+// суммарный размер фрагментов во всех деревьях; узлы освобождаются и потоками пакетного режима
+static size_t tex_cache_bytes = 0;
+
+void ClearTexCache(Node* node)
+{
+    if (node == NULL || node->tex_cache == NULL)
+        return;
+
+    __atomic_fetch_sub(&tex_cache_bytes, node->tex_cache_length + 1, __ATOMIC_RELAXED);
+
+    free(node->tex_cache);
+    node->tex_cache = NULL;
+    node->tex_cache_length = 0;
+}
+
+// сверх kMaxTexCacheBytes фрагмент не запоминается: узел просто будет отрисован заново
+void StoreTexCache(Node* node, const char* fragment, size_t length)
+{
+    if (node == NULL || fragment == NULL || length > kMaxCachedTexFragmentLength)
+        return;
+
+    size_t reserved = __atomic_add_fetch(&tex_cache_bytes, length + 1, __ATOMIC_RELAXED);
+    char* copy = (reserved <= kMaxTexCacheBytes) ? (char*)malloc(length + 1) : NULL;
+    if (!copy)
+    {
+        __atomic_fetch_sub(&tex_cache_bytes, length + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    memcpy(copy, fragment, length);
+    copy[length] = '\0';
+
+    ClearTexCache(node);
+    node->tex_cache = copy;
+    node->tex_cache_length = length;
+}
+
+void CopyTexCache(Node* destination, const Node* source)
+{
+    if (destination == NULL || source == NULL || source->tex_cache == NULL)
+        return;
+
+    StoreTexCache(destination, source->tex_cache, source->tex_cache_length);
 }
 
 TreeErrorType TreeDtor(Tree* tree)
@@ -40,6 +236,7 @@ TreeErrorType TreeDtor(Tree* tree)
     FreeNode(tree->root);
     tree->root = NULL;
     tree->size = 0;
+    InvalidateTreePostOrder(tree);
 
     if (tree->file_buffer != NULL)
     {
@@ -59,3 +256,11 @@ unsigned int ComputeHash(const char* str) //djb2
         hash = ((hash << 5) + hash) + (unsigned char)c; //умножаем на 33 без умножения
     return hash;
 }
+
+unsigned int ComputeHashOfSpan(const char* str, size_t length) //djb2 для строки без '\0' на конце
+{
+    unsigned int hash = 5381;
+    for (size_t i = 0; i < length; i++)
+        hash = ((hash << 5) + hash) + (unsigned char)str[i];
+    return hash;
+}
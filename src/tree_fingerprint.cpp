@@ -0,0 +1,330 @@
+#include "tree_fingerprint.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "compact_tree.h"
+#include "logic_functions.h"
+
+static const uint64_t kNoResidue = UINT64_MAX;
+
+// ==================== ТОЧКИ ====================
+
+static uint64_t MixFingerprintBits(uint64_t bits)
+{
+    bits += 0x9E3779B97F4A7C15ULL;
+    bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBULL;
+    return bits ^ (bits >> 31);
+}
+
+static uint64_t HashVariableName(const char* name)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const char* c = name; *c != '\0'; c++)
+        hash = (hash ^ (unsigned char)*c) * 0x100000001B3ULL;
+
+    return hash;
+}
+
+static double PointValue(uint64_t seed)
+{
+    double unit = (double)(MixFingerprintBits(seed) >> 11) * 0x1.0p-53;
+    return kFingerprintMinValue + (kFingerprintMaxValue - kFingerprintMinValue) * unit;
+}
+
+static uint64_t PointResidue(uint64_t seed)
+{
+    return MixFingerprintBits(~seed) % kFingerprintModulus;
+}
+
+// ==================== АРИФМЕТИКА ПО МОДУЛЮ 2^61 - 1 ====================
+
+static uint64_t AddMod(uint64_t a, uint64_t b)
+{
+    uint64_t sum = a + b;
+    return (sum >= kFingerprintModulus) ? sum - kFingerprintModulus : sum;
+}
+
+static uint64_t SubMod(uint64_t a, uint64_t b)
+{
+    return (a >= b) ? a - b : a + kFingerprintModulus - b;
+}
+
+// 2^61 = 1 по модулю, поэтому старшие биты произведения складываются с младшими
+static uint64_t MulMod(uint64_t a, uint64_t b)
+{
+    unsigned __int128 product = (unsigned __int128)a * b;
+    uint64_t result = (uint64_t)(product & kFingerprintModulus) + (uint64_t)(product >> 61);
+    while (result >= kFingerprintModulus)
+        result -= kFingerprintModulus;
+
+    return result;
+}
+
+static uint64_t PowMod(uint64_t base, uint64_t exponent)
+{
+    uint64_t result = 1;
+    while (exponent > 0)
+    {
+        if (exponent & 1)
+            result = MulMod(result, base);
+        base = MulMod(base, base);
+        exponent >>= 1;
+    }
+
+    return result;
+}
+
+// малая теорема Ферма; у нуля обратного нет
+static uint64_t InverseMod(uint64_t value)
+{
+    return (value == 0) ? kNoResidue : PowMod(value, kFingerprintModulus - 2);
+}
+
+// вычет есть только у целых чисел, точно представимых в double
+static bool ConstantResidue(double value, uint64_t* residue)
+{
+    if (!(fabs(value) < 0x1.0p53) || !is_zero(value - floor(value)))
+        return false;
+
+    uint64_t magnitude = (uint64_t)fabs(value) % kFingerprintModulus;
+    *residue = (value < 0) ? SubMod(0, magnitude) : magnitude;
+    return true;
+}
+
+// ==================== ВЫЧИСЛЕНИЕ ПО МОДУЛЮ ====================
+
+// сложение, вычитание, умножение, деление и целые степени с числовым показателем
+static bool HasResidues(const CompactTree* tree)
+{
+    for (uint32_t i = 0; i < tree->n_nodes; i++)
+    {
+        const CompactNode* node = &tree->nodes[i];
+        uint64_t residue = 0;
+
+        switch (node->code)
+        {
+            case COMPACT_VAR:
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+                break;
+
+            case COMPACT_NUM:
+                if (!ConstantResidue(tree->constants[node->value], &residue))
+                    return false;
+                break;
+
+            case OP_POW:
+                if (tree->nodes[node->right].code != COMPACT_NUM)
+                    return false;
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static uint64_t EvaluateResidueNode(const CompactTree* tree, const CompactNode* node, const uint64_t* results,
+                                    const uint64_t* variables)
+{
+    if (node->code == COMPACT_VAR)
+        return variables[node->value];
+
+    if (node->code == COMPACT_NUM)
+    {
+        uint64_t residue = 0;
+        ConstantResidue(tree->constants[node->value], &residue);
+        return residue;
+    }
+
+    uint64_t left  = results[node->left];
+    uint64_t right = results[node->right];
+    if (left == kNoResidue || (right == kNoResidue && node->code != OP_POW))
+        return kNoResidue;
+
+    switch (node->code)
+    {
+        case OP_ADD: return AddMod(left, right);
+        case OP_SUB: return SubMod(left, right);
+        case OP_MUL: return MulMod(left, right);
+
+        case OP_DIV:
+        {
+            uint64_t inverse = InverseMod(right);
+            return (inverse == kNoResidue) ? kNoResidue : MulMod(left, inverse);
+        }
+
+        case OP_POW:
+        {
+            double exponent = tree->constants[tree->nodes[node->right].value];
+            uint64_t power = PowMod(left, (uint64_t)fabs(exponent));
+            return (exponent < 0) ? InverseMod(power) : power;
+        }
+
+        default:
+            return kNoResidue;
+    }
+}
+
+// ==================== ОТПЕЧАТОК ====================
+
+TreeErrorType ComputeTreeFingerprint(Tree* tree, VariableTable* var_table, TreeFingerprint* fingerprint)
+{
+    if (tree == NULL || var_table == NULL || fingerprint == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(fingerprint, 0, sizeof(*fingerprint));
+
+    CompactTree compact = {};
+    TreeErrorType error = BuildCompactTree(tree->root, var_table, &compact);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    fingerprint->has_residues = HasResidues(&compact);
+
+    uint64_t* residues = NULL;
+    if (fingerprint->has_residues)
+    {
+        residues = (uint64_t*)calloc(compact.n_nodes, sizeof(uint64_t));
+        if (!residues)
+        {
+            DestroyCompactTree(&compact);
+            return TREE_ERROR_ALLOCATION;
+        }
+    }
+
+    double   values          [kMaxNOfVariables] = {};
+    uint64_t variable_residues[kMaxNOfVariables] = {};
+
+    for (int point = 0; point < kFingerprintPoints && error == TREE_ERROR_NO; point++)
+    {
+        for (int i = 0; i < var_table->number_of_variables; i++)
+        {
+            uint64_t seed = HashVariableName(var_table->variables[i].name) ^ MixFingerprintBits((uint64_t)point);
+            values[i]            = PointValue(seed);
+            variable_residues[i] = PointResidue(seed);
+        }
+
+        double value = 0.0;
+        error = EvaluateCompactTree(&compact, values, &value);
+        if (error == TREE_ERROR_ALLOCATION)
+            break;
+
+        // вне области определения отпечаток запоминает только сам факт
+        fingerprint->values[point] = (error == TREE_ERROR_NO && isfinite(value)) ? value : NAN;
+        error = TREE_ERROR_NO;
+
+        if (residues != NULL)
+        {
+            for (uint32_t i = 0; i < compact.n_nodes; i++)
+                residues[i] = EvaluateResidueNode(&compact, &compact.nodes[i], residues, variable_residues);
+
+            fingerprint->residues[point] = residues[compact.n_nodes - 1];
+        }
+    }
+
+    for (int point = 0; point < kFingerprintPoints; point++)
+    {
+        bool is_defined = fingerprint->has_residues ? fingerprint->residues[point] != kNoResidue
+                                                    : !isnan(fingerprint->values[point]);
+        fingerprint->defined_count += is_defined;
+    }
+
+    free(residues);
+    DestroyCompactTree(&compact);
+    return error;
+}
+
+static bool FingerprintValuesEqual(double first, double second)
+{
+    double scale = fmax(fabs(first), fabs(second));
+    return fabs(first - second) <= kFingerprintTolerance * scale + kFingerprintAbsoluteTolerance;
+}
+
+bool FingerprintsProbablyEqual(const TreeFingerprint* first, const TreeFingerprint* second)
+{
+    assert(first);
+    assert(second);
+
+    // деление на ноль по модулю - та же точка вне области определения, что и NaN
+    if (first->has_residues && second->has_residues)
+    {
+        int n_defined_residues = 0;
+        for (int point = 0; point < kFingerprintPoints; point++)
+        {
+            bool is_first_defined  = (first->residues[point]  != kNoResidue);
+            bool is_second_defined = (second->residues[point] != kNoResidue);
+
+            if (is_first_defined != is_second_defined)
+                return false;
+
+            if (!is_first_defined)
+                continue;
+
+            if (first->residues[point] != second->residues[point])
+                return false;
+
+            n_defined_residues++;
+        }
+
+        return n_defined_residues > 0;
+    }
+
+    int n_defined = 0;
+    for (int point = 0; point < kFingerprintPoints; point++)
+    {
+        bool is_first_defined  = !isnan(first->values[point]);
+        bool is_second_defined = !isnan(second->values[point]);
+
+        if (is_first_defined != is_second_defined)
+            return false;
+
+        if (!is_first_defined)
+            continue;
+
+        if (!FingerprintValuesEqual(first->values[point], second->values[point]))
+            return false;
+
+        n_defined++;
+    }
+
+    return n_defined > 0;
+}
+
+// в ключ входят и точки вне области определения: у равных отпечатков они совпадают
+uint64_t HashFingerprintResidues(const TreeFingerprint* fingerprint)
+{
+    assert(fingerprint);
+
+    uint64_t hash = 0;
+    for (int point = 0; point < kFingerprintPoints; point++)
+        hash = MixFingerprintBits(hash ^ fingerprint->residues[point]);
+
+    return hash;
+}
+
+TreeErrorType TreesProbablyEqual(Tree* first, Tree* second, VariableTable* var_table, bool* is_equal)
+{
+    if (first == NULL || second == NULL || var_table == NULL || is_equal == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    TreeFingerprint first_fingerprint = {};
+    TreeErrorType error = ComputeTreeFingerprint(first, var_table, &first_fingerprint);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    TreeFingerprint second_fingerprint = {};
+    error = ComputeTreeFingerprint(second, var_table, &second_fingerprint);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    *is_equal = FingerprintsProbablyEqual(&first_fingerprint, &second_fingerprint);
+    return TREE_ERROR_NO;
+}
@@ -0,0 +1,656 @@
+#include "tree_serialize.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree_base.h"
+#include "operations.h"
+#include "logic_functions.h"
+#include "io_diff.h"
+#include "tree_traversal.h"
+
+const unsigned char kOpcodeNull = 0;
+
+typedef struct {
+    unsigned char* data;
+    size_t         size;
+    size_t         capacity;
+    bool           failed;
+} ByteWriter;
+
+typedef struct {
+    const unsigned char* data;
+    size_t               size;
+    size_t               pos;
+    bool                 failed;
+} ByteReader;
+
+typedef struct {
+    const char* names[kMaxNOfVariables];
+    int         count;
+    bool        overflow;
+} SymbolList;
+
+// ==================== ЗАПИСЬ ====================
+
+static void WriteBytes(ByteWriter* writer, const void* bytes, size_t n_bytes)
+{
+    if (writer->failed)
+        return;
+
+    if (writer->size + n_bytes > writer->capacity)
+    {
+        size_t new_capacity = (writer->capacity == 0) ? 256 : writer->capacity;
+        while (new_capacity < writer->size + n_bytes)
+            new_capacity *= 2;
+
+        unsigned char* new_data = (unsigned char*)realloc(writer->data, new_capacity);
+        if (!new_data)
+        {
+            writer->failed = true;
+            return;
+        }
+
+        writer->data = new_data;
+        writer->capacity = new_capacity;
+    }
+
+    memcpy(writer->data + writer->size, bytes, n_bytes);
+    writer->size += n_bytes;
+}
+
+static void WriteByte(ByteWriter* writer, unsigned char byte)
+{
+    WriteBytes(writer, &byte, 1);
+}
+
+static void WriteUint16(ByteWriter* writer, unsigned int value)
+{
+    WriteByte(writer, (unsigned char)(value & 0xFF));
+    WriteByte(writer, (unsigned char)((value >> 8) & 0xFF));
+}
+
+static void WriteVarint(ByteWriter* writer, size_t value)
+{
+    while (value >= 0x80)
+    {
+        WriteByte(writer, (unsigned char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    WriteByte(writer, (unsigned char)value);
+}
+
+static void WriteDouble(ByteWriter* writer, double value)
+{
+    WriteBytes(writer, &value, sizeof(value)); // формат рассчитан на little-endian машины
+}
+
+static int FindSymbol(SymbolList* symbols, const char* name)
+{
+    for (int i = 0; i < symbols->count; i++)
+    {
+        if (strcmp(symbols->names[i], name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static TreeErrorType CollectSymbols(Node* root, SymbolList* symbols)
+{
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, root);
+
+    Node* node = NULL;
+    while (error == TREE_ERROR_NO && (node = NextPreOrderNode(&traversal)) != NULL)
+    {
+        if (node->type == NODE_VAR && node->data.var_definition.name != NULL &&
+            FindSymbol(symbols, node->data.var_definition.name) == -1)
+        {
+            if (symbols->count >= kMaxNOfVariables)
+                symbols->overflow = true;
+            else
+                symbols->names[symbols->count++] = node->data.var_definition.name;
+        }
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+    return error;
+}
+
+static void WriteSingleNode(ByteWriter* writer, Node* node, SymbolList* symbols)
+{
+    switch (node->type)
+    {
+        case NODE_NUM:
+            WriteByte(writer, kOpcodeNum);
+            WriteDouble(writer, node->data.num_value);
+            break;
+
+        case NODE_VAR:
+            WriteByte(writer, kOpcodeVar);
+            WriteVarint(writer, (size_t)FindSymbol(symbols, node->data.var_definition.name ?
+                                                            node->data.var_definition.name : "?"));
+            break;
+
+        case NODE_OP:
+            WriteByte(writer, (unsigned char)(kOpcodeOperationBase + (unsigned char)node->data.op_value));
+            break;
+
+        default:
+            writer->failed = true;
+            break;
+    }
+}
+
+// левый ребенок унарной операции не пишется; отсутствующий аргумент - kOpcodeNull
+// на BETWEEN (левый) или LEAVE (правый), то есть на своем месте в прямом порядке
+static TreeErrorType WriteNodes(ByteWriter* writer, Node* root, SymbolList* symbols, size_t* n_nodes)
+{
+    TreeTraversal traversal = {};
+    TreeErrorType error = BeginTreeTraversal(&traversal, root);
+
+    TraversalFrame* frame = NULL;
+    while (error == TREE_ERROR_NO && (frame = NextTraversalFrame(&traversal)) != NULL)
+    {
+        Node* node = frame->node;
+        bool is_operation = (node->type == NODE_OP);
+
+        if (frame->event == TRAVERSAL_ENTER)
+        {
+            Node* parent = (traversal.depth > 1) ? traversal.frames[traversal.depth - 2].node : NULL;
+            if (parent != NULL && parent->left == node && !is_binary(parent->data.op_value))
+            {
+                SkipTraversalChildren(&traversal);
+                frame->mark = 1; // пропущенный узел не пишется и на LEAVE
+                continue;
+            }
+
+            WriteSingleNode(writer, node, symbols);
+            (*n_nodes)++;
+        }
+        else if (frame->event == TRAVERSAL_BETWEEN)
+        {
+            if (is_operation && is_binary(node->data.op_value) && node->left == NULL)
+                WriteByte(writer, kOpcodeNull);
+        }
+        else if (is_operation && frame->mark == 0 && node->right == NULL)
+        {
+            WriteByte(writer, kOpcodeNull);
+        }
+    }
+
+    if (error == TREE_ERROR_NO)
+        error = traversal.error;
+
+    EndTreeTraversal(&traversal);
+    return error;
+}
+
+static TreeErrorType WriteTree(ByteWriter* writer, Tree* tree)
+{
+    SymbolList symbols = {};
+    symbols.names[0] = "?";
+    symbols.count = 1; // символ 0 зарезервирован для безымянных переменных
+
+    TreeErrorType error = CollectSymbols(tree->root, &symbols);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    if (symbols.overflow)
+        return TREE_ERROR_VARIABLE_TABLE;
+
+    WriteVarint(writer, (size_t)symbols.count);
+    for (int i = 0; i < symbols.count; i++)
+    {
+        size_t length = strlen(symbols.names[i]);
+        WriteVarint(writer, length);
+        WriteBytes(writer, symbols.names[i], length);
+    }
+
+    // читатель требует точного числа узлов, поэтому оно берется из самой записи,
+    // а не из tree->size: узлы пишутся отдельно и подставляются после счетчика
+    ByteWriter nodes = {};
+    size_t n_nodes = 0;
+    error = WriteNodes(&nodes, tree->root, &symbols, &n_nodes);
+
+    WriteVarint(writer, n_nodes);
+    if (error == TREE_ERROR_NO && !nodes.failed && nodes.size > 0)
+        WriteBytes(writer, nodes.data, nodes.size);
+
+    free(nodes.data);
+
+    if (error == TREE_ERROR_NO && (nodes.failed || writer->failed))
+        error = TREE_ERROR_ALLOCATION;
+
+    return error;
+}
+
+TreeErrorType SerializeTrees(const char* label, Tree* trees, int n_trees, unsigned char** data, size_t* size)
+{
+    if (trees == NULL || data == NULL || size == NULL || n_trees < 0)
+        return TREE_ERROR_NULL_PTR;
+
+    ByteWriter writer = {};
+
+    WriteBytes(&writer, kTreeFileMagic, strlen(kTreeFileMagic));
+    WriteUint16(&writer, kTreeFileVersion);
+    WriteUint16(&writer, 0);
+
+    size_t label_length = label ? strlen(label) : 0;
+    WriteVarint(&writer, label_length);
+    if (label_length > 0)
+        WriteBytes(&writer, label, label_length);
+
+    WriteVarint(&writer, (size_t)n_trees);
+
+    TreeErrorType error = TREE_ERROR_NO;
+    for (int i = 0; i < n_trees && error == TREE_ERROR_NO; i++)
+        error = WriteTree(&writer, &trees[i]);
+
+    if (error == TREE_ERROR_NO && writer.failed)
+        error = TREE_ERROR_ALLOCATION;
+
+    if (error != TREE_ERROR_NO)
+    {
+        free(writer.data);
+        return error;
+    }
+
+    *data = writer.data;
+    *size = writer.size;
+    return TREE_ERROR_NO;
+}
+
+// ==================== ЧТЕНИЕ ====================
+
+static unsigned char ReadByte(ByteReader* reader)
+{
+    if (reader->failed || reader->pos >= reader->size)
+    {
+        reader->failed = true;
+        return 0;
+    }
+
+    return reader->data[reader->pos++];
+}
+
+static unsigned int ReadUint16(ByteReader* reader)
+{
+    unsigned int low  = ReadByte(reader);
+    unsigned int high = ReadByte(reader);
+    return low | (high << 8);
+}
+
+static size_t ReadVarint(ByteReader* reader)
+{
+    size_t value = 0;
+    unsigned int shift = 0;
+
+    while (!reader->failed)
+    {
+        unsigned char byte = ReadByte(reader);
+        if (shift >= sizeof(size_t) * 8)
+        {
+            reader->failed = true;
+            break;
+        }
+
+        value |= (size_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            break;
+        shift += 7;
+    }
+
+    return value;
+}
+
+static const unsigned char* ReadBytes(ByteReader* reader, size_t n_bytes)
+{
+    if (reader->failed || n_bytes > reader->size - reader->pos)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+
+    const unsigned char* bytes = reader->data + reader->pos;
+    reader->pos += n_bytes;
+    return bytes;
+}
+
+static double ReadDouble(ByteReader* reader)
+{
+    double value = 0.0;
+    const unsigned char* bytes = ReadBytes(reader, sizeof(value));
+    if (bytes)
+        memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// операция, у которой прочитаны еще не все аргументы
+typedef struct {
+    OperationType op;
+    Node*         left;
+    bool          has_left;     // у унарной операции левого аргумента в записи нет
+} PendingOperation;
+
+typedef struct {
+    PendingOperation* operations;
+    size_t            depth;
+    size_t            capacity;
+} PendingStack;
+
+static bool PushPendingOperation(PendingStack* stack, OperationType op)
+{
+    if (stack->depth == stack->capacity)
+    {
+        size_t new_capacity = (stack->capacity == 0) ? kTraversalInitialDepth : stack->capacity * 2;
+        PendingOperation* new_operations = (PendingOperation*)realloc(stack->operations,
+                                                                      new_capacity * sizeof(PendingOperation));
+        if (!new_operations)
+            return false;
+
+        stack->operations = new_operations;
+        stack->capacity   = new_capacity;
+    }
+
+    PendingOperation* pending = &stack->operations[stack->depth++];
+    pending->op       = op;
+    pending->left     = NULL;
+    pending->has_left = !is_binary(op);
+    return true;
+}
+
+// лист или NULL; операция кладется в стек и возвращает NULL с *is_operation = true
+static Node* ReadSingleNode(ByteReader* reader, char** symbols, size_t n_symbols, size_t* nodes_left,
+                            PendingStack* stack, bool* is_operation)
+{
+    *is_operation = false;
+
+    unsigned char opcode = ReadByte(reader);
+    if (reader->failed || opcode == kOpcodeNull)
+        return NULL;
+
+    if (*nodes_left == 0)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    (*nodes_left)--;
+
+    ValueOfTreeElement data = {};
+    Node* node = NULL;
+
+    if (opcode == kOpcodeNum)
+    {
+        data.num_value = ReadDouble(reader);
+        node = reader->failed ? NULL : CreateNode(NODE_NUM, data, NULL, NULL);
+    }
+    else if (opcode == kOpcodeVar)
+    {
+        size_t symbol = ReadVarint(reader);
+        if (reader->failed || symbol >= n_symbols)
+        {
+            reader->failed = true;
+            return NULL;
+        }
+
+        data.var_definition.name = symbols[symbol];
+        data.var_definition.is_view = true;
+        node = CreateNode(NODE_VAR, data, NULL, NULL);
+    }
+    else if (opcode >= kOpcodeOperationBase && opcode < kOpcodeOperationBase + OP_COUNT)
+    {
+        *is_operation = true;
+        if (!PushPendingOperation(stack, (OperationType)(opcode - kOpcodeOperationBase)))
+            reader->failed = true;
+        return NULL;
+    }
+
+    if (!node)
+        reader->failed = true;
+
+    return node;
+}
+
+// узлы в прямом порядке собираются со стеком незаконченных операций в куче,
+// поэтому глубина дерева из файла не ограничена стеком вызовов
+static Node* ReadNodes(ByteReader* reader, char** symbols, size_t n_symbols, size_t* nodes_left)
+{
+    PendingStack stack = {};
+    Node* root = NULL;
+    bool is_done = false;
+
+    while (!is_done && !reader->failed)
+    {
+        bool is_operation = false;
+        Node* child = ReadSingleNode(reader, symbols, n_symbols, nodes_left, &stack, &is_operation);
+        if (reader->failed || is_operation)
+            continue;
+
+        // готовый аргумент поднимается, пока завершает операции
+        while (true)
+        {
+            if (stack.depth == 0)
+            {
+                root = child;
+                is_done = true;
+                break;
+            }
+
+            PendingOperation* pending = &stack.operations[stack.depth - 1];
+            if (!pending->has_left)
+            {
+                pending->left     = child;
+                pending->has_left = true;
+                break;
+            }
+
+            ValueOfTreeElement data = {};
+            data.op_value = pending->op;
+            Node* node = CreateNode(NODE_OP, data, pending->left, child);
+            if (!node)
+            {
+                reader->failed = true;
+                FreeSubtree(child);
+                break;
+            }
+
+            stack.depth--;
+            child = node;
+        }
+    }
+
+    if (reader->failed)
+    {
+        for (size_t i = 0; i < stack.depth; i++)
+            FreeSubtree(stack.operations[i].left);
+        FreeSubtree(root);
+        root = NULL;
+    }
+
+    free(stack.operations);
+    return root;
+}
+
+static TreeErrorType ReadTree(ByteReader* reader, Tree* tree)
+{
+    size_t n_symbols = ReadVarint(reader);
+    if (reader->failed || n_symbols == 0 || n_symbols > (size_t)kMaxNOfVariables + 1)
+        return TREE_ERROR_FORMAT;
+
+    // имена переменных складываются в file_buffer дерева, узлы ссылаются на них
+    size_t symbols_start = reader->pos;
+    size_t buffer_size = 0;
+    for (size_t i = 0; i < n_symbols && !reader->failed; i++)
+    {
+        size_t length = ReadVarint(reader);
+        ReadBytes(reader, length);
+        buffer_size += length + 1;
+    }
+
+    if (reader->failed)
+        return TREE_ERROR_FORMAT;
+
+    char*  buffer  = (char*)calloc(buffer_size, sizeof(char));
+    char** symbols = (char**)calloc(n_symbols, sizeof(char*));
+    if (!buffer || !symbols)
+    {
+        free(buffer);
+        free(symbols);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    reader->pos = symbols_start;
+    size_t offset = 0;
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        size_t length = ReadVarint(reader);
+        const unsigned char* name = ReadBytes(reader, length);
+
+        memcpy(buffer + offset, name, length);
+        symbols[i] = buffer + offset;
+        offset += length + 1;
+    }
+
+    size_t n_nodes = ReadVarint(reader);
+    Node* root = NULL;
+    if (n_nodes > 0 && !reader->failed)
+        root = ReadNodes(reader, symbols, n_symbols, &n_nodes);
+
+    free(symbols);
+
+    if (reader->failed || n_nodes != 0)
+    {
+        FreeSubtree(root);
+        free(buffer);
+        return TREE_ERROR_FORMAT;
+    }
+
+    SetTreeRoot(tree, root);
+    tree->file_buffer = buffer;
+
+    return TREE_ERROR_NO;
+}
+
+TreeErrorType DeserializeTrees(const unsigned char* data, size_t size, char* label, size_t label_size,
+                               Tree* trees, int max_trees, int* n_trees)
+{
+    if (data == NULL || trees == NULL || n_trees == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    *n_trees = 0;
+    ByteReader reader = {data, size, 0, false};
+
+    const unsigned char* magic = ReadBytes(&reader, strlen(kTreeFileMagic));
+    if (!magic || memcmp(magic, kTreeFileMagic, strlen(kTreeFileMagic)) != 0)
+        return TREE_ERROR_FORMAT;
+
+    unsigned int version = ReadUint16(&reader);
+    ReadUint16(&reader); // флаги пока не используются
+    if (reader.failed || version != kTreeFileVersion)
+        return TREE_ERROR_FORMAT;
+
+    size_t label_length = ReadVarint(&reader);
+    const unsigned char* stored_label = ReadBytes(&reader, label_length);
+    if (reader.failed)
+        return TREE_ERROR_FORMAT;
+
+    if (label != NULL && label_size > 0)
+    {
+        if (label_length >= label_size)
+            return TREE_ERROR_FORMAT;
+
+        memcpy(label, stored_label, label_length);
+        label[label_length] = '\0';
+    }
+
+    size_t stored_trees = ReadVarint(&reader);
+    if (reader.failed || stored_trees > (size_t)max_trees)
+        return TREE_ERROR_FORMAT;
+
+    for (size_t i = 0; i < stored_trees; i++)
+    {
+        TreeCtor(&trees[i]);
+
+        TreeErrorType error = ReadTree(&reader, &trees[i]);
+        if (error != TREE_ERROR_NO)
+        {
+            for (size_t j = 0; j <= i; j++)
+                TreeDtor(&trees[j]);
+            return error;
+        }
+    }
+
+    *n_trees = (int)stored_trees;
+    return TREE_ERROR_NO;
+}
+
+bool TreesHaveSameStructure(Tree* first, Tree* second)
+{
+    unsigned char* first_data = NULL;
+    unsigned char* second_data = NULL;
+    size_t first_size = 0, second_size = 0;
+
+    bool same = SerializeTrees(NULL, first,  1, &first_data,  &first_size)  == TREE_ERROR_NO &&
+                SerializeTrees(NULL, second, 1, &second_data, &second_size) == TREE_ERROR_NO &&
+                first_size == second_size && memcmp(first_data, second_data, first_size) == 0;
+
+    free(first_data);
+    free(second_data);
+    return same;
+}
+
+// ==================== ФАЙЛЫ ====================
+
+TreeErrorType SaveTreesToFile(const char* filename, const char* label, Tree* trees, int n_trees)
+{
+    if (filename == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    unsigned char* data = NULL;
+    size_t size = 0;
+
+    TreeErrorType error = SerializeTrees(label, trees, n_trees, &data, &size);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        free(data);
+        return TREE_ERROR_OPENING_FILE;
+    }
+
+    size_t written = fwrite(data, 1, size, file);
+    int close_result = fclose(file);
+    free(data);
+
+    return (written == size && close_result == 0) ? TREE_ERROR_NO : TREE_ERROR_IO;
+}
+
+TreeErrorType LoadTreesFromFile(const char* filename, char* label, size_t label_size,
+                                Tree* trees, int max_trees, int* n_trees)
+{
+    if (filename == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    MappedFile mapped = {};
+    TreeErrorType error = MapInputFile(filename, &mapped);
+    if (error != TREE_ERROR_NO)
+        return error;
+
+    if (mapped.data == NULL)
+        return TREE_ERROR_FORMAT;
+
+    error = DeserializeTrees((const unsigned char*)mapped.data, mapped.size, label, label_size,
+                             trees, max_trees, n_trees);
+
+    UnmapInputFile(&mapped);
+    return error;
+}
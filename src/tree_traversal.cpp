@@ -0,0 +1,148 @@
+#include "tree_traversal.h"
+
+#include <assert.h>
+#include <string.h>
+
+// стадии кадра: событие ENTER, спуск влево, BETWEEN, спуск вправо, LEAVE
+enum {
+    TRAVERSAL_STAGE_ENTER,
+    TRAVERSAL_STAGE_LEFT,
+    TRAVERSAL_STAGE_BETWEEN,
+    TRAVERSAL_STAGE_RIGHT,
+    TRAVERSAL_STAGE_LEAVE
+};
+
+static bool PushTraversalFrame(TreeTraversal* traversal, Node* node)
+{
+    if (traversal->depth == traversal->capacity)
+    {
+        size_t new_capacity = (traversal->capacity == 0) ? kTraversalInitialDepth : traversal->capacity * 2;
+        TraversalFrame* new_frames = (TraversalFrame*)realloc(traversal->frames,
+                                                              new_capacity * sizeof(TraversalFrame));
+        if (!new_frames)
+        {
+            traversal->error = TREE_ERROR_ALLOCATION;
+            return false;
+        }
+
+        traversal->frames   = new_frames;
+        traversal->capacity = new_capacity;
+    }
+
+    TraversalFrame* frame = &traversal->frames[traversal->depth++];
+    memset(frame, 0, sizeof(*frame));
+    frame->node  = node;
+    frame->stage = TRAVERSAL_STAGE_ENTER;
+    return true;
+}
+
+TreeErrorType BeginTreeTraversal(TreeTraversal* traversal, Node* root)
+{
+    if (traversal == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    memset(traversal, 0, sizeof(*traversal));
+    traversal->error = TREE_ERROR_NO;
+
+    if (root != NULL && !PushTraversalFrame(traversal, root))
+        return TREE_ERROR_ALLOCATION;
+
+    return TREE_ERROR_NO;
+}
+
+void EndTreeTraversal(TreeTraversal* traversal)
+{
+    if (traversal == NULL)
+        return;
+
+    free(traversal->frames);
+    traversal->frames   = NULL;
+    traversal->depth    = 0;
+    traversal->capacity = 0;
+}
+
+TraversalFrame* NextTraversalFrame(TreeTraversal* traversal)
+{
+    assert(traversal);
+
+    if (traversal->is_leaving)
+    {
+        traversal->depth--;
+        traversal->is_leaving = false;
+    }
+
+    while (traversal->depth > 0 && traversal->error == TREE_ERROR_NO)
+    {
+        TraversalFrame* frame = &traversal->frames[traversal->depth - 1];
+        Node* node = frame->node;
+
+        switch (frame->stage++)
+        {
+            case TRAVERSAL_STAGE_ENTER:
+                frame->event = TRAVERSAL_ENTER;
+                return frame;
+
+            // после Push кадр может переехать, поэтому frame дальше не используется
+            case TRAVERSAL_STAGE_LEFT:
+                if (node->left != NULL && !PushTraversalFrame(traversal, node->left))
+                    return NULL;
+                break;
+
+            case TRAVERSAL_STAGE_BETWEEN:
+                frame->event = TRAVERSAL_BETWEEN;
+                return frame;
+
+            case TRAVERSAL_STAGE_RIGHT:
+                if (node->right != NULL && !PushTraversalFrame(traversal, node->right))
+                    return NULL;
+                break;
+
+            default:
+                frame->event = TRAVERSAL_LEAVE;
+                traversal->is_leaving = true;
+                return frame;
+        }
+    }
+
+    return NULL;
+}
+
+void SkipTraversalChildren(TreeTraversal* traversal)
+{
+    assert(traversal);
+
+    if (traversal->depth > 0)
+        traversal->frames[traversal->depth - 1].stage = TRAVERSAL_STAGE_LEAVE;
+}
+
+TraversalResult* TraversalResultSlot(TreeTraversal* traversal)
+{
+    assert(traversal);
+
+    if (traversal->depth < 2)
+        return &traversal->result;
+
+    // родитель уже сдвинулся на стадию после спуска в текущего ребенка
+    TraversalFrame* parent = &traversal->frames[traversal->depth - 2];
+    return (parent->stage == TRAVERSAL_STAGE_BETWEEN) ? &parent->left_result : &parent->right_result;
+}
+
+Node* NextPreOrderNode(TreeTraversal* traversal)
+{
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(traversal)) != NULL)
+        if (frame->event == TRAVERSAL_ENTER)
+            return frame->node;
+
+    return NULL;
+}
+
+Node* NextPostOrderNode(TreeTraversal* traversal)
+{
+    TraversalFrame* frame = NULL;
+    while ((frame = NextTraversalFrame(traversal)) != NULL)
+        if (frame->event == TRAVERSAL_LEAVE)
+            return frame->node;
+
+    return NULL;
+}
@@ -2,13 +2,176 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
 #include "tree_error_types.h"
 
+// число целиком, без хвоста и в пределах [min_value, max_value]
+static bool ParseIntegerOption(const char* text, long min_value, long max_value, long* value)
+{
+    char* end = NULL;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < min_value || parsed > max_value)
+        return false;
+
+    *value = parsed;
+    return true;
+}
+
+TreeErrorType ParseProgramOptions(int argc, const char** argv, ProgramOptions* options)
+{
+    assert(argv);
+    assert(options);
+
+    options->input_filename = kDefaultDataBaseFilename;
+    options->batch_mode     = false;
+    options->n_threads      = 0;
+    options->group_equivalent = false;
+    options->derivatives_filename = NULL;
+    options->cache_directory = NULL;
+    options->cache_max_bytes = kDefaultCacheMaxBytes;
+    options->plot_mode       = PLOT_MODE_EXPRESSION;
+    options->adaptive_plot   = false;
+    options->measure_costs   = false;
+    options->value_sweep     = false;
+    options->verify_optimization = false;
+    options->optimization_level = OPTIMIZATION_LEVEL_PASSES;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--batch") == 0)
+        {
+            options->batch_mode = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            if (i + 1 >= argc)
+                return TREE_ERROR_INVALID_INPUT;
+
+            long n_threads = 0;
+            if (!ParseIntegerOption(argv[++i], 1, kMaxBatchThreads, &n_threads))
+                return TREE_ERROR_INVALID_INPUT;
+
+            options->n_threads = (int)n_threads;
+        }
+        else if (strcmp(argv[i], "--group-equivalent") == 0)
+        {
+            options->batch_mode       = true;
+            options->group_equivalent = true;
+        }
+        else if (strcmp(argv[i], "--derivatives") == 0)
+        {
+            if (i + 1 >= argc)
+                return TREE_ERROR_INVALID_INPUT;
+
+            options->derivatives_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-dir") == 0)
+        {
+            if (i + 1 >= argc)
+                return TREE_ERROR_INVALID_INPUT;
+
+            options->cache_directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-size") == 0)
+        {
+            if (i + 1 >= argc)
+                return TREE_ERROR_INVALID_INPUT;
+
+            // больше SIZE_MAX / 2^20 мегабайт переполнит size_t при переводе в байты
+            long megabytes = 0;
+            if (!ParseIntegerOption(argv[++i], 1, (long)(SIZE_MAX / (1024 * 1024)), &megabytes))
+                return TREE_ERROR_INVALID_INPUT;
+
+            options->cache_max_bytes = (size_t)megabytes * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--plot-mode") == 0)
+        {
+            if (i + 1 >= argc)
+                return TREE_ERROR_INVALID_INPUT;
+
+            const char* mode = argv[++i];
+            if      (strcmp(mode, "expression") == 0) options->plot_mode = PLOT_MODE_EXPRESSION;
+            else if (strcmp(mode, "table")      == 0) options->plot_mode = PLOT_MODE_TABLE;
+            else if (strcmp(mode, "dat")        == 0) options->plot_mode = PLOT_MODE_DATA_FILE;
+            else
+                return TREE_ERROR_INVALID_INPUT;
+        }
+        else if (strcmp(argv[i], "--adaptive-plot") == 0)
+        {
+            options->adaptive_plot = true;
+        }
+        else if (strcmp(argv[i], "--measure-costs") == 0)
+        {
+            options->measure_costs = true;
+        }
+        else if (strcmp(argv[i], "--sweep") == 0)
+        {
+            options->value_sweep = true;
+        }
+        else if (strcmp(argv[i], "--verify-opt") == 0)
+        {
+            options->verify_optimization = true;
+        }
+        else if (strcmp(argv[i], "--opt-level") == 0)
+        {
+            if (i + 1 >= argc)
+                return TREE_ERROR_INVALID_INPUT;
+
+            long level = 0;
+            if (!ParseIntegerOption(argv[++i], OPTIMIZATION_LEVEL_NONE, OPTIMIZATION_LEVEL_SATURATION, &level))
+                return TREE_ERROR_INVALID_INPUT;
+
+            options->optimization_level = (OptimizationLevel)level;
+        }
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            return TREE_ERROR_INVALID_INPUT;
+        }
+        else
+        {
+            options->input_filename = argv[i];
+        }
+    }
+
+    // адаптивную сетку pdflatex не построит, координаты нужно считать самим
+    if (options->adaptive_plot && options->plot_mode == PLOT_MODE_EXPRESSION)
+        options->plot_mode = PLOT_MODE_TABLE;
+
+    return TREE_ERROR_NO;
+}
+
+void PrintUsage(const char* program_name)
+{
+    printf("Usage: %s [options] [file]\n", program_name);
+    printf("  --batch        file contains many expressions separated by newlines or '$'\n");
+    printf("  --threads N    number of parser threads in batch mode (default: all cores)\n");
+    printf("  --group-equivalent  batch mode that groups expressions equal at random test points\n");
+    printf("  --derivatives F  load derivatives from binary file F, or save them there if absent\n");
+    printf("  --cache-dir D    share computed derivatives between runs through cache directory D\n");
+    printf("  --cache-size MB  cache size limit, least recently used entries are evicted (default: 64)\n");
+    printf("  --plot-mode M    expression (pdflatex samples f), table (inline coordinates of f and\n"
+           "                   its derivatives) or dat (coordinates in %s)\n", kPlotDataFilename);
+    printf("  --adaptive-plot  refine the plot grid where the curve bends, implies table mode\n");
+    printf("  --measure-costs  benchmark every operation relative to addition and exit\n");
+    printf("  --sweep          after the report read \"variable value\" lines and re-evaluate f and its\n"
+           "                   derivatives, recomputing only the nodes that depend on the changed variable\n");
+    printf("  --opt-level N    0 - no simplification, 1 - rewrite passes (default),\n"
+           "                   2 - passes followed by equality saturation\n");
+    printf("  --verify-opt     compare every optimized tree with the original at random test points\n");
+}
+
 const char* GetDataBaseFilename(int argc, const char** argv)
 {
     assert(argv);
 
-    return (argc < 2) ? kDefaultDataBaseFilename : argv[1];
+    ProgramOptions options = {};
+    if (ParseProgramOptions(argc, argv, &options) != TREE_ERROR_NO)
+        return NULL;
+
+    return options.input_filename;
 }
 
 
@@ -0,0 +1,21 @@
+# Приведение к канонической форме: подобные слагаемые и одинаковые множители
+# собираются, полюса сохраняются, перестановка без выигрыша не считается шагом.
+
+optimize()
+{
+    printf '%s$\n' "$1" > expr.txt
+    echo "$1"
+    printf '0.7\n2\n1\n' | "$DEREVO" --opt-level 1 --verify-opt --plot-mode dat expr.txt |
+        grep -E 'Optimization:|Function:' | sed 's/^/  /'
+    # --verify-opt сравнивает каждое оптимизированное дерево (f и производные) с исходным
+    echo "  differences at test points: $(grep -c 'optimized expression differs' full_analysis.tex)"
+}
+
+optimize "x+x+3*x-2*x"
+optimize "x*y+y*x-2*y*x+x^2*x"
+optimize "2*x*y*x-x^2*y+y*x*x"
+optimize "x/x+y-y"
+optimize "x/(x*y)*y"
+optimize "sin(x)+y+2*sin(x)-y"
+optimize "x^2*x^3/x^4"
+optimize "x+y"
@@ -0,0 +1,72 @@
+# Значения графика (скомпилированное дерево с отсечением областей определения,
+# full_analysis_plot.dat) должны совпадать с поузловым вычислением по дереву
+# (--sweep) в каждой точке сетки, включая точки вне области определения.
+# Шаг сетки 0.125 точно представим, поэтому обе стороны видят одинаковые x.
+
+x_min=-2
+x_max=2
+n_points=33
+
+check()
+{
+    printf '%s$\n' "$1" > expr.txt
+
+    {
+        printf '%s\n1\n%s %s\n%s\n' "$2" $x_min $x_max $n_points
+        awk -v a=$x_min -v b=$x_max -v n=$n_points \
+            'BEGIN { for (i = 0; i < n; i++) printf "x %.17g\n", a + (b - a) / (n - 1) * i }'
+    } | "$DEREVO" --plot-mode dat --sweep expr.txt | grep '^x = ' > sweep.txt
+
+    # строка sweep: "x = X: f = V f^(1) = V f^(2) undefined ... (recomputed ...)"
+    awk '
+        NR == FNR {
+            n = 0
+            for (i = 3; i <= NF && $i != "(recomputed"; i++)
+            {
+                if ($i == "undefined")
+                    tree[FNR, n++] = "nan"
+                else if ($i == "=")
+                    tree[FNR, n++] = $(++i)
+            }
+            n_values = n
+            next
+        }
+        FNR == 1 { next }
+        {
+            point = FNR - 1
+            for (k = 0; k < n_values; k++)
+            {
+                plot = $(k + 2)
+                value = tree[point, k]
+                if (plot == "nan" || value == "nan")
+                    agree = (plot == value)
+                else
+                {
+                    difference = plot - value
+                    if (difference < 0)
+                        difference = -difference
+                    scale = (value < 0) ? -value : value
+                    agree = (difference <= 1e-6 + 1e-9 * scale)
+                }
+
+                n_checked++
+                if (value == "nan")
+                    n_undefined++
+                if (!agree)
+                    printf "  mismatch at x = %s, d%d: plot %s, tree %s\n", $1, k, plot, value
+                else
+                    n_agreed++
+            }
+        }
+        END { printf "  %d of %d values agree, %d undefined\n", n_agreed, n_checked, n_undefined }
+    ' sweep.txt full_analysis_plot.dat
+}
+
+echo "ln(x)+sqrt(1-x^2)+x^3*cos(x)"
+check "ln(x)+sqrt(1-x^2)+x^3*cos(x)" 0.3
+echo "1/(x-0.5)+tan(x)"
+check "1/(x-0.5)+tan(x)" 0.3
+echo "exp(x)*sin(2*x)-x^5/3+arcsin(x/2)"
+check "exp(x)*sin(2*x)-x^5/3+arcsin(x/2)" 0.3
+echo "(x+3)^x+sinh(x)*cosh(x)"
+check "(x+3)^x+sinh(x)*cosh(x)" 0.3
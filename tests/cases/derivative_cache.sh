@@ -0,0 +1,45 @@
+# Кэш производных (--cache-dir): повторный запуск берёт производные из кэша,
+# ключ учитывает переменную и уровень оптимизации, испорченные записи
+# пересчитываются, при переполнении удаляются давно не использованные записи.
+
+run()
+{
+    printf '0.7\n2\n%s\n' "$1" | "$DEREVO" --plot-mode dat --cache-dir cache "${@:2}" expr.txt |
+        grep -E 'Calculation result|Derivative|cache' | sed 's/^.*(1-[0-9]*): //'
+    echo "cache hits: $(grep -c 'Loaded from derivative cache' full_analysis.tex)," \
+         "entries: $(ls cache | grep -c '\.dtre$')"
+}
+
+printf 'sin(x)*x^3+ln(y+2)/x$\n' > expr.txt
+
+echo "== cold"
+run 1
+grep "f'" full_analysis.tex > computed.tex
+echo "== warm"
+run 1
+grep "f'" full_analysis.tex | cmp -s computed.tex - && echo "derivative formulas identical" ||
+    echo "derivative formulas differ"
+
+echo "== another variable"
+run 2
+echo "== another optimization level"
+run 1 --opt-level 2
+run 1 --opt-level 2
+
+echo "== damaged entries"
+for entry in cache/*.dtre; do
+    head -c 16 "$entry" > damaged && mv damaged "$entry"
+done
+run 1
+run 1
+
+echo "== eviction"
+head -c 1048576 /dev/zero > cache/0000000000000000.dtre
+touch -d '2000-01-01' cache/0000000000000000.dtre
+run 2 --opt-level 2 --cache-size 1
+[ -e cache/0000000000000000.dtre ] && echo "stale entry kept" || echo "stale entry evicted"
+
+echo "== unusable directory"
+rm -rf cache
+touch cache
+run 1
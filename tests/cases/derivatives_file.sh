@@ -0,0 +1,32 @@
+# Сохранение и загрузка производных (--derivatives): второй запуск должен прочитать
+# файл и выдать те же значения, чужой или обрезанный файл пересчитывается.
+
+run()
+{
+    printf '0.7\n2\n%s\n' "$2" | "$DEREVO" --plot-mode dat --derivatives "$1" "$3" |
+        grep -E 'Calculation result|Derivative|derivatives' | sed 's/^.*(1-[0-9]*): //'
+}
+
+printf 'sin(x)*x^3+ln(y+2)/x$\n' > expr.txt
+printf 'cos(x)$\n' > other.txt
+
+echo "== save"
+run saved.bin 1 expr.txt
+grep "f'" full_analysis.tex > computed.tex
+echo "== load"
+run saved.bin 1 expr.txt
+# загруженные деревья должны печататься в отчёт так же, как вычисленные
+grep "f'" full_analysis.tex | cmp -s computed.tex - && echo "derivative formulas identical" ||
+    echo "derivative formulas differ"
+echo "== load, second variable"
+run saved_y.bin 2 expr.txt
+run saved_y.bin 2 expr.txt
+
+echo "== another expression"
+cp saved.bin foreign.bin
+run foreign.bin 1 other.txt
+
+echo "== truncated file"
+head -c 40 saved.bin > truncated.bin
+run truncated.bin 1 expr.txt
+run truncated.bin 1 expr.txt
@@ -0,0 +1,19 @@
+# Насыщение равенствами (--opt-level 2) находит упрощения, недоступные
+# последовательным проходам уровня 1.
+
+optimize()
+{
+    printf '%s$\n' "$1" > expr.txt
+    echo "$1"
+    printf '0.7\n2\n1\n' | "$DEREVO" --opt-level 2 --verify-opt --plot-mode dat expr.txt |
+        grep -E 'Optimization:|Function:' | sed 's/^/  /'
+    # --verify-opt сравнивает каждое оптимизированное дерево (f и производные) с исходным
+    echo "  differences at test points: $(grep -c 'optimized expression differs' full_analysis.tex)"
+}
+
+optimize "sin(x)^2+cos(x)^2+ln(exp(x))"
+optimize "exp(ln(x))+x*0+y^1"
+optimize "(x+1)*(x+1)-x^2-2*x"
+optimize "x*y+x*z"
+optimize "5*x^4+3*x^3-2*x^2+x-7"
+optimize "sqrt(x^2)*1+0"
@@ -0,0 +1,20 @@
+# Схема Горнера для сумм одночленов от одной переменной, остальные выражения
+# остаются без изменений.
+
+optimize()
+{
+    printf '%s$\n' "$1" > expr.txt
+    echo "$1"
+    printf '0.7\n2\n1\n' | "$DEREVO" --opt-level 1 --verify-opt --plot-mode dat expr.txt |
+        grep -E 'Optimization:|Function:' | sed 's/^/  /'
+    # --verify-opt сравнивает каждое оптимизированное дерево (f и производные) с исходным
+    echo "  differences at test points: $(grep -c 'optimized expression differs' full_analysis.tex)"
+}
+
+optimize "5*x^4+3*x^3-2*x^2+x-7"
+optimize "x^3+x"
+optimize "2*x^6-x^2+1"
+optimize "x^2+y^2"
+optimize "x^2+x"
+optimize "(x+1)*(x+1)-x^2-2*x"
+optimize "sin(x)^3+2*sin(x)+1"
@@ -0,0 +1,12 @@
+# Числовые литералы GetN: целые (быстрый путь и длинные), дроби, порядок,
+# шестнадцатеричная запись и ошибки разбора.
+
+literals="0 7 042 123456789012345 1234567890123456789 3.25 .5 2. 1e3 1.5e-3 2E+2
+          0x10 0x1.8p1 0X.8P-2 0x1p+4 1e308 1e400 1e 1e+ 0x 0x1p 1.2.3"
+
+for literal in $literals; do
+    printf '%s$\n' "$literal" > expr.txt
+    result=$("$DEREVO" --opt-level 0 --plot-mode dat expr.txt < /dev/null |
+             grep -E -m 1 'Calculation result|Syntax error')
+    echo "$literal: ${result:-no result}"
+done
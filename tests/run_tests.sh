@@ -0,0 +1,52 @@
+#!/bin/bash
+# Регрессионные тесты: каждый tests/cases/NAME.sh запускается в пустом временном
+# каталоге, его stdout сравнивается с tests/cases/NAME.expected.
+#
+#   bash tests/run_tests.sh [--update] [NAME...]
+#
+# start_derevo должен быть собран заранее (bash compile.sh). С --update ожидаемые
+# выводы перезаписываются текущими.
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+cases="$root/tests/cases"
+export DEREVO="$root/start_derevo"
+
+update=0
+if [ "$1" = "--update" ]; then
+    update=1
+    shift
+fi
+
+if [ ! -x "$DEREVO" ]; then
+    echo "start_derevo not found, run compile.sh first"
+    exit 1
+fi
+
+names="$*"
+if [ -z "$names" ]; then
+    names=$(cd "$cases" && ls *.sh | sed 's/\.sh$//')
+fi
+
+n_failed=0
+n_total=0
+for name in $names; do
+    n_total=$((n_total + 1))
+    work=$(mktemp -d)
+    (cd "$work" && bash "$cases/$name.sh") > "$work/actual.out" 2> /dev/null
+
+    if [ $update -eq 1 ]; then
+        cp "$work/actual.out" "$cases/$name.expected"
+        echo "UPDATED $name"
+    elif diff -u "$cases/$name.expected" "$work/actual.out" > "$work/diff.out"; then
+        echo "PASSED  $name"
+    else
+        echo "FAILED  $name"
+        cat "$work/diff.out"
+        n_failed=$((n_failed + 1))
+    fi
+
+    rm -rf "$work"
+done
+
+echo "$((n_total - n_failed))/$n_total tests passed"
+[ $n_failed -eq 0 ]